@@ -100,6 +100,7 @@
 #COOLING                        # enables radiative cooling and heating: if GALSF, also external UV background read from file "TREECOOL" (included in the cooling folder)
 #COOL_LOW_TEMPERATURES          # allow fine-structure and molecular cooling to ~10 K; account for optical thickness and line-trapping effects with proper opacities
 #COOL_METAL_LINES_BY_SPECIES    # use full multi-species-dependent cooling tables ( http://www.tapir.caltech.edu/~phopkins/public/spcool_tables.tgz, or the Bitbucket site); requires METALS on; cite Wiersma et al. 2009 (MNRAS, 393, 99) in addition to Hopkins et al. 2017 (arXiv:1702.06148)
+#COOL_TABULATED_RATES           # tabulate the net cooling rate and n_e in (n_H, u, Z, z) (computed in parallel, one copy per node) and interpolate them in the cooling solver instead of the direct calculation; accuracy vs. the direct path written to cooling_table_check.txt. Not with RT heating/chemistry or the optically-thick COOL_LOW_TEMPERATURES limit
 #COOL_GRACKLE                   # enable Grackle: cooling+chemistry package (requires COOLING above; https://grackle.readthedocs.org/en/latest ); see Grackle code for their required citations
 #COOL_GRACKLE_CHEMISTRY=1       # choose Grackle cooling chemistry: (0)=tabular, (1)=Atomic, (2)=(1)+H2+H2I+H2II, (3)=(2)+DI+DII+HD
 #METALS                         # enable metallicities (with multiple species optional) for gas and stars [must be included in ICs or injected via dynamical feedback; needed for some routines]
@@ -165,6 +166,9 @@
 # --------------------------------------- Pure-Tree Options for Direct N-body of small-N groups (recommended for hard binaries, etc)
 #GRAVITY_ACCURATE_FEWBODY_INTEGRATION # enables a suite: GRAVITY_HYBRID_OPENING_CRIT, TIDAL_TIMESTEP_CRITERION, LONG_INTEGER_TIME, to more accurately follow few-body point-like dynamics in the tree. currently compatible only with pure-tree gravity.
 ## ----------------------------------------------------------------------------------------------------
+#GRAVITY_TREE_INTERACTION_LISTS # groups neighboring active particles into one shared tree-walk, building node+particle interaction lists evaluated in vectorizable loops (faster for large cosmological runs). the opening criteria are applied conservatively to the group, so forces are slightly more accurate (not bit-identical). ignored (standard walk used) with modules that need extra per-interaction tree information (adaptive softening, RT_USE_GRAVTREE, BH_CALC_DISTANCES, tidal tensors, etc).
+#GRAVITY_GROUP_EXPANSIONS       # grouped gravity walk with quadrupole node moments (enables GRAVITY_TREE_INTERACTION_LISTS): nodes in the shared interaction list of a particle group that are well-separated from the whole group are folded into one local (Taylor) expansion about the group, instead of being summed for every group member. particle-cell only (no cell-cell interactions), so the cost still scales as O(N log N). currently compatible only with pure-tree gravity.
+## ----------------------------------------------------------------------------------------------------
 # -------------------------------------- arbitrary time-dependent dark energy equations-of-state, expansion histories, or gravitational constants
 #GR_TABULATED_COSMOLOGY         # enable reading tabulated cosmological/gravitational parameters (master switch)
 #GR_TABULATED_COSMOLOGY_W       # read pre-tabulated dark energy equation-of-state w(z)
@@ -361,6 +365,16 @@
 #OPENMP=2                       # Masterswitch for explicit OpenMP implementation
 #PTHREADS_NUM_THREADS=4         # custom PTHREADs implementation (don't enable with OPENMP)
 #MULTIPLEDOMAINS=16             # Multi-Domain option for the top-tree level (alters load-balancing)
+#DOMAIN_INCREMENTAL             # between full domain decompositions (at most every DOMAIN_INCREMENTAL_FULL_EVERY=16), keep the top-level tree, only shift the split points by a few leaves (DOMAIN_INCREMENTAL_MAXSHIFT=4) to rebalance, and move only the particles that changed domain (falls back to a full decomposition if imbalance grows by >DOMAIN_INCREMENTAL_TOLERANCE=1.1)
+#DOMAIN_MULTICONSTRAINT         # balance the domains on measured costs: gravity interaction counts plus the wallclock time each particle spends in the density, hydro, cooling and feedback loops, with the time bins split into DOMAIN_COST_BINGROUPS=2 groups that are each balanced separately
+#NGB_COMPACT_TREE_NODES         # neighbor searches walk a separate compact (32-byte in single precision) copy of the tree nodes with only the geometric data they need, instead of the full gravity nodes (fewer cache misses in the memory-bound hydro searches; costs ~32 bytes/node of memory)
+#NGB_LIST_CACHE                 # the gradient pass stores each local gas particle's pair-neighbor list (compact CSR arrays in the mymalloc arena); the hydro-force pass (and any further gradient sweeps) re-use it instead of walking the tree again, for particles whose search never reaches other tasks
+#DENSITY_HSML_LOCAL_SOLVE       # particles whose kernel length did not converge in the first density pass also get the kernel sums at DENSITY_HSML_NTRIAL=6 trial lengths (0.74-1.35 Hsml); N_ngb(h) is then solved locally (Newton on a cubic in ln h, ln N using the kernel derivatives), so most need one more pass to confirm instead of repeated bisection rounds
+#NONBLOCKING_NEIGHBOR_EXCHANGE  # neighbor loops post all import/export messages at once (non-blocking point-to-point) and evaluate the elements from each task as soon as they arrive, overlapping communication with the secondary-loop work (the order in which imported contributions are added then depends on message arrival, so runs are not bit-reproducible)
+#SPARSE_NEIGHBOR_EXCHANGE      # neighbor loops find their communication partners with a sparse (NBX: synchronous sends + non-blocking barrier) handshake instead of an MPI_Alltoall of the export counts, so the cost per buffer round scales with the number of actual partners rather than NTask (requires MPI-3)
+#NODE_SHARED_TABLES             # keep the cooling rate and metal-line tables in MPI-3 shared memory, built/read once per node (only one task per node reads the spcool_tables files, task 0 reads TREECOOL and broadcasts it; the SIDM geometric-factor integrals are divided over the tasks). The Helmholtz EOS table (Fortran common blocks) is still read by every task
+#RADIX_SORT                     # sort the Peano-Hilbert key tables and the export (data-index) tables with a threaded LSD radix sort instead of comparator-based merge sorts/qsort; the distributed sorts of IDs and group numbers use it for their local sorts
+#HOT_PATH_PROFILER              # time the neighbor loops, gravity, domain decomposition, tree builds and I/O individually (with export/interaction/buffer-round counts and thread imbalance), and write one JSON line per step to profile.jsonl (with the cost split over the active time bins; run totals per time bin in profile_timebins.json)
 ####################################################################################################
 
 
@@ -387,13 +401,19 @@
 #OUTPUT_POWERSPEC               # compute and output power spectra (not used)
 #OUTPUT_RECOMPUTE_POTENTIAL     # update potential every output even it EVALPOTENTIAL is set
 #INPUT_READ_HSML                # force reading hsml from IC file (instead of re-computing them; in general this is redundant but useful if special guesses needed)
+#IO_PARALLEL_IC_READ            # every task opens the initial-condition file(s) assigned to it and reads its own share of each block directly (all files at once), instead of one task per file reading everything and sending it on
 #OUTPUT_TWOPOINT_ENABLED        # allows user to calculate mass 2-point function by enabling and setting restartflag=5
+#INSITU_ANALYSIS                # every TimeBetInSitu, run the registered analysis kernels (see structure/insitu.c: gas density/energy PDFs, plus FoF, power spectrum, two-point function if enabled) on the live particle data at the end of the step, writing compact results to OutputDir/insitu
 #IO_DISABLE_HDF5                # disable HDF5 I/O support (for both reading/writing; use only if HDF5 not install-able)
 #IO_COMPRESS_HDF5     		    # write HDF5 in compressed form (will slow down snapshot I/O and may cause issues on old machines, but reduce snapshots 2x)
+#IO_HDF5_FIELD_POLICIES         # per-field output policies for HDF5 snapshots: all datasets chunked+shuffled+deflated (level OutputCompressionLevel); positions optionally quantized to OutputPositionPrecision*BoxSize, and purely diagnostic float fields (density, kernel lengths, rates, potentials, etc; never evolved state such as U or Z) optionally rounded to OutputDerivedFieldMantissaBits mantissa bits (set both to 0 for lossless output)
+#IO_HDF5_PARALLEL               # write HDF5 snapshots (SnapFormat=3) with parallel HDF5: all tasks of a file write their own part of each dataset collectively through MPI-IO, and all files are written at once (requires HDF5 built with MPI; set HDF5ChunkSize and HDF5Aggregators in the parameterfile)
 #IO_SUPPRESS_TIMEBIN_STDOUT=10  # only prints timebin-list to log file if highest active timebin index is within N (value set) of the highest timebin (dt_bin=2^(-N)*dt_bin,max)
 #IO_SUBFIND_IN_OLD_ASCII_FORMAT # write sub-find outputs in the old massive ascii-table format (unweildy and can cause lots of filesystem issues, but here for backwards compatibility)
 #IO_SUBFIND_READFOF_FROMIC      # try read already existing FOF files associated with a run instead of recomputing them: not de-bugged
 #IO_TURB_DIFF_DYNAMIC_ERROR     # save error terms from localized dynamic Smagorinsky model to snapshots
+#IO_RESTART_PORTABLE            # write restart files as a single shared file with MPI-IO (restartfiles/<RestartFile>.portable) which can be read back with any number of MPI tasks (the particles are redistributed with a new domain decomposition); falls back to the per-task restart files if no such file is found
+#IO_RESTART_ASYNC               # per-task restart files are serialized into memory and written to disk by a background thread while the run continues (the next restart blocks only if the previous one is still in flight; old files are moved to .bak once all new ones are complete). costs one extra copy of the particle data in memory. not used with IO_RESTART_PORTABLE
 ####################################################################################################
 
 
@@ -78,6 +78,9 @@ void compute_hydro_densities_and_forces(void)
         dynamic_diff_vel_calc(); /* This must be called between density and gradient calculations */
 #endif
 
+#ifdef NGB_LIST_CACHE
+        ngb_list_cache_allocate(); /* the gradient pass fills the neighbor lists which the force pass re-uses */
+#endif
         hydro_gradient_calc(); /* calculates the gradients of hydrodynamical quantities  */
         PRINT_STATUS(" ..gradient computation done.");
 
@@ -85,6 +88,9 @@ void compute_hydro_densities_and_forces(void)
         dynamic_diff_calc(); /* This MUST be called immediately following gradient calculations */
 #endif
         hydro_force();		/* adds hydrodynamical accelerations and computes du/dt  */
+#ifdef NGB_LIST_CACHE
+        ngb_list_cache_free();
+#endif
         compute_additional_forces_for_all_particles(); /* other accelerations that need to be computed are done here */
         PRINT_STATUS(" ..hydro force computation done.");
 
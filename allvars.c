@@ -86,6 +86,11 @@ int TakeLevel;
 int FirstActiveParticle;
 int *NextActiveParticle;
 unsigned char *ProcessedFlag;
+int *ActiveParticleList;
+int ActiveParticleListLength;
+int ActiveParticleChunkSize;
+double *ThreadDispatchTime;
+long long *ThreadDispatchCount;
 
 int TimeBinCount[TIMEBINS];
 int TimeBinCountSph[TIMEBINS];
@@ -351,12 +356,19 @@ struct NODE *Nodes_base,	/*!< points to the actual memory allocated for the node
 struct extNODE *Extnodes, *Extnodes_base;
 
 
+#ifdef NGB_COMPACT_TREE_NODES
+struct NGBNODE *NgbNodes, *NgbNodes_base;	/*!< compact node data for the neighbor-search walk */
+#endif
+
 int MaxNodes;			/*!< maximum allowed number of internal nodes */
 int Numnodestree;		/*!< number of (internal) nodes in each tree */
 
 
 int *Nextnode;			/*!< gives next node in tree walk  (nodes array) */
 int *Father;			/*!< gives parent node in tree (Prenodes array) */
+#ifdef NGB_LIST_CACHE
+struct ngb_list_cache_data NgbListCache;	/*!< re-usable pair-neighbor lists of the local gas particles */
+#endif
 
 
 #if defined(PTHREADS_NUM_THREADS)
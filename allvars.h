@@ -50,6 +50,9 @@
 #ifndef IO_DISABLE_HDF5
 #define HAVE_HDF5
 #include <hdf5.h>
+#if defined(IO_HDF5_PARALLEL) && !defined(H5_HAVE_PARALLEL)
+#error "IO_HDF5_PARALLEL requires an HDF5 library built with parallel (MPI-IO) support"
+#endif
 #endif
 
 
@@ -578,6 +581,20 @@
 #endif
 #endif
 
+#if defined(GRAVITY_GROUP_EXPANSIONS) && !defined(GRAVITY_TREE_INTERACTION_LISTS)
+#define GRAVITY_TREE_INTERACTION_LISTS /* the multipole expansions are built on top of the grouped interaction-list walk */
+#endif
+#if defined(GRAVITY_TREE_INTERACTION_LISTS)
+/* the grouped interaction-list walk only evaluates plain (fixed-softening) monopole forces and potentials: any module which
+    needs additional per-interaction information from the gravity tree falls back to the standard per-particle walk */
+#if defined(ADAPTIVE_GRAVSOFT_FORALL) || defined(ADAPTIVE_GRAVSOFT_FORGAS) || defined(RT_USE_GRAVTREE) || defined(RT_USE_TREECOL_FOR_NH) || defined(BH_CALC_DISTANCES) || defined(DM_SCALARFIELD_SCREENING) || defined(NEIGHBORS_MUST_BE_COMPUTED_EXPLICITLY_IN_FORCETREE) || defined(SINGLE_STAR_SINK_DYNAMICS) || defined(GRAVITY_ACCURATE_FEWBODY_INTEGRATION) || defined(GALSF_SFR_TIDAL_HILL_CRITERION) || defined(TIDAL_TIMESTEP_CRITERION) || defined(GDE_DISTORTIONTENSOR) || defined(COMPUTE_JERK_IN_GRAVTREE) || defined(OUTPUT_TIDAL_TENSOR) || defined(SINGLE_STAR_TIMESTEPPING)
+#undef GRAVITY_TREE_INTERACTION_LISTS
+#endif
+#endif
+#if defined(GRAVITY_GROUP_EXPANSIONS) && (!defined(GRAVITY_TREE_INTERACTION_LISTS) || defined(PMGRID))
+#undef GRAVITY_GROUP_EXPANSIONS /* currently compatible only with pure-tree gravity (the expansions are for the un-truncated 1/r kernel) */
+#endif
+
 #if defined(EOS_SUBSTELLAR_ISM)
 #define EOS_GAMMA_VARIABLE
 #endif
@@ -620,8 +637,8 @@
 
 
 
-#ifdef MYSORT
-#define MYSORT_DATAINDEX mysort_dataindex
+#if defined(MYSORT) || defined(RADIX_SORT)
+#define MYSORT_DATAINDEX mysort_dataindex /* (a radix sort with RADIX_SORT) */
 #else // MYSORT
 #define MYSORT_DATAINDEX qsort
 #endif
@@ -770,10 +787,29 @@ static MPI_Datatype MPI_TYPE_TIME = MPI_INT;
 #define  GRAVCOSTLEVELS      6
 #endif
 
+#ifdef DOMAIN_MULTICONSTRAINT
+/* physics loops whose cost is measured per particle (gravity uses the interaction counts in GravCost instead) */
+#define  DOMAIN_COST_DENSITY    0
+#define  DOMAIN_COST_HYDRO      1
+#define  DOMAIN_COST_COOLING    2
+#define  DOMAIN_COST_FEEDBACK   3
+#define  DOMAIN_COST_LOOPS      4
+#ifndef  DOMAIN_COST_BINGROUPS
+#define  DOMAIN_COST_BINGROUPS  2   /* number of groups of time bins (from the most to the least frequently active) balanced as separate constraints */
+#endif
+#endif
+
 #define  NUMBER_OF_MEASUREMENTS_TO_RECORD  6  /* this is the number of past executions of a timebin that the reported average CPU-times average over */
 
 #define  NODELISTLENGTH      8
 
+#ifndef  ACTIVE_LIST_CHUNKS_PER_THREAD
+#define  ACTIVE_LIST_CHUNKS_PER_THREAD  16  /* threads claim the active list in chunks, aiming for (at least) this many chunks per thread to keep the end-of-loop imbalance small */
+#endif
+#ifndef  ACTIVE_LIST_MAX_CHUNK
+#define  ACTIVE_LIST_MAX_CHUNK  32  /* maximum chunk size: larger chunks mean fewer atomic operations, but more discarded work when the export buffer fills */
+#endif
+
 
 #define EPSILON_FOR_TREERND_SUBNODE_SPLITTING (1.0e-4) /* define some number << 1; particles with less than this separation will trigger randomized sub-node splitting in the tree.
                                                             we set it to a global value here so that other sub-routines will know not to force particle separations below this */
@@ -1186,6 +1222,18 @@ z=((z)>boxHalf_Z)?((z)-boxSize_Z):(((z)<-boxHalf_Z)?((z)+boxSize_Z):(z)))
 
 #define MACRO_NAME_CONCATENATE(A, B) MACRO_NAME_CONCATENATE_(A, B)
 #define MACRO_NAME_CONCATENATE_(A, B) A##B
+#define MACRO_NAME_STRINGIFY(A) MACRO_NAME_STRINGIFY_(A)
+#define MACRO_NAME_STRINGIFY_(A) #A
+
+#ifdef HOT_PATH_PROFILER
+/*! open/close a named profiler region (see system/profiler.c); the arguments of PROFILE_END are the number of exported
+ *  elements, of buffer rounds, and of interactions in the region, followed by its communication and wait times */
+#define PROFILE_BEGIN(name) {static int profile_region_ = -1; if(profile_region_ < 0) {profile_region_ = profile_region_id(name);} profile_begin(profile_region_);}
+#define PROFILE_END(n_exports, n_rounds, n_interactions, t_comm, t_wait) {profile_end(n_exports, n_rounds, n_interactions, t_comm, t_wait);}
+#else
+#define PROFILE_BEGIN(name)
+#define PROFILE_END(n_exports, n_rounds, n_interactions, t_comm, t_wait)
+#endif
 
 
 /*********************************************************/
@@ -1196,6 +1244,11 @@ z=((z)>boxHalf_Z)?((z)-boxSize_Z):(((z)<-boxHalf_Z)?((z)+boxSize_Z):(z)))
 extern int FirstActiveParticle;
 extern int *NextActiveParticle;
 extern unsigned char *ProcessedFlag;
+extern int *ActiveParticleList;         /*!< flattened copy of the NextActiveParticle chain: threads pull chunks of it with an atomic counter in the neighbor loops */
+extern int ActiveParticleListLength;    /*!< number of elements in ActiveParticleList */
+extern int ActiveParticleChunkSize;     /*!< number of list elements a thread claims at once from ActiveParticleList */
+extern double *ThreadDispatchTime;      /*!< per-thread time spent evaluating elements in the threaded loops (since the last cpu-log output), to monitor thread imbalance */
+extern long long *ThreadDispatchCount;  /*!< per-thread number of elements evaluated in the threaded loops (since the last cpu-log output) */
 
 extern int TimeBinCount[TIMEBINS];
 extern int TimeBinCountSph[TIMEBINS];
@@ -1471,6 +1524,15 @@ extern struct global_data_all_processes
   int NumFilesPerSnapshot;	/*!< number of files in multi-file snapshot dumps */
   int NumFilesWrittenInParallel;	/*!< maximum number of files that may be written simultaneously when
                                      writing/reading restart-files, or when writing snapshot files */
+#ifdef IO_HDF5_FIELD_POLICIES
+  int OutputCompressionLevel;       /*!< deflate level (0-9) of the HDF5 snapshot datasets */
+  int OutputDerivedFieldMantissaBits; /*!< number of mantissa bits kept in diagnostic floating-point fields of HDF5 snapshots (0 for all) */
+  double OutputPositionPrecision;   /*!< absolute precision of the positions in HDF5 snapshots, in units of the box size (0 for lossless) */
+#endif
+#ifdef IO_HDF5_PARALLEL
+  int HDF5ChunkSize;            /*!< number of particles per chunk of the datasets written with parallel HDF5 (0 for contiguous datasets) */
+  int HDF5Aggregators;          /*!< number of MPI-IO aggregators (collective-buffering nodes) per snapshot file (0 for the MPI-IO default) */
+#endif
   double BufferSize;		/*!< size of communication buffer in MB */
   int BunchSize;     	        /*!< number of particles fitting into the buffer in the parallel tree algorithm  */
 
@@ -1610,6 +1672,11 @@ extern struct global_data_all_processes
 #ifdef OUTPUT_LINEOFSIGHT
   double TimeFirstLineOfSight;
 #endif
+#ifdef INSITU_ANALYSIS
+  double TimeBetInSitu;           /*!< interval between in-situ analyses (a factor in the scale factor for comoving runs) */
+  double TimeNextInSitu;          /*!< time of the next in-situ analysis */
+  int InSituCount;                /*!< number of in-situ analyses done so far (used to number their output) */
+#endif
 
   int    CPU_TimeBinCountMeasurements[TIMEBINS];
   double CPU_TimeBinMeasurements[TIMEBINS][NUMBER_OF_MEASUREMENTS_TO_RECORD];
@@ -2189,6 +2256,9 @@ extern ALIGN(32) struct particle_data
 #endif
     
     float GravCost[GRAVCOSTLEVELS];   /*!< weight factor used for balancing the work-load */
+#ifdef DOMAIN_MULTICONSTRAINT
+    float MeasuredCost[DOMAIN_COST_LOOPS]; /*!< wallclock time spent on this particle in each physics loop during its last active step */
+#endif
     
 #ifdef WAKEUP
     integertime dt_step;
@@ -3010,6 +3080,9 @@ extern ALIGN(32) struct NODE
 #endif
     
   MyFloat maxsoft;		/*!< hold the maximum gravitational softening of particle in the node */
+#ifdef GRAVITY_GROUP_EXPANSIONS
+  MyFloat quad[6];		/*!< traceless quadrupole moment about the center-of-mass (xx,yy,zz,xy,xz,yz) */
+#endif
   
 #ifdef DM_SCALARFIELD_SCREENING
   MyFloat s_dm[3];
@@ -3042,6 +3115,32 @@ extern struct extNODE
  *Extnodes, *Extnodes_base;
 
 
+#ifdef NGB_COMPACT_TREE_NODES
+/*! compact copy of the node data needed by the neighbor-search walk (32 bytes with single-precision MyFloat and
+ *  integer time), built alongside the tree and indexed like Nodes[]. the members carry the same names as in struct NODE,
+ *  so the shared neighbor-search code blocks read either one. single-particle leaves, which the walk always opens,
+ *  are flagged by a negative len */
+extern struct NGBNODE
+{
+  MyFloat center[3];		/*!< geometrical center of node */
+  MyFloat len;			/*!< sidelength of treenode (drifted with Nodes[].len; <0 flags a node which is always opened) */
+  struct
+  {
+    struct
+    {
+      int sibling;		/*!< next node in the walk in case the current node can be discarded */
+      int nextnode;		/*!< next node in case the current node needs to be opened */
+    }
+    d;
+  }
+  u;
+  MyFloat hmax;			/*!< maximum gas kernel length in node (copy of Extnodes[].hmax) */
+  integertime Ti_current;	/*!< time to which the node was drifted (copy of Nodes[].Ti_current) */
+}
+ *NgbNodes, *NgbNodes_base;
+#endif
+
+
 extern int MaxNodes;		/*!< maximum allowed number of internal nodes */
 extern int Numnodestree;	/*!< number of (internal) nodes in each tree */
 
@@ -3049,6 +3148,22 @@ extern int Numnodestree;	/*!< number of (internal) nodes in each tree */
 extern int *Nextnode;		/*!< gives next node in tree walk  (nodes array) */
 extern int *Father;		/*!< gives parent node in tree (Prenodes array) */
 
+#ifdef NGB_LIST_CACHE
+/*! per-particle pair-neighbor lists (CSR layout: the list of gas particle i is List[Start[i]...Start[i]+Length[i]-1]),
+ *  filled by the gradient pass and re-used by the hydro-force pass of the same step. Length[i]<0 means that particle i
+ *  has no valid list (not filled, out of space, or its search also reached other tasks), and must walk the tree */
+extern struct ngb_list_cache_data
+{
+    int *Start;                 /*!< offset of the list of particle i in List */
+    int *Length;                /*!< number of neighbors of particle i (<0 if not cached) */
+    int *List;                  /*!< concatenated neighbor lists */
+    long long Capacity;         /*!< number of elements which fit in List */
+    long long Used;             /*!< number of elements of List already handed out */
+    integertime Ti_filled;      /*!< time at which the lists were built (they are only valid at this time) */
+}
+NgbListCache;
+#endif
+
 extern int maxThreads;
 
 #ifdef TURB_DRIVING
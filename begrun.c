@@ -181,6 +181,10 @@ void begrun(void)
     init_geofactor_table();
 #endif
 
+#ifdef INSITU_ANALYSIS
+    insitu_init();
+#endif
+
   All.TimeLastRestartFile = CPUThisRun;
 
   if(RestartFlag == 0 || RestartFlag == 2 || RestartFlag == 3 || RestartFlag == 4 || RestartFlag == 5 || RestartFlag == 6)
@@ -237,6 +241,18 @@ void begrun(void)
       All.ErrTolForceAcc = all.ErrTolForceAcc;
       All.NumFilesPerSnapshot = all.NumFilesPerSnapshot;
       All.NumFilesWrittenInParallel = all.NumFilesWrittenInParallel;
+#ifdef IO_HDF5_FIELD_POLICIES
+      All.OutputCompressionLevel = all.OutputCompressionLevel;
+      All.OutputDerivedFieldMantissaBits = all.OutputDerivedFieldMantissaBits;
+      All.OutputPositionPrecision = all.OutputPositionPrecision;
+#endif
+#ifdef INSITU_ANALYSIS
+      All.TimeBetInSitu = all.TimeBetInSitu;
+#endif
+#ifdef IO_HDF5_PARALLEL
+      All.HDF5ChunkSize = all.HDF5ChunkSize;
+      All.HDF5Aggregators = all.HDF5Aggregators;
+#endif
       All.TreeDomainUpdateFrequency = all.TreeDomainUpdateFrequency;
 
       All.OutputListOn = all.OutputListOn;
@@ -1104,6 +1120,30 @@ void read_parameter_file(char *fname)
       addr[nt] = &All.NumFilesWrittenInParallel;
       id[nt++] = INT;
 
+#ifdef IO_HDF5_FIELD_POLICIES
+      strcpy(tag[nt], "OutputCompressionLevel");
+      addr[nt] = &All.OutputCompressionLevel;
+      id[nt++] = INT;
+
+      strcpy(tag[nt], "OutputDerivedFieldMantissaBits");
+      addr[nt] = &All.OutputDerivedFieldMantissaBits;
+      id[nt++] = INT;
+
+      strcpy(tag[nt], "OutputPositionPrecision");
+      addr[nt] = &All.OutputPositionPrecision;
+      id[nt++] = REAL;
+#endif
+
+#ifdef IO_HDF5_PARALLEL
+      strcpy(tag[nt], "HDF5ChunkSize");
+      addr[nt] = &All.HDF5ChunkSize;
+      id[nt++] = INT;
+
+      strcpy(tag[nt], "HDF5Aggregators");
+      addr[nt] = &All.HDF5Aggregators;
+      id[nt++] = INT;
+#endif
+
       strcpy(tag[nt], "ResubmitOn");
       addr[nt] = &All.ResubmitOn;
       id[nt++] = INT;
@@ -1214,6 +1254,12 @@ void read_parameter_file(char *fname)
         
         
 
+#ifdef INSITU_ANALYSIS
+      strcpy(tag[nt], "TimeBetInSitu");
+      addr[nt] = &All.TimeBetInSitu;
+      id[nt++] = REAL;
+#endif
+
 #if defined(BLACK_HOLES) || defined(GALSF_SUBGRID_WINDS)
       strcpy(tag[nt], "TimeBetOnTheFlyFoF");
       addr[nt] = &All.TimeBetOnTheFlyFoF;
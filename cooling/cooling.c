@@ -35,46 +35,55 @@ static double *BetaH0, *BetaHep, *Betaff, *AlphaHp, *AlphaHep, *Alphad, *AlphaHe
  cooling tables can be downloaded at: http://www.tapir.caltech.edu/~phopkins/public/spcool_tables.tgz or on the Bitbucket site (downloads section) */
 static float *SpCoolTable0, *SpCoolTable1;
 #endif
-/* these are constants of the UV background at a given redshift: they are interpolated from TREECOOL but then not modified particle-by-particle */
-static double J_UV = 0, gJH0 = 0, gJHep = 0, gJHe0 = 0, epsH0 = 0, epsHep = 0, epsHe0 = 0;
+#ifdef NODE_SHARED_TABLES
+static MPI_Win CoolRateTableWin, SpCoolTableWin[2]; /* node-shared windows holding the tables above (one copy per node) */
+#endif
+/* these are constants of the UV background at a given redshift: they are interpolated from TREECOOL but then not modified particle-by-particle.
+    they are collected here in one structure, written only by the IonizeParams routines (outside of the threaded particle loop), so the
+    particle-by-particle routines below (DoCooling, CoolingRateFromU, and everything they call) only read shared state and are re-entrant */
+static struct cooling_uvb_state
+{
+    double J_UV;                    /* amplitude of the background (only used to check if there is one) */
+    double gJH0, gJHep, gJHe0;      /* photo-ionization rates of HI, HeII, HeI */
+    double epsH0, epsHep, epsHe0;   /* photo-heating rates of HI, HeII, HeI */
+}
+CoolUVB;
 
 
 
-/* this is just a simple loop to do the particle cooling. this is now openmp-parallelized, since the cooling iteration can be a non-negligible cost */
+/* this is just a simple loop to do the particle cooling. this is now openmp-parallelized, since the cooling iteration can be a non-negligible cost.
+    the active list is flattened and handed out to the threads in chunks with dynamic scheduling, since the cost per particle varies by
+    orders of magnitude (the number of iterations to converge the temperature and ionization states depends strongly on the local conditions) */
 void cooling_parent_routine(void)
 {
-    NextParticle = FirstActiveParticle;
-/*
-#ifdef _OPENMP
-#pragma omp parallel // static variables above causing problems with openmp shared memory (getting swapped) on some compilers: demote for now
+    int k;
+    build_active_particle_list();
+#if defined(_OPENMP) && !defined(COOL_GRACKLE) && !defined(RT_COOLING_PHOTOHEATING_OLDFORMAT) && !defined(EOS_HELMHOLTZ) /* the grackle library, the old-format RT heating, and the Helmholtz EOS (called through get_pressure; it keeps its state in Fortran common blocks) are not re-entrant: keep them on one thread */
+#pragma omp parallel for schedule(dynamic, ActiveParticleChunkSize)
 #endif
-*/
+    for(k = 0; k < ActiveParticleListLength; k++)
     {
-        while(1)
-        {
-            int i, exitFlag = 0;
-/*
-#ifdef _OPENMP
-#pragma omp critical(_nexport_)
-#endif
-*/
-            {
-                if(NextParticle<0) {exitFlag = 1;} else {i=NextParticle; NextParticle=NextActiveParticle[NextParticle];}
-            }
-            if(exitFlag) {break;}
-
-            /* here apply any conditional statements about whether we should or should not enter the cooling loop */
-            if(P[i].Type != 0) {continue;} /* only gas cools */
-            if(P[i].Mass <= 0) {continue;} /* only non-zero mass particles cool */
+        int i = ActiveParticleList[k], thread_id = 0;
+        /* here apply any conditional statements about whether we should or should not enter the cooling loop */
+        if(P[i].Type != 0) {continue;} /* only gas cools */
+        if(P[i].Mass <= 0) {continue;} /* only non-zero mass particles cool */
 #ifdef GALSF_EFFECTIVE_EQS
-            if((SphP[i].Density*All.cf_a3inv > All.PhysDensThresh) && ((All.ComovingIntegrationOn==0) || (SphP[i].Density>=All.OverDensThresh))) {continue;} /* no cooling for effective-eos star-forming particles */
+        if((SphP[i].Density*All.cf_a3inv > All.PhysDensThresh) && ((All.ComovingIntegrationOn==0) || (SphP[i].Density>=All.OverDensThresh))) {continue;} /* no cooling for effective-eos star-forming particles */
 #endif
 #ifdef GALSF_FB_TURNOFF_COOLING
-            if(SphP[i].DelayTimeCoolingSNe > 0) {continue;} /* no cooling for particles marked in delayed cooling */
+        if(SphP[i].DelayTimeCoolingSNe > 0) {continue;} /* no cooling for particles marked in delayed cooling */
+#endif
+#ifdef _OPENMP
+        thread_id = omp_get_thread_num();
+#endif
+        double t_cooling_start = my_second();
+        do_the_cooling_for_particle(i);
+        double dt_cooling = timediff(t_cooling_start, my_second());
+#ifdef DOMAIN_MULTICONSTRAINT
+        P[i].MeasuredCost[DOMAIN_COST_COOLING] += dt_cooling; /* measured for the load-balancing */
 #endif
-            do_the_cooling_for_particle(i);
-        } /* while bracket */
-    } /* omp bracket */
+        ThreadDispatchCount[thread_id]++; ThreadDispatchTime[thread_id] += dt_cooling; /* record the per-thread work for the imbalance monitor */
+    }
 }
 
 
@@ -369,6 +378,22 @@ double yhelium(int target)
 #endif
 }
 
+/* random weight for the tie-break in convert_u_to_temp (used when the iteration oscillates between two values). this is called from threaded
+    loops (the cooling loop here, and the gradient loop), so without a pre-generated table it cannot use the shared gsl generator (whose state
+    would be advanced by several threads at once); instead the seed is hashed, which is thread-safe and independent of the order of the threads */
+static double cooling_tiebreak_random(unsigned long long seed)
+{
+#if defined(_OPENMP) && !defined(USE_PREGENERATED_RANDOM_NUMBER_TABLE)
+    seed += 0x9E3779B97F4A7C15ULL; /* splitmix64 finalizer */
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+    seed ^= seed >> 31;
+    return (double) (seed >> 11) * (1.0 / 9007199254740992.0); /* top 53 bits, in [0,1) */
+#else
+    return get_random_number((MyIDType) seed);
+#endif
+}
+
 /* this function determines the electron fraction, and hence the mean molecular weight. With it arrives at a self-consistent temperature.
  * Ionization abundances and the rates for the emission are also computed */
 double convert_u_to_temp(double u, double rho, int target, double *ne_guess, double *nH0_guess, double *nHp_guess, double *nHe0_guess, double *nHep_guess, double *nHepp_guess)
@@ -391,7 +416,7 @@ double convert_u_to_temp(double u, double rho, int target, double *ne_guess, dou
         
         max = DMAX(max, temp_new * mu * HYDROGEN_MASSFRAC * fabs((*ne_guess - ne_old) / (temp_new - temp_old + 1.0)));
         temp = temp_old + (temp_new - temp_old) / (1 + max);
-        if(fabs(temp-temp_old_old)/(temp+temp_old_old) < 1.e-4) {double wt=get_random_number(12*iter+340*ThisTask+5435*target); temp=(wt*temp_old + (1.-wt)*temp_new);}
+        if(fabs(temp-temp_old_old)/(temp+temp_old_old) < 1.e-4) {double wt=cooling_tiebreak_random(12ULL*iter+340ULL*ThisTask+5435ULL*target); temp=(wt*temp_old + (1.-wt)*temp_new);}
         temp_old_old = temp_old;
         iter++;
         if(iter > (MAXITER - 10)) {printf("-> temp=%g/%g/%g ne=%g/%g mu=%g rho=%g max=%g iter=%d target=%d \n", temp,temp_new,temp_old,*ne_guess,ne_old, mu ,rho,max,iter,target);}
@@ -461,8 +486,8 @@ double find_abundances_and_rates(double logT, double rho, int target, double shi
     if(shieldfac < 0)
     {
         double NH_SS_z;
-        if(gJH0>0)
-            NH_SS_z = NH_SS*pow(local_gammamultiplier*gJH0/1.0e-12,0.66)*pow(10.,0.173*(logT-4.));
+        if(CoolUVB.gJH0>0)
+            NH_SS_z = NH_SS*pow(local_gammamultiplier*CoolUVB.gJH0/1.0e-12,0.66)*pow(10.,0.173*(logT-4.));
         else
             NH_SS_z = NH_SS*pow(10.,0.173*(logT-4.));
         double q_SS = nHcgs/NH_SS_z;
@@ -516,16 +541,16 @@ double find_abundances_and_rates(double logT, double rho, int target, double shi
 #endif
         
         fac_noneq_cgs = (dt * All.UnitTime_in_s / All.HubbleParam) * necgs; // factor needed below to asses whether timestep is larger/smaller than recombination time
-        if(necgs <= 1.e-25 || J_UV == 0)
+        if(necgs <= 1.e-25 || CoolUVB.J_UV == 0)
         {
             gJH0ne = gJHe0ne = gJHepne = 0;
         }
         else
         {
             /* account for self-shielding in calculating UV background effects */
-            gJH0ne = gJH0 * local_gammamultiplier / necgs * shieldfac; // check units, should be = c_light * n_photons_vol * rt_sigma_HI[0] / necgs;
-            gJHe0ne = gJHe0 * local_gammamultiplier / necgs * shieldfac;
-            gJHepne = gJHep * local_gammamultiplier / necgs * shieldfac;
+            gJH0ne = CoolUVB.gJH0 * local_gammamultiplier / necgs * shieldfac; // check units, should be = c_light * n_photons_vol * rt_sigma_HI[0] / necgs;
+            gJHe0ne = CoolUVB.gJHe0 * local_gammamultiplier / necgs * shieldfac;
+            gJHepne = CoolUVB.gJHep * local_gammamultiplier / necgs * shieldfac;
         }
 #if defined(RT_DISABLE_UV_BACKGROUND)
         gJH0ne = gJHe0ne = gJHepne = 0;
@@ -536,7 +561,7 @@ double find_abundances_and_rates(double logT, double rho, int target, double shi
         {
             int k;
             c_light_ne = C_LIGHT / ((MIN_REAL_NUMBER + necgs) * All.UnitLength_in_cm / All.HubbleParam); // want physical cgs units for quantities below
-            double gJH0ne_0=gJH0 * local_gammamultiplier / (MIN_REAL_NUMBER + necgs), gJHe0ne_0=gJHe0 * local_gammamultiplier / (MIN_REAL_NUMBER + necgs), gJHepne_0=gJHep * local_gammamultiplier / (MIN_REAL_NUMBER + necgs); // need a baseline, so we don't over-shoot below
+            double gJH0ne_0=CoolUVB.gJH0 * local_gammamultiplier / (MIN_REAL_NUMBER + necgs), gJHe0ne_0=CoolUVB.gJHe0 * local_gammamultiplier / (MIN_REAL_NUMBER + necgs), gJHepne_0=CoolUVB.gJHep * local_gammamultiplier / (MIN_REAL_NUMBER + necgs); // need a baseline, so we don't over-shoot below
 #if defined(RT_DISABLE_UV_BACKGROUND)
             gJH0ne_0=gJHe0ne_0=gJHepne_0=MAX_REAL_NUMBER;
 #endif
@@ -615,7 +640,7 @@ double find_abundances_and_rates(double logT, double rho, int target, double shi
         n_elec = nHp + nHep + 2 * nHepp;	/* eqn (38) */
         necgs = n_elec * nHcgs;
         
-        if(J_UV == 0) break;
+        if(CoolUVB.J_UV == 0) break;
         
         nenew = 0.5 * (n_elec + neold);
         n_elec = nenew;
@@ -669,6 +694,10 @@ double find_abundances_and_rates(double logT, double rho, int target, double shi
 /*  this function first computes the self-consistent temperature and abundance ratios, and then it calculates (heating rate-cooling rate)/n_h^2 in cgs units */
 double CoolingRateFromU(double u, double rho, double ne_guess, int target)
 {
+#ifdef COOL_TABULATED_RATES
+    double Q_table; /* use the tabulated rates if the particle is within the range of the table (otherwise fall back to the direct calculation below) */
+    if(target >= 0) {if(cooling_table_rate(u, rho, target, &Q_table)) {return Q_table;}}
+#endif
     double nH0_guess, nHp_guess, nHe0_guess, nHep_guess, nHepp_guess;
     double temp = convert_u_to_temp(u, rho, target, &ne_guess, &nH0_guess, &nHp_guess, &nHe0_guess, &nHep_guess, &nHepp_guess);
     return CoolingRate(log10(temp), rho, ne_guess, target);
@@ -696,6 +725,15 @@ extern FILE *fd;
 /*  Calculates (heating rate-cooling rate)/n_h^2 in cgs units 
  */
 double CoolingRate(double logT, double rho, double n_elec_guess, int target)
+{
+    return CoolingRateScaledZ(logT, rho, n_elec_guess, target, 1, NULL, NULL);
+}
+
+
+/*  as CoolingRate(), but if there is no target particle (target<0), the metal abundances are taken to be the solar abundances scaled
+    by zscale (instead of solar). if ne_out is not NULL, the electron abundance found along the way is returned there, and if heat_out
+    is not NULL, the heating part of the rate (before the hydro term is added) is returned there */
+double CoolingRateScaledZ(double logT, double rho, double n_elec_guess, int target, double zscale, double *ne_out, double *heat_out)
 {
     double n_elec=n_elec_guess, nH0, nHe0, nHp, nHep, nHepp; /* ionization states [computed below] */
     double Lambda, Heat, LambdaFF, LambdaCmptn, LambdaExcH0, LambdaExcHep, LambdaIonH0, LambdaIonHe0, LambdaIonHep;
@@ -703,29 +741,28 @@ double CoolingRate(double logT, double rho, double n_elec_guess, int target)
     double nHcgs = HYDROGEN_MASSFRAC * rho / PROTONMASS;	/* hydrogen number dens in cgs units */
     LambdaMol=0; LambdaMetal=0; LambdaCmptn=0; NH_SS_z=NH_SS;
     if(logT <= Tmin) {logT = Tmin + 0.5 * deltaT;}	/* floor at Tmin */
-    if(!isfinite(rho)) {return 0;} 
+    if(!isfinite(rho)) {if(ne_out) {*ne_out = n_elec;} if(heat_out) {*heat_out = 0;} return 0;} 
     T = pow(10.0, logT);
     
     /* some blocks below to define useful variables before calculation of cooling rates: */
     
 #ifdef COOL_METAL_LINES_BY_SPECIES
-    double *Z;
+    double *Z, Zsol[NUM_METAL_SPECIES];
     if(target>=0)
     {
         Z = P[target].Metallicity;
     } else {
         /* initialize dummy values here so the function doesn't crash, if called when there isn't a target particle */
         int k;
-        double Zsol[NUM_METAL_SPECIES];
-        for(k=0;k<NUM_METAL_SPECIES;k++) Zsol[k]=All.SolarAbundances[k];
+        for(k=0;k<NUM_METAL_SPECIES;k++) {Zsol[k]=All.SolarAbundances[k]; if(k!=1) {Zsol[k]*=zscale;}} /* (k=1 is helium, which is not scaled) */
         Z = Zsol;
     }
 #endif
     double local_gammamultiplier=1;
     
     /* CAFG: if density exceeds NH_SS, ignore ionizing background. */
-    if(J_UV != 0)
-        NH_SS_z=NH_SS*pow(local_gammamultiplier*gJH0/1.0e-12,0.66)*pow(10.,0.173*(logT-4.));
+    if(CoolUVB.J_UV != 0)
+        NH_SS_z=NH_SS*pow(local_gammamultiplier*CoolUVB.gJH0/1.0e-12,0.66)*pow(10.,0.173*(logT-4.));
     else
         NH_SS_z=NH_SS*pow(10.,0.173*(logT-4.));
     double q_SS = nHcgs/NH_SS_z;
@@ -763,7 +800,7 @@ double CoolingRate(double logT, double rho, double n_elec_guess, int target)
         
 #ifdef COOL_METAL_LINES_BY_SPECIES
         /* can restrict to low-densities where not self-shielded, but let shieldfac (in ne) take care of this self-consistently */
-        if((J_UV != 0)&&(logT > Tmin+0.5*deltaT)&&(logT > 4.00))
+        if((CoolUVB.J_UV != 0)&&(logT > Tmin+0.5*deltaT)&&(logT > 4.00))
         {
             /* cooling rates tabulated for each species from Wiersma, Schaye, & Smith tables (2008) */
             LambdaMetal = GetCoolingRateWSpecies(nHcgs, logT, Z); //* nHcgs*nHcgs;
@@ -812,7 +849,7 @@ double CoolingRate(double logT, double rho, double n_elec_guess, int target)
         Heat = 0;  /* Now, collect heating terms */
 
 
-        if(J_UV != 0) {Heat += local_gammamultiplier * (nH0 * epsH0 + nHe0 * epsHe0 + nHep * epsHep) / nHcgs * shieldfac;} // shieldfac allows for self-shielding from background
+        if(CoolUVB.J_UV != 0) {Heat += local_gammamultiplier * (nH0 * CoolUVB.epsH0 + nHe0 * CoolUVB.epsHe0 + nHep * CoolUVB.epsHep) / nHcgs * shieldfac;} // shieldfac allows for self-shielding from background
 #if defined(RT_DISABLE_UV_BACKGROUND)
         Heat = 0;
 #endif
@@ -935,6 +972,7 @@ double CoolingRate(double logT, double rho, double n_elec_guess, int target)
 #if defined(OUTPUT_COOLRATE_DETAIL)
     if (target>=0){SphP[target].CoolingRate = Lambda; SphP[target].HeatingRate = Heat;}
 #endif
+    if(heat_out) {*heat_out = Heat;}
 
 #if defined(COOL_LOW_TEMPERATURES) && !defined(COOL_LOWTEMP_THIN_ONLY)
     /* if we are in the optically thick limit, we need to modify the cooling/heating rates according to the appropriate limits; 
@@ -1000,6 +1038,7 @@ double CoolingRate(double logT, double rho, double n_elec_guess, int target)
 
 #endif
     
+  if(ne_out) {*ne_out = n_elec;}
   return Q;
 } // ends CoolingRate
 
@@ -1009,6 +1048,18 @@ double CoolingRate(double logT, double rho, double n_elec_guess, int target)
 
 void InitCoolMemory(void)
 {
+#ifdef NODE_SHARED_TABLES
+    /* the rate tables are identical on all tasks, so they are kept once per node, in one block */
+    double *rates = (double *) shared_table_allocate("CoolRates", 10 * (NCOOLTAB + 1) * sizeof(double), &CoolRateTableWin);
+    BetaH0 = rates; BetaHep = rates + 1 * (NCOOLTAB + 1); AlphaHp = rates + 2 * (NCOOLTAB + 1); AlphaHep = rates + 3 * (NCOOLTAB + 1); Alphad = rates + 4 * (NCOOLTAB + 1);
+    AlphaHepp = rates + 5 * (NCOOLTAB + 1); GammaeH0 = rates + 6 * (NCOOLTAB + 1); GammaeHe0 = rates + 7 * (NCOOLTAB + 1); GammaeHep = rates + 8 * (NCOOLTAB + 1); Betaff = rates + 9 * (NCOOLTAB + 1);
+#ifdef COOL_METAL_LINES_BY_SPECIES
+    long i_nH=41; long i_T=176; long kspecies=(long)NUM_METAL_SPECIES-1;
+    SpCoolTable0 = (float *) shared_table_allocate("SpCoolTable0", (kspecies*i_nH*i_T)*sizeof(float), &SpCoolTableWin[0]);
+    if(All.ComovingIntegrationOn)
+        SpCoolTable1 = (float *) shared_table_allocate("SpCoolTable1", (kspecies*i_nH*i_T)*sizeof(float), &SpCoolTableWin[1]);
+#endif
+#else
     BetaH0 = (double *) mymalloc("BetaH0", (NCOOLTAB + 1) * sizeof(double));
     BetaHep = (double *) mymalloc("BetaHep", (NCOOLTAB + 1) * sizeof(double));
     AlphaHp = (double *) mymalloc("AlphaHp", (NCOOLTAB + 1) * sizeof(double));
@@ -1026,6 +1077,7 @@ void InitCoolMemory(void)
     if(All.ComovingIntegrationOn)
         SpCoolTable1 = (float *) mymalloc("SpCoolTable1",(kspecies*i_nH*i_T)*sizeof(float));
 #endif
+#endif
 }
 
 
@@ -1039,6 +1091,9 @@ void MakeCoolingTable(void)
 
     if(All.MinGasTemp > 0.0) {Tmin = log10(All.MinGasTemp);} else {Tmin=1.0;} 
     deltaT = (Tmax - Tmin) / NCOOLTAB;
+#ifdef NODE_SHARED_TABLES
+    if(!shared_table_is_writer()) {shared_table_sync(CoolRateTableWin); return;} /* the first task of the node fills the shared table */
+#endif
     
     /* minimum internal energy for neutral gas */
     for(i = 0; i <= NCOOLTAB; i++)
@@ -1064,6 +1119,9 @@ void MakeCoolingTable(void)
         if(631515.0 / T < 70) GammaeHep[i] = 5.68e-12 * sqrt(T) * exp(-631515.0 / T) * Tfact;
         
     }
+#ifdef NODE_SHARED_TABLES
+    shared_table_sync(CoolRateTableWin);
+#endif
 }
 
 
@@ -1099,6 +1157,16 @@ void ReadMultiSpeciesTables(int iT)
     
     fname=GetMultiSpeciesFilename(iT,0);
     if(ThisTask == 0) printf(" ..opening Cooling Table %s \n",fname);
+#ifdef NODE_SHARED_TABLES
+    /* the files hold the tables in the same (species, density, temperature) order as in memory: one task per node reads them into the shared copy */
+    if(shared_table_read_file(fname, SpCoolTable0, kspecies*i_nH*i_Temp*sizeof(float), SpCoolTableWin[0]) < kspecies*i_nH*i_Temp*sizeof(float)) {if(ThisTask == 0) printf(" Reached Cooling EOF! \n");}
+    if(All.ComovingIntegrationOn) {
+        fname=GetMultiSpeciesFilename(iT+1,0);
+        if(ThisTask == 0) printf(" ..opening (z+) Cooling Table %s \n",fname);
+        if(shared_table_read_file(fname, SpCoolTable1, kspecies*i_nH*i_Temp*sizeof(float), SpCoolTableWin[1]) < kspecies*i_nH*i_Temp*sizeof(float)) {if(ThisTask == 0) printf(" Reached Cooling EOF! \n");}
+    }
+    return;
+#endif
     if(!(fdcool = fopen(fname, "r"))) {
         printf(" Cannot read species cooling table in file `%s'\n", fname); endrun(456);}
     for(i=0;i<kspecies;i++) {
@@ -1175,7 +1243,8 @@ static float eH0[TABLESIZE], eHe[TABLESIZE], eHep[TABLESIZE];
 static int nheattab;		/* length of table */
 
 
-void ReadIonizeParams(char *fname)
+/* reads the columns of the TREECOOL file into the tables above; returns 0 if the file cannot be opened */
+static int ReadIonizeParamsFile(char *fname)
 {
     int i;
     FILE *fdcool;
@@ -1183,7 +1252,7 @@ void ReadIonizeParams(char *fname)
     if(!(fdcool = fopen(fname, "r")))
     {
         printf(" Cannot read ionization table in file `%s'\n", fname);
-        endrun(456);
+        return 0;
     }
     
     for(i = 0; i < TABLESIZE; i++)
@@ -1195,6 +1264,25 @@ void ReadIonizeParams(char *fname)
             break;
     
     fclose(fdcool);
+    return 1;
+}
+
+
+void ReadIonizeParams(char *fname)
+{
+    int i;
+    
+#ifdef NODE_SHARED_TABLES
+    /* only task 0 reads the file, and broadcasts the table, so the start-up does not open the same file on every task */
+    int ok = 1;
+    if(ThisTask == 0) {ok = ReadIonizeParamsFile(fname);}
+    MPI_Bcast(&ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if(!ok) {endrun(456);}
+    float *columns[7] = {inlogz, gH0, gHe, gHep, eH0, eHe, eHep};
+    for(i = 0; i < 7; i++) {MPI_Bcast(columns[i], TABLESIZE, MPI_FLOAT, 0, MPI_COMM_WORLD);}
+#else
+    if(!ReadIonizeParamsFile(fname)) {endrun(456);}
+#endif
     
     /*  nheattab is the number of entries in the table */
     
@@ -1228,7 +1316,7 @@ void IonizeParamsTable(void)
         /* in non-cosmological mode, still use, but adopt z=0 background */
         redshift = 0;
         /*
-         gJHe0 = gJHep = gJH0 = epsHe0 = epsHep = epsH0 = J_UV = 0;
+         CoolUVB.gJHe0 = CoolUVB.gJHep = CoolUVB.gJH0 = CoolUVB.epsHe0 = CoolUVB.epsHep = CoolUVB.epsH0 = CoolUVB.J_UV = 0;
          return;
          */
     }
@@ -1248,20 +1336,20 @@ void IonizeParamsTable(void)
     
     if(logz > inlogz[nheattab - 1] || gH0[ilow] == 0 || gH0[ilow + 1] == 0 || nheattab == 0)
     {
-        gJHe0 = gJHep = gJH0 = 0;
-        epsHe0 = epsHep = epsH0 = 0;
-        J_UV = 0;
+        CoolUVB.gJHe0 = CoolUVB.gJHep = CoolUVB.gJH0 = 0;
+        CoolUVB.epsHe0 = CoolUVB.epsHep = CoolUVB.epsH0 = 0;
+        CoolUVB.J_UV = 0;
         return;
     }
     else
-        J_UV = 1.e-21;		/* irrelevant as long as it's not 0 */
+        CoolUVB.J_UV = 1.e-21;		/* irrelevant as long as it's not 0 */
     
-    gJH0 = JAMPL * pow(10., (dzhi * log10(gH0[ilow]) + dzlow * log10(gH0[ilow + 1])) / (dzlow + dzhi));
-    gJHe0 = JAMPL * pow(10., (dzhi * log10(gHe[ilow]) + dzlow * log10(gHe[ilow + 1])) / (dzlow + dzhi));
-    gJHep = JAMPL * pow(10., (dzhi * log10(gHep[ilow]) + dzlow * log10(gHep[ilow + 1])) / (dzlow + dzhi));
-    epsH0 = JAMPL * pow(10., (dzhi * log10(eH0[ilow]) + dzlow * log10(eH0[ilow + 1])) / (dzlow + dzhi));
-    epsHe0 = JAMPL * pow(10., (dzhi * log10(eHe[ilow]) + dzlow * log10(eHe[ilow + 1])) / (dzlow + dzhi));
-    epsHep = JAMPL * pow(10., (dzhi * log10(eHep[ilow]) + dzlow * log10(eHep[ilow + 1])) / (dzlow + dzhi));
+    CoolUVB.gJH0 = JAMPL * pow(10., (dzhi * log10(gH0[ilow]) + dzlow * log10(gH0[ilow + 1])) / (dzlow + dzhi));
+    CoolUVB.gJHe0 = JAMPL * pow(10., (dzhi * log10(gHe[ilow]) + dzlow * log10(gHe[ilow + 1])) / (dzlow + dzhi));
+    CoolUVB.gJHep = JAMPL * pow(10., (dzhi * log10(gHep[ilow]) + dzlow * log10(gHep[ilow + 1])) / (dzlow + dzhi));
+    CoolUVB.epsH0 = JAMPL * pow(10., (dzhi * log10(eH0[ilow]) + dzlow * log10(eH0[ilow + 1])) / (dzlow + dzhi));
+    CoolUVB.epsHe0 = JAMPL * pow(10., (dzhi * log10(eHe[ilow]) + dzlow * log10(eHe[ilow + 1])) / (dzlow + dzhi));
+    CoolUVB.epsHep = JAMPL * pow(10., (dzhi * log10(eHep[ilow]) + dzlow * log10(eHep[ilow + 1])) / (dzlow + dzhi));
     
     return;
 }
@@ -1269,9 +1357,9 @@ void IonizeParamsTable(void)
 
 void SetZeroIonization(void)
 {
-    gJHe0 = gJHep = gJH0 = 0;
-    epsHe0 = epsHep = epsH0 = 0;
-    J_UV = 0;
+    CoolUVB.gJHe0 = CoolUVB.gJHep = CoolUVB.gJH0 = 0;
+    CoolUVB.epsHe0 = CoolUVB.epsHep = CoolUVB.epsH0 = 0;
+    CoolUVB.J_UV = 0;
 }
 
 
@@ -1287,9 +1375,9 @@ void IonizeParamsFunction(void)
     double Jold = -1.0;
     double redshift;
     
-    J_UV = 0.;
-    gJHe0 = gJHep = gJH0 = 0.;
-    epsHe0 = epsHep = epsH0 = 0.;
+    CoolUVB.J_UV = 0.;
+    CoolUVB.gJHe0 = CoolUVB.gJHep = CoolUVB.gJH0 = 0.;
+    CoolUVB.epsHe0 = CoolUVB.epsHep = CoolUVB.epsH0 = 0.;
     
     
     if(All.ComovingIntegrationOn)	/* analytically compute params from power law J_nu */
@@ -1297,27 +1385,27 @@ void IonizeParamsFunction(void)
         redshift = 1 / All.Time - 1;
         
         if(redshift >= 6)
-            J_UV = 0.;
+            CoolUVB.J_UV = 0.;
         else
         {
             if(redshift >= 3)
-                J_UV = 4e-22 / (1 + redshift);
+                CoolUVB.J_UV = 4e-22 / (1 + redshift);
             else
             {
                 if(redshift >= 2)
-                    J_UV = 1e-22;
+                    CoolUVB.J_UV = 1e-22;
                 else
-                    J_UV = 1.e-22 * pow(3.0 / (1 + redshift), -3.0);
+                    CoolUVB.J_UV = 1.e-22 * pow(3.0 / (1 + redshift), -3.0);
             }
         }
         
-        if(J_UV == Jold)
+        if(CoolUVB.J_UV == Jold)
             return;
         
         
-        Jold = J_UV;
+        Jold = CoolUVB.J_UV;
         
-        if(J_UV == 0)
+        if(CoolUVB.J_UV == 0)
             return;
         
         
@@ -1344,27 +1432,27 @@ void IonizeParamsFunction(void)
             eint += fac * (tinv - 1.) * at;
         }
         
-        gJH0 = a0 * gint / planck;
-        epsH0 = a0 * eint * (e0_H / planck);
-        gJHep = gJH0 * pow(e0_H / e0_Hep, UVALPHA) / 4.0;
-        epsHep = epsH0 * pow((e0_H / e0_Hep), UVALPHA - 1.) / 4.0;
+        CoolUVB.gJH0 = a0 * gint / planck;
+        CoolUVB.epsH0 = a0 * eint * (e0_H / planck);
+        CoolUVB.gJHep = CoolUVB.gJH0 * pow(e0_H / e0_Hep, UVALPHA) / 4.0;
+        CoolUVB.epsHep = CoolUVB.epsH0 * pow((e0_H / e0_Hep), UVALPHA - 1.) / 4.0;
         
         at = 7.83e-18;
         beta = 1.66;
         s = 2.05;
         
-        gJHe0 = (at / planck) * pow((e0_H / e0_He), UVALPHA) *
+        CoolUVB.gJHe0 = (at / planck) * pow((e0_H / e0_He), UVALPHA) *
         (beta / (UVALPHA + s) + (1. - beta) / (UVALPHA + s + 1));
-        epsHe0 = (e0_He / planck) * at * pow(e0_H / e0_He, UVALPHA) *
+        CoolUVB.epsHe0 = (e0_He / planck) * at * pow(e0_H / e0_He, UVALPHA) *
         (beta / (UVALPHA + s - 1) + (1 - 2 * beta) / (UVALPHA + s) - (1 - beta) / (UVALPHA + s + 1));
         
         pi = M_PI;
-        gJH0 *= 4. * pi * J_UV;
-        gJHep *= 4. * pi * J_UV;
-        gJHe0 *= 4. * pi * J_UV;
-        epsH0 *= 4. * pi * J_UV;
-        epsHep *= 4. * pi * J_UV;
-        epsHe0 *= 4. * pi * J_UV;
+        CoolUVB.gJH0 *= 4. * pi * CoolUVB.J_UV;
+        CoolUVB.gJHep *= 4. * pi * CoolUVB.J_UV;
+        CoolUVB.gJHe0 *= 4. * pi * CoolUVB.J_UV;
+        CoolUVB.epsH0 *= 4. * pi * CoolUVB.J_UV;
+        CoolUVB.epsHep *= 4. * pi * CoolUVB.J_UV;
+        CoolUVB.epsHe0 *= 4. * pi * CoolUVB.J_UV;
     }
 }
 
@@ -29,6 +29,7 @@ double find_abundances_and_rates(double logT, double rho, int target, double shi
                                  double *ne_guess, double *nH0_guess, double *nHp_guess, double *nHe0_guess, double *nHep_guess, double *nHepp_guess);
 double convert_u_to_temp(double u, double rho, int target, double *ne_guess, double *nH0_guess, double *nHp_guess, double *nHe0_guess, double *nHep_guess, double *nHepp_guess);
 double CoolingRate(double logT, double rho, double nelec, int target);
+double CoolingRateScaledZ(double logT, double rho, double n_elec_guess, int target, double zscale, double *ne_out, double *heat_out);
 double CoolingRateFromU(double u, double rho, double ne_guess, int target);
 double DoCooling(double u_old, double rho, double dt, double ne_guess, int target);
 double GetCoolingTime(double u_old, double rho,  double ne_guess, int target);
@@ -41,3 +42,11 @@ void InitGrackle(void);
 double CallGrackle(double u_old, double rho, double dt, double ne_guess, int target, int mode);
 #endif
 
+#ifdef COOL_TABULATED_RATES
+#if defined(RT_CHEM_PHOTOION) || defined(RT_PHOTOELECTRIC) || defined(RT_HARD_XRAY) || defined(RT_SOFT_XRAY) || defined(RT_INFRARED) || defined(COOL_GRACKLE) || defined(OUTPUT_COOLRATE_DETAIL) || (defined(COOL_LOW_TEMPERATURES) && !defined(COOL_LOWTEMP_THIN_ONLY))
+#error "COOL_TABULATED_RATES tabulates the rates without the particle-dependent radiation and opacity terms: it cannot be combined with the RT heating/chemistry modules, COOL_GRACKLE, OUTPUT_COOLRATE_DETAIL, or the optically-thick limit of COOL_LOW_TEMPERATURES (set COOL_LOWTEMP_THIN_ONLY)"
+#endif
+void cooling_table_update(void);
+int cooling_table_rate(double u, double rho, int target, double *Q);
+void cooling_table_accuracy_check(void);
+#endif
@@ -0,0 +1,375 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../allvars.h"
+#include "../proto.h"
+
+#include "./cooling.h"
+
+/*! \file cooling_tables.c
+ *  \brief pre-computed tables of the net cooling rate, replacing the direct calculation in CoolingRateFromU()
+ *
+ *  The heating and cooling rates (without the hydro term, which is added per particle) and the electron abundance are
+ *  tabulated as a function of hydrogen number density, specific internal energy, metallicity and redshift. The tables
+ *  are filled with the direct calculation (convert_u_to_temp and CoolingRate, with no target particle), so a rate
+ *  evaluation in the cooling solver becomes a single multi-linear interpolation. Heating and cooling are stored (and
+ *  interpolated in density and energy) as logarithms, separately: both are close to power laws over most of the grid,
+ *  which keeps the error small across the steep features (the collisional-excitation edge near 10^4 K, and the
+ *  self-shielding cutoff of the UV background), while their difference can cross zero. The energy (not temperature)
+ *  is tabulated, since that is what the solver iterates on: this also removes the temperature/ionization iteration
+ *  from every evaluation. In the metallicity direction, the interpolation weights are linear in Z (the nodes are
+ *  logarithmically spaced), since the metal-line cooling is linear in Z; the metal abundances are taken in solar
+ *  ratios, scaled by the total metallicity of the particle, while the helium abundance and mean molecular weight
+ *  are those of primordial gas (as in the direct calculation without a target particle).
+ *
+ *  In redshift, two planes are held, at the edges of the current interval in log(1+z) (aligned with the intervals
+ *  of the metal-line tables); when the run moves on to the next interval, the plane at the shared edge is kept and
+ *  only the other one is re-computed. Non-cosmological runs use a single plane (the UV background at z=0). The
+ *  grid points of a plane are divided over all tasks (and over the threads of each task) to compute it; the
+ *  tables live in MPI shared-memory windows, one copy per node, which the tasks of each node fill directly, before
+ *  the node leaders combine the parts of the other nodes.
+ *
+ *  After every plane is computed, cooling_table_accuracy_check() compares the interpolated rates at random points
+ *  between the nodes to the direct calculation, and the rates of a sample of the active gas particles to those of the
+ *  direct path of CoolingRateFromU() (which, unlike the table, uses the actual abundances of each particle), and writes
+ *  the error statistics of both to 'cooling_table_check.txt'.
+ */
+/*
+ * This file was written for GIZMO.
+ */
+
+#ifdef COOL_TABULATED_RATES
+
+/* grid of the tables: log10 of the hydrogen number density (cm^-3) and of the specific energy (erg/g) in cgs units, and
+    the metallicity in solar units (node 0 at Z=0, then logarithmically spaced). these can be overridden at compile time */
+#ifndef COOL_TABLE_LOGNH_MIN
+#define COOL_TABLE_LOGNH_MIN  (-8.0)
+#endif
+#ifndef COOL_TABLE_DLOGNH
+#define COOL_TABLE_DLOGNH     (0.025)
+#endif
+#ifndef COOL_TABLE_NNH
+#define COOL_TABLE_NNH        561     /* up to n_H = 10^6 cm^-3 */
+#endif
+#ifndef COOL_TABLE_LOGU_MIN
+#define COOL_TABLE_LOGU_MIN   (8.5)
+#endif
+#ifndef COOL_TABLE_DLOGU
+#define COOL_TABLE_DLOGU      (0.01)
+#endif
+#ifndef COOL_TABLE_NU
+#define COOL_TABLE_NU         901     /* up to u = 10^17.5 erg/g (T ~ 10 K to 10^9 K) */
+#endif
+#ifdef COOL_METAL_LINES_BY_SPECIES
+#ifndef COOL_TABLE_LOGZ_MIN
+#define COOL_TABLE_LOGZ_MIN   (-4.0)
+#endif
+#ifndef COOL_TABLE_DLOGZ
+#define COOL_TABLE_DLOGZ      (0.5)
+#endif
+#ifndef COOL_TABLE_NZ
+#define COOL_TABLE_NZ         12      /* Z=0, then 10^-4 to 10 times solar */
+#endif
+#else
+#define COOL_TABLE_NZ         1       /* the rates do not depend on metallicity */
+#endif
+#define COOL_TABLE_NZ_PER_DEX 48      /* redshift intervals per dex in (1+z): the same as the metal-line tables */
+#ifndef COOL_TABLE_CHECK_SAMPLES
+#define COOL_TABLE_CHECK_SAMPLES 4096 /* number of random points compared to the direct calculation after each new plane */
+#endif
+#ifndef COOL_TABLE_CHECK_PARTICLES
+#define COOL_TABLE_CHECK_PARTICLES 4096 /* (maximum) number of active gas particles compared to CoolingRateFromU() at the same times (set both to 0 to disable the check) */
+#endif
+#ifndef COOL_TABLE_CHECK_TIME
+#define COOL_TABLE_CHECK_TIME 3.15e17 /* (in s) net rates with a heating or cooling time longer than this (10 Gyr) are not significant in the check */
+#endif
+
+#define COOL_TABLE_NVAL   3           /* values per grid point: log10 of the heating and cooling rates (/n_H^2, in cgs), and of n_e/n_H */
+#define COOL_TABLE_LOG_ZERO (-99.)    /* value stored for a rate (or abundance) of zero */
+#define COOL_TABLE_SIZE   ((size_t) COOL_TABLE_NZ * COOL_TABLE_NNH * COOL_TABLE_NU * COOL_TABLE_NVAL)
+
+static struct cooling_table_data
+{
+    int NPlanes;            /* number of redshift planes in use: 1 for non-cosmological runs, otherwise 2 */
+    int Bin;                /* redshift interval bracketed by the planes (-1 before the first plane is computed) */
+    double XPlane[2];       /* log10(1+z) of each plane */
+    double WeightZ;         /* interpolation weight of plane 1 at the current time */
+    float *Plane[2];        /* the tables, ordered [metallicity][density][energy][value], in the node-shared windows */
+    MPI_Win Win[2];         /* node-shared windows holding the planes (see shared_tables.c) */
+    int Bypass;             /* if set, cooling_table_rate() declines every particle, so CoolingRateFromU() uses the direct calculation */
+}
+CoolTable = {0, -1};
+
+
+/*! metallicity (in solar units) of node iz of the table */
+static double cooling_table_zscale(int iz)
+{
+#ifdef COOL_METAL_LINES_BY_SPECIES
+    if(iz <= 0) {return 0;}
+    return pow(10., COOL_TABLE_LOGZ_MIN + (iz - 1) * COOL_TABLE_DLOGZ);
+#else
+    return 1;
+#endif
+}
+
+
+/*! interpolates the planes at the current redshift, for log10(n_H) and log10(u) in cgs units and metallicity zscale (in solar
+    units). returns 0 (leaving Q and ne untouched) if the point is outside of the tabulated range */
+static int cooling_table_interpolate(double lognh, double logu, double zscale, double *Q, double *ne)
+{
+    int in, iu, iz = 0, p, a, b, c;
+    double xn = (lognh - COOL_TABLE_LOGNH_MIN) / COOL_TABLE_DLOGNH, xu = (logu - COOL_TABLE_LOGU_MIN) / COOL_TABLE_DLOGU, wz = 0;
+    if(CoolTable.Bin < 0) {return 0;}
+    if(!(xn >= 0) || !(xu >= 0) || (xn > COOL_TABLE_NNH - 1) || (xu > COOL_TABLE_NU - 1)) {return 0;} /* (also catches nan) */
+    in = (int) xn; if(in > COOL_TABLE_NNH - 2) {in = COOL_TABLE_NNH - 2;}
+    iu = (int) xu; if(iu > COOL_TABLE_NU - 2) {iu = COOL_TABLE_NU - 2;}
+    double wn = xn - in, wu = xu - iu;
+#ifdef COOL_METAL_LINES_BY_SPECIES
+    if(zscale > cooling_table_zscale(COOL_TABLE_NZ - 1)) {return 0;}
+    if(zscale < 0) {zscale = 0;}
+    while((iz < COOL_TABLE_NZ - 2) && (zscale > cooling_table_zscale(iz + 1))) {iz++;}
+    wz = (zscale - cooling_table_zscale(iz)) / (cooling_table_zscale(iz + 1) - cooling_table_zscale(iz)); /* linear in Z, between logarithmically-spaced nodes */
+#endif
+    double val[COOL_TABLE_NVAL] = {0};
+    for(p = 0; p < CoolTable.NPlanes; p++)
+    {
+        double wp = (CoolTable.NPlanes > 1) ? ((p == 0) ? 1 - CoolTable.WeightZ : CoolTable.WeightZ) : 1;
+        for(a = 0; a < ((COOL_TABLE_NZ > 1) ? 2 : 1); a++)
+        {
+            double wa = wp * ((COOL_TABLE_NZ > 1) ? (a ? wz : 1 - wz) : 1), va[COOL_TABLE_NVAL] = {0};
+            for(b = 0; b < 2; b++)
+            {
+                double wb = (b ? wn : 1 - wn);
+                const float *row = CoolTable.Plane[p] + (((size_t) (iz + a) * COOL_TABLE_NNH + (in + b)) * COOL_TABLE_NU + iu) * COOL_TABLE_NVAL;
+                for(c = 0; c < 2; c++)
+                {
+                    double wc = wb * (c ? wu : 1 - wu);
+                    va[0] += wc * row[c * COOL_TABLE_NVAL + 0];
+                    va[1] += wc * row[c * COOL_TABLE_NVAL + 1];
+                    va[2] += wc * row[c * COOL_TABLE_NVAL + 2];
+                }
+            }
+            val[0] += wa * (pow(10., va[0]) - pow(10., va[1])); val[1] += wa * pow(10., va[2]); /* logarithmic in n_H and u, linear in Z and redshift */
+        }
+    }
+    *Q = val[0]; *ne = val[1];
+    return 1;
+}
+
+
+/*! tabulated version of CoolingRateFromU() for particle target (u and rho in physical cgs units): returns 0 if the particle is
+    outside of the tabulated range (the caller then uses the direct calculation), otherwise sets Q (including the hydro term,
+    as CoolingRate does) and the particle's electron abundance */
+int cooling_table_rate(double u, double rho, int target, double *Q)
+{
+    double nHcgs = HYDROGEN_MASSFRAC * rho / PROTONMASS, zscale = 1, ne;
+    if(CoolTable.Bypass) {return 0;}
+#ifdef COOL_METAL_LINES_BY_SPECIES
+    zscale = P[target].Metallicity[0] / All.SolarAbundances[0];
+#endif
+    if(!cooling_table_interpolate(log10(nHcgs), log10(u), zscale, Q, &ne)) {return 0;}
+    SphP[target].Ne = ne;
+#ifndef COOLING_OPERATOR_SPLIT
+    *Q += SphP[target].DtInternalEnergy / nHcgs;
+#endif
+    return 1;
+}
+
+
+/*! sets the time (and with it the UV background and the redshift-dependent terms of the rates) at which the rates are evaluated */
+static void cooling_table_set_time(double a)
+{
+    All.Time = a;
+    set_cosmo_factors_for_current_time();
+    IonizeParams();
+}
+
+
+/*! fills plane p for log10(1+z)=x. every task computes a share of the rows (one metallicity and density, all energies) and writes
+    them directly into its node's copy; the node leaders then sum the copies (the rows of other nodes are zero in each) */
+static void cooling_table_compute_plane(int p, double x)
+{
+    int row, nrows = COOL_TABLE_NZ * COOL_TABLE_NNH;
+    double time_save = All.Time, t0 = my_second();
+
+    if(shared_table_is_writer()) {memset(CoolTable.Plane[p], 0, COOL_TABLE_SIZE * sizeof(float));}
+    shared_table_sync(CoolTable.Win[p]);
+
+    if(All.ComovingIntegrationOn)
+    {
+        /* evaluate just inside the interval, so the metal-line tables (interpolated within the interval) are used at the correct edge */
+        double a = pow(10., -x);
+        if(x <= CoolTable.Bin / (double) COOL_TABLE_NZ_PER_DEX) {a *= 1 - 1.e-9;} else {a *= 1 + 1.e-9;}
+        cooling_table_set_time(a);
+    }
+    for(row = ThisTask; row < nrows; row += NTask)
+    {
+        int iz = row / COOL_TABLE_NNH, in = row % COOL_TABLE_NNH, iu;
+        double zscale = cooling_table_zscale(iz), rho = pow(10., COOL_TABLE_LOGNH_MIN + in * COOL_TABLE_DLOGNH) * PROTONMASS / HYDROGEN_MASSFRAC;
+        float *out = CoolTable.Plane[p] + (size_t) row * COOL_TABLE_NU * COOL_TABLE_NVAL;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 8)
+#endif
+        for(iu = 0; iu < COOL_TABLE_NU; iu++)
+        {
+            double u = pow(10., COOL_TABLE_LOGU_MIN + iu * COOL_TABLE_DLOGU), ne = 0, nH0, nHp, nHe0, nHep, nHepp, ne_out = 0, heat = 0;
+            double temp = convert_u_to_temp(u, rho, -1, &ne, &nH0, &nHp, &nHe0, &nHep, &nHepp);
+            double Q = CoolingRateScaledZ(log10(temp), rho, ne, -1, zscale, &ne_out, &heat), cool = heat - Q;
+            if(cool < 0) {heat = Q; cool = 0;} /* (net 'cooling' can be negative, from Compton heating off the CMB: it is then counted as heating) */
+            out[iu * COOL_TABLE_NVAL + 0] = (float) ((heat > 0) ? log10(heat) : COOL_TABLE_LOG_ZERO);
+            out[iu * COOL_TABLE_NVAL + 1] = (float) ((cool > 0) ? log10(cool) : COOL_TABLE_LOG_ZERO);
+            out[iu * COOL_TABLE_NVAL + 2] = (float) ((ne_out > 0) ? log10(ne_out) : COOL_TABLE_LOG_ZERO);
+        }
+    }
+    if(All.ComovingIntegrationOn) {cooling_table_set_time(time_save);}
+
+    shared_table_sync(CoolTable.Win[p]);
+    if(shared_table_leader_comm() != MPI_COMM_NULL) {MPI_Allreduce(MPI_IN_PLACE, CoolTable.Plane[p], (int) COOL_TABLE_SIZE, MPI_FLOAT, MPI_SUM, shared_table_leader_comm());}
+    shared_table_sync(CoolTable.Win[p]);
+    CoolTable.XPlane[p] = x;
+    PRINT_STATUS(" ..computed cooling-rate table for log10(1+z)=%g (%d x %d x %d points) in %g sec", x, COOL_TABLE_NZ, COOL_TABLE_NNH, COOL_TABLE_NU, timediff(t0, my_second()));
+}
+
+
+/*! allocates the node-shared windows for the planes (collective, called once) */
+static void cooling_table_allocate(void)
+{
+    int p;
+    for(p = 0; p < 2; p++) {CoolTable.Plane[p] = (float *) shared_table_allocate("CoolTablePlane", COOL_TABLE_SIZE * sizeof(float), &CoolTable.Win[p]);}
+    if(ThisTask == 0) {printf("Cooling-rate tables: %g MB per plane (one copy per node)\n", COOL_TABLE_SIZE * sizeof(float) / (1024. * 1024.));}
+}
+
+
+/*! makes sure the planes bracket the current redshift (computing new planes as needed), and sets the interpolation weight between
+    them. called by all tasks when the time changes, after the UV background and metal-line tables have been updated */
+void cooling_table_update(void)
+{
+    int bin, p;
+    if(CoolTable.Bin < 0 && !CoolTable.Plane[0]) {cooling_table_allocate();}
+    if(!All.ComovingIntegrationOn)
+    {
+        if(CoolTable.Bin < 0) {CoolTable.NPlanes = 1; CoolTable.WeightZ = 0; cooling_table_compute_plane(0, 0); CoolTable.Bin = 0; cooling_table_accuracy_check();}
+        return;
+    }
+    double x = log10(1 / All.Time);
+    bin = (int) floor(x * COOL_TABLE_NZ_PER_DEX);
+    if(bin != CoolTable.Bin)
+    {
+        double x_edge[2] = {bin / (double) COOL_TABLE_NZ_PER_DEX, (bin + 1) / (double) COOL_TABLE_NZ_PER_DEX};
+        int have[2] = {0, 0};
+        if(CoolTable.Bin >= 0) /* keep a plane at a shared edge (moving to lower redshift, the old lower edge is the new upper edge) */
+        {
+            if(CoolTable.XPlane[0] == x_edge[1]) {float *tp = CoolTable.Plane[0]; MPI_Win tw = CoolTable.Win[0]; CoolTable.Plane[0] = CoolTable.Plane[1]; CoolTable.Win[0] = CoolTable.Win[1]; CoolTable.Plane[1] = tp; CoolTable.Win[1] = tw; CoolTable.XPlane[1] = x_edge[1]; have[1] = 1;}
+            else if(CoolTable.XPlane[1] == x_edge[0]) {float *tp = CoolTable.Plane[1]; MPI_Win tw = CoolTable.Win[1]; CoolTable.Plane[1] = CoolTable.Plane[0]; CoolTable.Win[1] = CoolTable.Win[0]; CoolTable.Plane[0] = tp; CoolTable.Win[0] = tw; CoolTable.XPlane[0] = x_edge[0]; have[0] = 1;}
+        }
+        CoolTable.NPlanes = 2; CoolTable.Bin = bin;
+        for(p = 0; p < 2; p++) {if(!have[p]) {cooling_table_compute_plane(p, x_edge[p]);}}
+        CoolTable.WeightZ = (x - CoolTable.XPlane[0]) / (CoolTable.XPlane[1] - CoolTable.XPlane[0]);
+        cooling_table_accuracy_check(); /* (after the weight for the current time is set) */
+        return;
+    }
+    CoolTable.WeightZ = (x - CoolTable.XPlane[0]) / (CoolTable.XPlane[1] - CoolTable.XPlane[0]);
+}
+
+
+/*! deterministic uniform random number in [0,1) for the sample points of the accuracy check */
+static double cooling_table_sample(unsigned long long seed)
+{
+    seed += 0x9E3779B97F4A7C15ULL;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+    seed ^= seed >> 31;
+    return (double) (seed >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+/*! compares cooling_table_rate() to the direct path of CoolingRateFromU() for up to COOL_TABLE_CHECK_PARTICLES active gas particles
+    (a regular subset of those on each task), with the particles' own density, energy, electron abundance and composition. this
+    measures the full error of the table in the run, including the approximations in the composition (primordial helium, metals in
+    solar ratios) which the random points cannot see. the hydro term is set to zero for the comparison (it is added identically by
+    both paths), and the particle fields written by the rate routines are restored afterwards. adds the number of particles, the
+    sum of the squared relative errors of the net rate, and the number above 1 percent to loc[], and sets the maximum error */
+static void cooling_table_particle_check(double *loc, double *maxerr)
+{
+    int i, n_active = 0, stride, nper = (COOL_TABLE_CHECK_PARTICLES + NTask - 1) / NTask;
+    *maxerr = 0;
+    if(nper <= 0) {return;}
+    for(i = 0; i < N_gas; i++) {if(P[i].Type == 0 && P[i].Mass > 0 && SphP[i].Density > 0 && TimeBinActive[P[i].TimeBin]) {n_active++;}}
+    stride = (n_active + nper - 1) / nper; if(stride < 1) {stride = 1;}
+    for(i = 0, n_active = 0; i < N_gas; i++)
+    {
+        if(!(P[i].Type == 0 && P[i].Mass > 0 && SphP[i].Density > 0 && TimeBinActive[P[i].TimeBin])) {continue;}
+        if((n_active++) % stride) {continue;}
+        double rho = SphP[i].Density * All.cf_a3inv * All.UnitDensity_in_cgs * All.HubbleParam * All.HubbleParam; /* physical cgs units, as in DoCooling */
+        double u = DMAX(All.MinEgySpec, SphP[i].InternalEnergy) * All.UnitPressure_in_cgs / All.UnitDensity_in_cgs, nHcgs = HYDROGEN_MASSFRAC * rho / PROTONMASS;
+        double ne_save = SphP[i].Ne, Q_table, Q_direct, err;
+#ifndef COOLING_OPERATOR_SPLIT
+        double dtu_save = SphP[i].DtInternalEnergy; SphP[i].DtInternalEnergy = 0;
+#endif
+        int in_table = cooling_table_rate(u, rho, i, &Q_table);
+        SphP[i].Ne = ne_save;
+        if(in_table)
+        {
+            CoolTable.Bypass = 1; Q_direct = CoolingRateFromU(u, rho, ne_save, i); CoolTable.Bypass = 0;
+            SphP[i].Ne = ne_save;
+            err = fabs(Q_table - Q_direct) / DMAX(fabs(Q_direct), u * rho / (nHcgs * nHcgs * COOL_TABLE_CHECK_TIME));
+            loc[0] += 1; loc[1] += err * err; if(err > 0.01) {loc[2] += 1;} if(err > *maxerr) {*maxerr = err;}
+        }
+#ifndef COOLING_OPERATOR_SPLIT
+        SphP[i].DtInternalEnergy = dtu_save;
+#endif
+    }
+}
+
+
+/*! compares the tabulated rates to the direct calculation at the current time, at COOL_TABLE_CHECK_SAMPLES random points (divided
+    over the tasks) in the tabulated range, and for a sample of the active gas particles (see cooling_table_particle_check), and
+    writes the error statistics to 'cooling_table_check.txt' (one line per call): for the random points, the rms and maximum of the
+    relative error in the net rate, the fraction of points with a relative error above 1 percent, and the rms relative error of n_e;
+    then the number of particles compared, and the rms, maximum, and fraction above 1 percent of their relative error in the net rate. the error in the rate is taken relative to |Q_direct|, or to the rate which changes u on a time-scale
+    COOL_TABLE_CHECK_TIME if that is larger (so points where the net rate is negligible, or crosses zero, do not dominate) */
+void cooling_table_accuracy_check(void)
+{
+    int k, nsamples = COOL_TABLE_CHECK_SAMPLES;
+    double loc[4] = {0, 0, 0, 0}, sum[4], maxerr_loc = 0, maxerr, ploc[3] = {0, 0, 0}, psum[3], pmaxerr_loc, pmaxerr; char buf[500]; FILE *fd;
+    if(nsamples <= 0 && COOL_TABLE_CHECK_PARTICLES <= 0) {return;}
+    for(k = ThisTask; k < nsamples; k += NTask)
+    {
+        unsigned long long seed = 1000003ULL * (unsigned long long) (CoolTable.Bin + 1000) + 3ULL * k;
+        double lognh = COOL_TABLE_LOGNH_MIN + cooling_table_sample(seed) * COOL_TABLE_DLOGNH * (COOL_TABLE_NNH - 1);
+        double logu = COOL_TABLE_LOGU_MIN + cooling_table_sample(seed + 1) * COOL_TABLE_DLOGU * (COOL_TABLE_NU - 1), zscale = 1;
+#ifdef COOL_METAL_LINES_BY_SPECIES
+        zscale = pow(10., COOL_TABLE_LOGZ_MIN + cooling_table_sample(seed + 2) * COOL_TABLE_DLOGZ * (COOL_TABLE_NZ - 2));
+#endif
+        double rho = pow(10., lognh) * PROTONMASS / HYDROGEN_MASSFRAC, u = pow(10., logu), ne = 0, nH0, nHp, nHe0, nHep, nHepp, ne_direct = 0, Q_table, ne_table, err;
+        double temp = convert_u_to_temp(u, rho, -1, &ne, &nH0, &nHp, &nHe0, &nHep, &nHepp);
+        double Q_direct = CoolingRateScaledZ(log10(temp), rho, ne, -1, zscale, &ne_direct, NULL);
+        if(!cooling_table_interpolate(lognh, logu, zscale, &Q_table, &ne_table)) {continue;}
+        err = fabs(Q_table - Q_direct) / DMAX(fabs(Q_direct), u * rho / (pow(10., 2 * lognh) * COOL_TABLE_CHECK_TIME));
+        loc[0] += 1; loc[1] += err * err; if(err > 0.01) {loc[2] += 1;} if(err > maxerr_loc) {maxerr_loc = err;}
+        err = fabs(ne_table - ne_direct) / (ne_direct + ne_table + MIN_REAL_NUMBER) * 2; loc[3] += err * err;
+    }
+    cooling_table_particle_check(ploc, &pmaxerr_loc);
+    MPI_Reduce(loc, sum, 4, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&maxerr_loc, &maxerr, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(ploc, psum, 3, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&pmaxerr_loc, &pmaxerr, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if(ThisTask == 0 && (sum[0] > 0 || psum[0] > 0))
+    {
+        double n = DMAX(sum[0], 1), np = DMAX(psum[0], 1);
+        printf(" ..cooling-rate table accuracy (%d points): rms rel. error %g, max %g, fraction >1%% %g, n_e rms rel. error %g\n",
+               (int) sum[0], sqrt(sum[1] / n), maxerr, sum[2] / n, sqrt(sum[3] / n));
+        printf(" ..cooling-rate table accuracy vs. CoolingRateFromU (%d active gas particles): rms rel. error %g, max %g, fraction >1%% %g\n",
+               (int) psum[0], sqrt(psum[1] / np), pmaxerr, psum[2] / np);
+        sprintf(buf, "%s%s", All.OutputDir, "cooling_table_check.txt");
+        if(!(fd = fopen(buf, "a"))) {printf("error in opening file '%s'\n", buf); endrun(8742);}
+        fprintf(fd, "%g %g %d %g %g %g %g %d %g %g %g\n", All.Time, (All.ComovingIntegrationOn ? 1 / All.Time - 1 : 0), (int) sum[0], sqrt(sum[1] / n), maxerr, sum[2] / n, sqrt(sum[3] / n),
+                (int) psum[0], sqrt(psum[1] / np), pmaxerr, psum[2] / np);
+        fclose(fd);
+    }
+}
+
+#endif
@@ -97,6 +97,10 @@ static float *domainWork;	/*!< a table that gives the total "work" due to the pa
 static float *domainWorkSph;	/*!< a table that gives the total "work" due to the particles stored by each processor */
 static int *domainCount;	/*!< a table that gives the total number of particles held by each processor */
 static int *domainCountSph;	/*!< a table that gives the total number of SPH particles held by each processor */
+#ifdef DOMAIN_MULTICONSTRAINT
+static float *domainWorkMeasured;	/*!< measured (wallclock) cost of the non-gravity physics in each top-level leaf, for each group of time bins (DOMAIN_COST_BINGROUPS entries per leaf) */
+static int DomainUseMeasured;	/*!< set if any measured cost is available, in which case it replaces the estimated hydro work as balancing constraint */
+#endif
 #ifdef SEPARATE_STELLARDOMAINDECOMP
 //static float *domainWorkStars;
 static int *domainCountStars;
@@ -114,6 +118,21 @@ static long long totpartcount;
 
 static int UseAllParticles;
 
+#ifdef DOMAIN_INCREMENTAL
+#ifndef DOMAIN_INCREMENTAL_FULL_EVERY
+#define DOMAIN_INCREMENTAL_FULL_EVERY 16    /* maximum number of incremental decompositions between two full ones */
+#endif
+#ifndef DOMAIN_INCREMENTAL_MAXSHIFT
+#define DOMAIN_INCREMENTAL_MAXSHIFT   4     /* maximum number of top-level leaves each split point can move in one incremental decomposition */
+#endif
+#ifndef DOMAIN_INCREMENTAL_TOLERANCE
+#define DOMAIN_INCREMENTAL_TOLERANCE  1.1   /* fall back to a full decomposition if the imbalance exceeds this factor times that of the last full one */
+#endif
+static int DomainIncrementalValid = 0;      /*!< set when the current top-level tree and domain lists came from a completed decomposition */
+static int DomainIncrementalCount = 0;      /*!< number of incremental decompositions done since the last full one */
+static double DomainImbalanceLastFull = 1;  /*!< load imbalance (max/mean of domain_task_load_imbalance) reached by the last full decomposition */
+#endif
+
 /*! This is the main routine for the domain decomposition.  It acts as a
  *  driver routine that allocates various temporary buffers, maps the
  *  particles back onto the periodic box if needed, and then does the
@@ -122,7 +141,7 @@ static int UseAllParticles;
  */
 void domain_Decomposition(int UseAllTimeBins, int SaveKeys, int do_particle_mergesplit_key)
 {
-    int i, ret, retsum, diff, highest_bin_to_include;
+    int i, ret, retsum, diff, highest_bin_to_include, incremental = 0;
     size_t bytes, all_bytes;
     double t0, t1;
     
@@ -141,12 +160,21 @@ void domain_Decomposition(int UseAllTimeBins, int SaveKeys, int do_particle_merg
     UseAllParticles = UseAllTimeBins;
     
     CPU_Step[CPU_MISC] += measure_time();
+    PROFILE_BEGIN("domain_decomposition");
     
     for(i = 0; i < NumPart; i++)
         if(P[i].Ti_current != All.Ti_Current)
             drift_particle(i, All.Ti_Current);
     
     force_treefree();
+#ifdef DOMAIN_INCREMENTAL
+    /* keep the top-level tree of the last decomposition, unless it is time for a full one (or the memory layout changed) */
+    incremental = (DomainIncrementalValid && old_MaxPart == 0 && DomainIncrementalCount < DOMAIN_INCREMENTAL_FULL_EVERY);
+#ifdef SUBFIND
+    if(GrNr >= 0) {incremental = 0;}
+#endif
+    if(!incremental)
+#endif
     domain_free();
     
     if(old_MaxPart)
@@ -194,7 +222,7 @@ void domain_Decomposition(int UseAllTimeBins, int SaveKeys, int do_particle_merg
 
   do
     {
-      domain_allocate();
+      if(!incremental) {domain_allocate();}
 
       all_bytes = 0;
 
@@ -229,6 +257,10 @@ void domain_Decomposition(int UseAllTimeBins, int SaveKeys, int do_particle_merg
       all_bytes += bytes;
       domainCountSph = (int *) mymalloc("domainCountSph", bytes = (MaxTopNodes * sizeof(int)));
       all_bytes += bytes;
+#ifdef DOMAIN_MULTICONSTRAINT
+      domainWorkMeasured = (float *) mymalloc("domainWorkMeasured", bytes = (MaxTopNodes * DOMAIN_COST_BINGROUPS * sizeof(float)));
+      all_bytes += bytes;
+#endif
 #ifdef SEPARATE_STELLARDOMAINDECOMP
       toGoStars = (int *) mymalloc("toGoStars", bytes = (sizeof(int) * NTask)); all_bytes += bytes;
       toGetStars = (int *) mymalloc("toGetStars", bytes = (sizeof(int) * NTask)); all_bytes += bytes;
@@ -253,6 +285,9 @@ void domain_Decomposition(int UseAllTimeBins, int SaveKeys, int do_particle_merg
 
       report_memory_usage(&HighMark_domain, "DOMAIN");
 
+#ifdef DOMAIN_INCREMENTAL
+      if(incremental) {ret = domain_decompose_incremental();} else
+#endif
       ret = domain_decompose();
         
       /* copy what we need for the topnodes */
@@ -276,6 +311,9 @@ void domain_Decomposition(int UseAllTimeBins, int SaveKeys, int do_particle_merg
       myfree(toGoStars);
 #endif
 
+#ifdef DOMAIN_MULTICONSTRAINT
+      myfree(domainWorkMeasured);
+#endif
       myfree(domainCountSph);
       myfree(domainCount);
       myfree(domainWorkSph);
@@ -293,6 +331,15 @@ void domain_Decomposition(int UseAllTimeBins, int SaveKeys, int do_particle_merg
 
 
       MPI_Allreduce(&ret, &retsum, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+#ifdef DOMAIN_INCREMENTAL
+      if(incremental && retsum) /* the incremental update was rejected (before any particles moved): repeat with a full decomposition */
+        {
+          myfree(Key);
+          domain_free();
+          incremental = 0;
+          continue;
+        }
+#endif
       if(retsum)
 	{
 	  myfree(Key);
@@ -326,15 +373,23 @@ void domain_Decomposition(int UseAllTimeBins, int SaveKeys, int do_particle_merg
 
   myfree(Key);
 
-  memmove(TopNodes + NTopnodes, DomainTask, NTopnodes * sizeof(int));
+  if(!incremental) /* (in the incremental case the top-level structure was kept at its final size) */
+    {
+      memmove(TopNodes + NTopnodes, DomainTask, NTopnodes * sizeof(int));
 
-  TopNodes = (struct topnode_data *) myrealloc(TopNodes, bytes =
-					       (NTopnodes * sizeof(struct topnode_data) +
-						NTopnodes * sizeof(int)));
-  PRINT_STATUS(" ..freed %g MByte in top-level domain structure", (MaxTopNodes - NTopnodes) * sizeof(struct topnode_data) / (1024.0 * 1024.0));
-  DomainTask = (int *) (TopNodes + NTopnodes);
+      TopNodes = (struct topnode_data *) myrealloc(TopNodes, bytes =
+						   (NTopnodes * sizeof(struct topnode_data) +
+						    NTopnodes * sizeof(int)));
+      PRINT_STATUS(" ..freed %g MByte in top-level domain structure", (MaxTopNodes - NTopnodes) * sizeof(struct topnode_data) / (1024.0 * 1024.0));
+      DomainTask = (int *) (TopNodes + NTopnodes);
+    }
+#ifdef DOMAIN_INCREMENTAL
+  if(incremental) {DomainIncrementalCount++;} else {DomainIncrementalCount = 0;}
+  DomainIncrementalValid = 1;
+#endif
   force_treeallocate((int) (All.TreeAllocFactor * All.MaxPart) + NTopnodes, All.MaxPart);
   reconstruct_timebins();
+  PROFILE_END(0, 0, 0, 0, 0);
 }
 
 /*! This function allocates all the stuff that will be required for the tree-construction/walk later on */
@@ -371,6 +426,9 @@ void domain_free(void)
       myfree(DomainStartList);
       domain_allocated_flag = 0;
     }
+#ifdef DOMAIN_INCREMENTAL
+  DomainIncrementalValid = 0;
+#endif
 }
 
 static struct topnode_data *save_TopNodes;
@@ -387,6 +445,9 @@ void domain_free_trick(void)
     }
   else
     endrun(131231);
+#ifdef DOMAIN_INCREMENTAL
+  DomainIncrementalValid = 0;
+#endif
 }
 
 void domain_allocate_trick(void)
@@ -396,6 +457,9 @@ void domain_allocate_trick(void)
   TopNodes = save_TopNodes;
   DomainEndList = save_DomainEndList;
   DomainStartList = save_DomainStartList;
+#ifdef DOMAIN_INCREMENTAL
+  DomainIncrementalValid = 0; /* the restored lists need not match NTopnodes any more */
+#endif
 }
 
 
@@ -440,6 +504,31 @@ double domain_particle_costfactor(int i)
 }
 
 
+#ifdef DOMAIN_MULTICONSTRAINT
+/*! fills fac_measured[] with the weights which normalize the measured cost of each group of time bins to fac0 over all
+ *  top-level leaves (zero for groups without measured cost), and returns the number of groups with a measured cost */
+static int domain_measured_cost_factors(double fac0, double *fac_measured)
+{
+    int i, g, ngroups = 0;
+    for(g = 0; g < DOMAIN_COST_BINGROUPS; g++)
+    {
+        double work = 0;
+        for(i = 0; i < NTopleaves; i++) {work += domainWorkMeasured[i * DOMAIN_COST_BINGROUPS + g];}
+        if(work > 0) {fac_measured[g] = fac0 / work; ngroups++;} else {fac_measured[g] = 0;}
+    }
+    return ngroups;
+}
+
+/*! returns the measured cost of top-level leaf i, weighted with the factors from domain_measured_cost_factors() */
+static double domain_leaf_measured_cost(int i, double *fac_measured)
+{
+    int g; double cost = 0;
+    for(g = 0; g < DOMAIN_COST_BINGROUPS; g++) {cost += fac_measured[g] * domainWorkMeasured[i * DOMAIN_COST_BINGROUPS + g];}
+    return cost;
+}
+#endif
+
+
 
 /*! This function carries out the actual domain decomposition for all
  *  particle types. It will try to balance the work-load for each domain,
@@ -449,8 +538,8 @@ double domain_particle_costfactor(int i)
  */
 int domain_decompose(void)
 {
-  int i, no, status;
-  long long sumtogo, sumload, sumloadsph;
+  int i, status;
+  long long sumload, sumloadsph;
   int maxload, maxloadsph, multipledomains = MULTIPLEDOMAINS;
   double sumwork, maxwork, sumworksph, maxworksph;
 #ifdef SEPARATE_STELLARDOMAINDECOMP
@@ -558,8 +647,59 @@ int domain_decompose(void)
         printf("Balance: gravity work-load balance=%g   memory-balance=%g   hydro work-load balance=%g\n",
 	     maxwork / (sumwork / NTask), maxload / (((double) sumload) / NTask),
 	     maxworksph / ((sumworksph + 1.0e-30) / NTask));
+#ifdef DOMAIN_MULTICONSTRAINT
+      if(DomainUseMeasured)
+        {
+          int g;
+          double *list_measured = (double *) mymalloc("list_measured", NTask * sizeof(double));
+          printf("Balance: measured-cost balance per time-bin group (shortest bins first):");
+          for(g = 0; g < DOMAIN_COST_BINGROUPS; g++)
+            {
+              double summeasured = 0, maxmeasured = 0;
+              for(i = 0; i < NTask; i++) {list_measured[i] = 0;}
+              for(i = 0; i < NTopleaves; i++) {list_measured[DomainTask[i]] += domainWorkMeasured[i * DOMAIN_COST_BINGROUPS + g];}
+              for(i = 0; i < NTask; i++) {summeasured += list_measured[i]; if(list_measured[i] > maxmeasured) {maxmeasured = list_measured[i];}}
+              printf("  %g", maxmeasured / ((summeasured + 1.0e-30) / NTask));
+            }
+          printf("\n");
+          myfree(list_measured);
+        }
+#endif
     }
 
+#ifdef DOMAIN_INCREMENTAL
+  DomainImbalanceLastFull = domain_task_load_imbalance();
+#endif
+
+  domain_move_particles();
+
+  return 0;
+}
+
+
+#ifdef DOMAIN_MULTICONSTRAINT
+/*! resets the measured cost of the particles active in the current step, which will measure it anew while their
+ *  physics is evaluated (the cost of inactive particles is kept from the last step on which they were active) */
+void domain_reset_measured_costs(void)
+{
+  int i, j;
+  for(i = FirstActiveParticle; i >= 0; i = NextActiveParticle[i])
+    for(j = 0; j < DOMAIN_COST_LOOPS; j++)
+      P[i].MeasuredCost[j] = 0;
+}
+#endif
+
+
+/*! This function flags the particles whose top-level leaf is now assigned
+ *  to another task, and sends them there (in several rounds if the buffer
+ *  space does not allow it in one go). Particles which stay on their task
+ *  are not touched.
+ */
+void domain_move_particles(void)
+{
+  int i, no;
+  long long sumtogo;
+
   /* flag the particles that need to be exported */
 
   for(i = 0; i < NumPart; i++)
@@ -611,11 +751,212 @@ int domain_decompose(void)
       iter++;
     }
   while(ret > 0);
+}
+
+
+#ifdef DOMAIN_INCREMENTAL
+/*! This function computes the cost of each top-level leaf, combining gravity
+ *  work, particle load and hydro work with the same weights as
+ *  domain_findSplit_work_balanced() (normalized so they sum to one), and the
+ *  resulting load of each task under the current domain lists.
+ */
+static void domain_task_loads(double *leafcost, double *taskload)
+{
+  int i, n, multipledomains = MULTIPLEDOMAINS;
+  double work = 0, load = 0, worksph = 0, fac0;
+
+  for(i = 0; i < NTopleaves; i++)
+    {
+      work += domainWork[i];
+      load += domainCount[i];
+      worksph += domainWorkSph[i];
+    }
+  if(worksph > 0) fac0 = 0.333333; else fac0 = 0.5;
+#ifdef DOMAIN_MULTICONSTRAINT
+  double fac_measured[DOMAIN_COST_BINGROUPS];
+  if(DomainUseMeasured)
+    {
+      /* the measured cost of each group of time bins replaces the estimated hydro work, as in domain_findSplit_work_balanced() */
+      fac0 = 1.0 / (2 + domain_measured_cost_factors(1.0, fac_measured));
+      worksph = 0;
+    }
+#endif
+
+  for(i = 0; i < NTopleaves; i++)
+    {
+      leafcost[i] = fac0 * (domainWork[i] / (work + 1.0e-30) + domainCount[i] / (load + 1.0e-30) + ((worksph > 0) ? domainWorkSph[i] / worksph : 0));
+#ifdef DOMAIN_MULTICONSTRAINT
+      if(DomainUseMeasured) {leafcost[i] += fac0 * domain_leaf_measured_cost(i, fac_measured);}
+#endif
+    }
+
+  for(i = 0; i < NTask; i++)
+    taskload[i] = 0;
+  for(n = 0; n < multipledomains * NTask; n++)
+    for(i = DomainStartList[n]; i <= DomainEndList[n]; i++)
+      taskload[n / multipledomains] += leafcost[i];
+}
+
+
+/*! returns the ratio of the largest to the mean task load of the current decomposition */
+double domain_task_load_imbalance(void)
+{
+  int i;
+  double *leafcost, *taskload, maxload = 0;
+
+  leafcost = (double *) mymalloc("leafcost", NTopleaves * sizeof(double));
+  taskload = (double *) mymalloc("taskload", NTask * sizeof(double));
+  domain_task_loads(leafcost, taskload);
+  for(i = 0; i < NTask; i++)
+    if(taskload[i] > maxload)
+      maxload = taskload[i];
+  myfree(taskload);
+  myfree(leafcost);
+
+  return maxload * NTask;
+}
+
+
+static int domain_compare_segment_start(const void *a, const void *b)
+{
+  if(DomainStartList[*(int *) a] < DomainStartList[*(int *) b])
+    return -1;
+
+  if(DomainStartList[*(int *) a] > DomainStartList[*(int *) b])
+    return +1;
 
   return 0;
 }
 
 
+/*! This function updates the domain decomposition of the last call without
+ *  rebuilding it: the top-level tree and the extent of the Peano-Hilbert grid
+ *  are kept, the particle keys and the leaf costs (domain_sumCost) are
+ *  recomputed, and each split point between two segments of different tasks
+ *  is moved by at most DOMAIN_INCREMENTAL_MAXSHIFT leaves along the curve, one
+ *  leaf per sweep and only if this lowers the larger of the two task loads
+ *  (sweeps alternate in direction, so load diffuses both ways). Only the
+ *  particles whose leaf changed owner are then exchanged. Returns 1 (on all
+ *  tasks, before anything is moved) if particles have left the old grid, or
+ *  if the result violates the memory bounds or is more than
+ *  DOMAIN_INCREMENTAL_TOLERANCE times as imbalanced as the last full
+ *  decomposition, in which case the caller does a full one instead.
+ */
+int domain_decompose_incremental(void)
+{
+  int i, j, k, n, a, b, ta, tb, sweep, flag, flagsum, *order, multipledomains = MULTIPLEDOMAINS;
+  double x[3], ncells, maxload, imbalance, *leafcost, *taskload;
+
+  /* the top-level tree is kept: copy it into the work structure used below (the leaves are renumbered identically by domain_sumCost) */
+  for(i = 0; i < NTopnodes; i++)
+    {
+      topNodes[i].StartKey = TopNodes[i].StartKey;
+      topNodes[i].Size = TopNodes[i].Size;
+      topNodes[i].Daughter = TopNodes[i].Daughter;
+      topNodes[i].Leaf = TopNodes[i].Leaf;
+    }
+
+  for(i = 0; i < 6; i++)
+    NtypeLocal[i] = 0;
+  for(i = 0; i < NumPart; i++)
+    NtypeLocal[P[i].Type]++;
+  sumup_large_ints(6, NtypeLocal, Ntype);
+
+  /* new keys on the old grid: this is only possible if every particle is still inside it */
+  ncells = (double) (((peanokey) 1) << BITS_PER_DIMENSION);
+  for(i = 0, flag = 0; i < NumPart && !flag; i++)
+    {
+      for(j = 0; j < 3; j++)
+	{
+	  x[j] = (P[i].Pos[j] - DomainCorner[j]) * DomainFac;
+	  if(x[j] < 0 || x[j] >= ncells)
+	    flag = 1;
+	}
+    }
+  MPI_Allreduce(&flag, &flagsum, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+  if(flagsum)
+    {
+      PRINT_STATUS(" ..particles have left the extent of the top-level tree: doing a full domain decomposition");
+      return 1;
+    }
+  peano_hilbert_key_batch(NumPart, NULL, Key, NULL);
+
+  domain_sumCost();
+
+  leafcost = (double *) mymalloc("leafcost", NTopleaves * sizeof(double));
+  taskload = (double *) mymalloc("taskload", NTask * sizeof(double));
+  order = (int *) mymalloc("order", multipledomains * NTask * sizeof(int));
+
+  domain_task_loads(leafcost, taskload);
+
+  /* segments in the order in which they follow each other along the Peano-Hilbert curve */
+  for(n = 0; n < multipledomains * NTask; n++)
+    order[n] = n;
+  qsort(order, multipledomains * NTask, sizeof(int), domain_compare_segment_start);
+
+  for(sweep = 0; sweep < DOMAIN_INCREMENTAL_MAXSHIFT; sweep++)
+    for(k = 0; k < multipledomains * NTask - 1; k++)
+      {
+	j = (sweep % 2) ? (multipledomains * NTask - 2 - k) : k;
+	a = order[j];
+	b = order[j + 1];
+	ta = a / multipledomains;
+	tb = b / multipledomains;
+	if(ta == tb)
+	  continue;
+
+	if(taskload[ta] > taskload[tb])
+	  {
+	    i = DomainEndList[a];	/* last leaf of a moves to b */
+	    if(DomainEndList[a] > DomainStartList[a] && taskload[tb] + leafcost[i] < taskload[ta])
+	      {
+		DomainEndList[a]--;
+		DomainStartList[b]--;
+		taskload[ta] -= leafcost[i];
+		taskload[tb] += leafcost[i];
+	      }
+	  }
+	else
+	  {
+	    i = DomainStartList[b];	/* first leaf of b moves to a */
+	    if(DomainEndList[b] > DomainStartList[b] && taskload[ta] + leafcost[i] < taskload[tb])
+	      {
+		DomainStartList[b]++;
+		DomainEndList[a]++;
+		taskload[tb] -= leafcost[i];
+		taskload[ta] += leafcost[i];
+	      }
+	  }
+      }
+
+  for(n = 0; n < multipledomains * NTask; n++)
+    for(i = DomainStartList[n]; i <= DomainEndList[n]; i++)
+      DomainTask[i] = n / multipledomains;
+
+  for(i = 0, maxload = 0; i < NTask; i++)
+    if(taskload[i] > maxload)
+      maxload = taskload[i];
+  imbalance = maxload * NTask;
+
+  myfree(order);
+  myfree(taskload);
+  myfree(leafcost);
+
+  PRINT_STATUS(" ..incremental domain decomposition: load imbalance=%g (after the last full decomposition=%g)", imbalance, DomainImbalanceLastFull);
+
+  if(domain_check_memory_bound(multipledomains) || imbalance > DOMAIN_INCREMENTAL_TOLERANCE * DMAX(DomainImbalanceLastFull, 1))
+    {
+      PRINT_STATUS(" ..incremental update rejected: doing a full domain decomposition");
+      return 1;
+    }
+
+  domain_move_particles();
+
+  return 0;
+}
+#endif
+
+
 
 
 
@@ -1196,6 +1537,16 @@ void domain_findSplit_work_balanced(int ncpu, int ndomain)
   //if(workstars>0)
   //  fac0 = 1./(1. + 1./fac0);
 #endif
+#ifdef DOMAIN_MULTICONSTRAINT
+  double fac_measured[DOMAIN_COST_BINGROUPS];
+  if(DomainUseMeasured)
+    {
+      /* the measured cost of each group of time bins is a separate term, replacing the estimated hydro work */
+      fac0 = 1.0 / (2 + domain_measured_cost_factors(1.0, fac_measured));
+      for(i = 0; i < DOMAIN_COST_BINGROUPS; i++) {fac_measured[i] *= fac0;}
+      worksph = 0;
+    }
+#endif
 
       /* in this case we give equal weight to gravitational work-load, SPH work load, and particle load */
       fac_work = fac0 / work;
@@ -1225,6 +1576,9 @@ void domain_findSplit_work_balanced(int ncpu, int ndomain)
       work += fac_work * domainWork[end] + fac_load * domainCount[end] + fac_worksph * domainWorkSph[end];
 #ifdef SEPARATE_STELLARDOMAINDECOMP
       //work += fac_workstars * domainWorkStars[end];
+#endif
+#ifdef DOMAIN_MULTICONSTRAINT
+      if(DomainUseMeasured) {work += domain_leaf_measured_cost(end, fac_measured);}
 #endif
       while((work + work_before < workavg + workavg_before) || (i == ncpu - 1 && end < ndomain - 1))
 	{
@@ -1236,6 +1590,9 @@ void domain_findSplit_work_balanced(int ncpu, int ndomain)
 	  work += fac_work * domainWork[end] + fac_load * domainCount[end] + fac_worksph * domainWorkSph[end];
 #ifdef SEPARATE_STELLARDOMAINDECOMP
       //work += fac_workstars * domainWorkStars[end];
+#endif
+#ifdef DOMAIN_MULTICONSTRAINT
+	  if(DomainUseMeasured) {work += domain_leaf_measured_cost(end, fac_measured);}
 #endif
 	}
 
@@ -1256,6 +1613,9 @@ static struct domain_segments_data
   double load_activesph;
 #ifdef SEPARATE_STELLARDOMAINDECOMP
   //double load_activestars;
+#endif
+#ifdef DOMAIN_MULTICONSTRAINT
+  double load_measured[DOMAIN_COST_BINGROUPS];
 #endif
   double normalized_load;
 }
@@ -1269,7 +1629,11 @@ struct queue_data
   int *previous;
   double *value;
 }
+#ifdef DOMAIN_MULTICONSTRAINT
+queues[3 + DOMAIN_COST_BINGROUPS];	/* one extra queue for the measured cost of each group of time bins */
+#else
 queues[3];
+#endif
 
 struct tasklist_data
 {
@@ -1278,6 +1642,9 @@ struct tasklist_data
   double load_activesph;
 #ifdef SEPARATE_STELLARDOMAINDECOMP
   //double load_activestars;
+#endif
+#ifdef DOMAIN_MULTICONSTRAINT
+  double load_measured[DOMAIN_COST_BINGROUPS];
 #endif
   int count;
 }
@@ -1318,7 +1685,13 @@ void domain_assign_load_or_work_balanced(int mode, int multipledomains)
 
 
   int best_queue, target, next, prev;
-  int i, n, q, ta;
+  int i, n, q, ta, nq = 3;
+#ifdef DOMAIN_MULTICONSTRAINT
+  int g;
+  double tot_measured[DOMAIN_COST_BINGROUPS], target_measured_balance;
+  if(DomainUseMeasured) {nq = 3 + DOMAIN_COST_BINGROUPS;}
+  for(g = 0; g < DOMAIN_COST_BINGROUPS; g++) {tot_measured[g] = 0;}
+#endif
 
   domainAssign = (struct domain_segments_data *) mymalloc("domainAssign",
 							  multipledomains * NTask *
@@ -1333,6 +1706,9 @@ void domain_assign_load_or_work_balanced(int mode, int multipledomains)
       tasklist[ta].load_activesph = 0;
 #ifdef SEPARATE_STELLARDOMAINDECOMP
       //tasklist[ta].load_activestars = 0;
+#endif
+#ifdef DOMAIN_MULTICONSTRAINT
+      for(g = 0; g < DOMAIN_COST_BINGROUPS; g++) {tasklist[ta].load_measured[g] = 0;}
 #endif
       tasklist[ta].count = 0;
     }
@@ -1354,6 +1730,9 @@ void domain_assign_load_or_work_balanced(int mode, int multipledomains)
 #ifdef SEPARATE_STELLARDOMAINDECOMP
       //domainAssign[n].load_activestars = 0;
 #endif
+#ifdef DOMAIN_MULTICONSTRAINT
+      for(g = 0; g < DOMAIN_COST_BINGROUPS; g++) {domainAssign[n].load_measured[g] = 0;}
+#endif
 
       for(i = DomainStartList[n]; i <= DomainEndList[n]; i++)
 	{
@@ -1362,6 +1741,9 @@ void domain_assign_load_or_work_balanced(int mode, int multipledomains)
 	  domainAssign[n].load_activesph += domainWorkSph[i];
 #ifdef SEPARATE_STELLARDOMAINDECOMP
       //domainAssign[n].load_activestars += domainWorkStars[i];
+#endif
+#ifdef DOMAIN_MULTICONSTRAINT
+	  for(g = 0; g < DOMAIN_COST_BINGROUPS; g++) {domainAssign[n].load_measured[g] += domainWorkMeasured[i * DOMAIN_COST_BINGROUPS + g];}
 #endif
 	}
 
@@ -1370,6 +1752,9 @@ void domain_assign_load_or_work_balanced(int mode, int multipledomains)
       tot_loadactivesph += domainAssign[n].load_activesph;
 #ifdef SEPARATE_STELLARDOMAINDECOMP
       //tot_loadactivestars += domainAssign[n].load_activestars;
+#endif
+#ifdef DOMAIN_MULTICONSTRAINT
+      for(g = 0; g < DOMAIN_COST_BINGROUPS; g++) {tot_measured[g] += domainAssign[n].load_measured[g];}
 #endif
     }
 
@@ -1380,13 +1765,20 @@ void domain_assign_load_or_work_balanced(int mode, int multipledomains)
         domainAssign[n].load_activesph / (tot_loadactivesph + 1.0e-30);
 #ifdef SEPARATE_STELLARDOMAINDECOMP
         //domainAssign[n].normalized_load += domainAssign[n].load_activestars / (tot_loadactivestars + 1.0e-30);
+#endif
+#ifdef DOMAIN_MULTICONSTRAINT
+      if(DomainUseMeasured)
+        {
+          domainAssign[n].normalized_load = domainAssign[n].work / (tot_work + 1.0e-30);
+          for(g = 0; g < DOMAIN_COST_BINGROUPS; g++) {domainAssign[n].normalized_load += domainAssign[n].load_measured[g] / (tot_measured[g] + 1.0e-30);}
+        }
 #endif
     }
 
   qsort(domainAssign, multipledomains * NTask, sizeof(struct domain_segments_data), domain_sort_load);
 
-  /* initialize three queues */
-  for(q = 0; q < 3; q++)
+  /* initialize three queues (plus one for each group of time bins with measured costs) */
+  for(q = 0; q < nq; q++)
     {
       queues[q].next = (int *) mymalloc("queues[q].next", NTask * sizeof(int));
       queues[q].previous = (int *) mymalloc("queues[q].previous", NTask * sizeof(int));
@@ -1407,7 +1799,7 @@ void domain_assign_load_or_work_balanced(int mode, int multipledomains)
   for(n = 0; n < multipledomains * NTask; n++)
     {
       /* need to decide, which of the tasks that has the lowest load in one of the three quantities is best */
-      for(q = 0, best_balance = 1.0e30, best_queue = 0; q < 3; q++)
+      for(q = 0, best_balance = 1.0e30, best_queue = 0; q < nq; q++)
 	{
 	  target = queues[q].first;
 
@@ -1424,6 +1816,18 @@ void domain_assign_load_or_work_balanced(int mode, int multipledomains)
 	  target_max_balance = target_work_balance;
 	  if(target_max_balance < target_load_balance)
 	    target_max_balance = target_load_balance;
+#ifdef DOMAIN_MULTICONSTRAINT
+	  if(DomainUseMeasured)
+	    {
+	      target_load_activesph_balance = 0; /* replaced by the measured costs */
+	      for(g = 0; g < DOMAIN_COST_BINGROUPS; g++)
+		{
+		  target_measured_balance = (domainAssign[n].load_measured[g] + tasklist[target].load_measured[g]) / (tot_measured[g] + 1.0e-30);
+		  if(target_max_balance < target_measured_balance)
+		    target_max_balance = target_measured_balance;
+		}
+	    }
+#endif
 	  if(target_max_balance < target_load_activesph_balance)
 	    target_max_balance = target_load_activesph_balance;
 #ifdef SEPARATE_STELLARDOMAINDECOMP
@@ -1450,6 +1854,9 @@ void domain_assign_load_or_work_balanced(int mode, int multipledomains)
       tasklist[target].load_activesph += domainAssign[n].load_activesph;
 #ifdef SEPARATE_STELLARDOMAINDECOMP
       //tasklist[target].load_activestars += domainAssign[n].load_activestars;
+#endif
+#ifdef DOMAIN_MULTICONSTRAINT
+      for(g = 0; g < DOMAIN_COST_BINGROUPS; g++) {tasklist[target].load_measured[g] += domainAssign[n].load_measured[g];}
 #endif
       tasklist[target].count++;
 
@@ -1457,7 +1864,7 @@ void domain_assign_load_or_work_balanced(int mode, int multipledomains)
 //#ifdef SEPARATE_STELLARDOMAINDECOMP
     //for(q = 0; q < 4; q++)
 //#else
-    for(q = 0; q < 3; q++)
+    for(q = 0; q < nq; q++)
 //#endif
     {
 	  switch (q)
@@ -1477,7 +1884,11 @@ void domain_assign_load_or_work_balanced(int mode, int multipledomains)
 //          break;
 #endif
 	    default:
+#ifdef DOMAIN_MULTICONSTRAINT
+	      value = tasklist[target].load_measured[q - 3];
+#else
 	      value = 0;
+#endif
 	      break;
 	    }
 
@@ -1549,7 +1960,7 @@ void domain_assign_load_or_work_balanced(int mode, int multipledomains)
     }
 
   /* free the queues */
-  for(q = 2; q >= 0; q--)
+  for(q = nq - 1; q >= 0; q--)
     {
       myfree(queues[q].value);
       myfree(queues[q].previous);
@@ -2287,6 +2698,8 @@ int domain_determineTopTree(void)
 
   mp = (struct peano_hilbert_data *) mymalloc("mp", sizeof(struct peano_hilbert_data) * NumPart);
 
+  peano_hilbert_key_batch(NumPart, NULL, Key, NULL);
+
   for(i = 0, count = 0; i < NumPart; i++)
     {
 #ifdef SUBFIND
@@ -2294,11 +2707,7 @@ int domain_determineTopTree(void)
 	continue;
 #endif
 
-      mp[count].key = Key[i] = peano_hilbert_key((int) ((P[i].Pos[0] - DomainCorner[0]) * DomainFac),
-						 (int) ((P[i].Pos[1] - DomainCorner[1]) * DomainFac),
-						 (int) ((P[i].Pos[2] - DomainCorner[2]) * DomainFac),
-						 BITS_PER_DIMENSION);
-
+      mp[count].key = Key[i];
       mp[count].index = i;
       count++;
     }
@@ -2308,7 +2717,7 @@ int domain_determineTopTree(void)
     endrun(1222);
 #endif
 
-#ifdef MYSORT
+#if defined(MYSORT) || defined(RADIX_SORT)
   mysort_domain(mp, count, sizeof(struct peano_hilbert_data));
 #else
   qsort(mp, count, sizeof(struct peano_hilbert_data), domain_compare_key);
@@ -2476,6 +2885,21 @@ void domain_sumCost(void)
   local_domainCountStars = (int *) mymalloc("local_domainCountStars", NTopnodes * sizeof(int));
   //local_domainWorkStars = (float *) mymalloc("local_domainWorkStars", NTopnodes * sizeof(float));
 #endif
+#ifdef DOMAIN_MULTICONSTRAINT
+  int g, bin_lo, bin_range[2], local_bin_range[2] = {TIMEBINS, -1};
+  double sum_measured, tot_measured = 0;
+  float *local_domainWorkMeasured = (float *) mymalloc("local_domainWorkMeasured", NTopnodes * DOMAIN_COST_BINGROUPS * sizeof(float));
+  memset(local_domainWorkMeasured, 0, NTopnodes * DOMAIN_COST_BINGROUPS * sizeof(float));
+  /* the occupied time bins are split into DOMAIN_COST_BINGROUPS contiguous groups, each of which is balanced separately */
+  for(n = 0; n < NumPart; n++)
+    {
+      if(P[n].TimeBin < local_bin_range[0]) {local_bin_range[0] = P[n].TimeBin;}
+      if(-P[n].TimeBin < local_bin_range[1]) {local_bin_range[1] = -P[n].TimeBin;}
+    }
+  MPI_Allreduce(local_bin_range, bin_range, 2, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+  bin_lo = bin_range[0]; bin_range[1] = -bin_range[1] - bin_range[0] + 1; /* now the number of bins spanned */
+  if(bin_range[1] < 1) {bin_range[1] = 1;}
+#endif
 
 
   NTopleaves = 0;
@@ -2516,6 +2940,19 @@ void domain_sumCost(void)
 
 #ifdef SEPARATE_STELLARDOMAINDECOMP
         if(P[n].Type == 4) {local_domainCountStars[no] += 1;}
+#endif
+#ifdef DOMAIN_MULTICONSTRAINT
+      for(i = 0, sum_measured = 0; i < DOMAIN_COST_LOOPS; i++) {sum_measured += P[n].MeasuredCost[i];}
+      if(sum_measured > 0)
+        {
+          /* the cost was measured on the last step the particle was active: weight it by how often the particle is active,
+             relative to the shortest time bin of its group, to get the cost per step of that group */
+          g = ((P[n].TimeBin - bin_lo) * DOMAIN_COST_BINGROUPS) / bin_range[1];
+          if(g < 0) {g = 0;}
+          if(g >= DOMAIN_COST_BINGROUPS) {g = DOMAIN_COST_BINGROUPS - 1;}
+          int bin_first = bin_lo + (g * bin_range[1] + DOMAIN_COST_BINGROUPS - 1) / DOMAIN_COST_BINGROUPS; /* shortest time bin which falls into group g */
+          local_domainWorkMeasured[no * DOMAIN_COST_BINGROUPS + g] += ldexp(sum_measured, -(P[n].TimeBin - bin_first));
+        }
 #endif
     }
 
@@ -2526,6 +2963,14 @@ void domain_sumCost(void)
 #ifdef SEPARATE_STELLARDOMAINDECOMP
   //MPI_Allreduce(local_domainWorkStars, domainWorkStars, NTopleaves, MPI_FLOAT, MPI_SUM, MPI_COMM_WORLD);
   MPI_Allreduce(local_domainCountStars, domainCountStars, NTopleaves, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+#endif
+#ifdef DOMAIN_MULTICONSTRAINT
+  MPI_Allreduce(local_domainWorkMeasured, domainWorkMeasured, NTopleaves * DOMAIN_COST_BINGROUPS, MPI_FLOAT, MPI_SUM, MPI_COMM_WORLD);
+  for(i = 0; i < NTopleaves * DOMAIN_COST_BINGROUPS; i++) {tot_measured += domainWorkMeasured[i];}
+  DomainUseMeasured = (tot_measured > 0);
+  myfree(local_domainWorkMeasured);
+#endif
+#ifdef SEPARATE_STELLARDOMAINDECOMP
   //myfree(local_domainWorkStars);
   myfree(local_domainCountStars);
 #endif
@@ -2737,6 +3182,9 @@ static void msort_domain_with_tmp(struct peano_hilbert_data *b, size_t n, struct
 
 void mysort_domain(void *b, size_t n, size_t s)
 {
+#ifdef RADIX_SORT
+  radix_sort_peano(b, n, s, NULL); return;
+#endif
   const size_t size = n * s;
   struct peano_hilbert_data *tmp;
 
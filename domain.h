@@ -23,6 +23,10 @@ double domain_particle_costfactor(int i);
 int domain_countToGo(size_t nlimit);
 void domain_Decomposition(int UseAllTimeBins, int SaveKeys, int do_particle_mergesplit_key);
 int domain_decompose(void);
+int domain_decompose_incremental(void);
+double domain_task_load_imbalance(void);
+void domain_move_particles(void);
+void domain_reset_measured_costs(void);
 int domain_determineTopTree(void);
 void domain_findExtent(void);
 void domain_exchange(void);
@@ -43,6 +43,7 @@ struct kernel_addthermalFB {double dp[3], r, wk, dwk, hinv, hinv3, hinv4;};
 #define INPUTFUNCTION_NAME particle2in_addthermalFB    /* name of the function which loads the element data needed (for e.g. broadcast to other processors, neighbor search) */
 #define OUTPUTFUNCTION_NAME out2particle_addthermalFB  /* name of the function which takes the data returned from other processors and combines it back to the original elements */
 #define CONDITIONFUNCTION_FOR_EVALUATION if(addthermalFB_evaluate_active_check(i)) /* function for which elements will be 'active' and allowed to undergo operations. can be a function call, e.g. 'density_is_active(i)', or a direct function call like 'if(P[i].Mass>0)' */
+#define DOMAIN_COST_LOOP DOMAIN_COST_FEEDBACK /* physics loop this is counted under, when the per-particle cost is measured for the load-balancing (DOMAIN_MULTICONSTRAINT) */
 #include "../system/code_block_xchange_initialize.h" /* pre-define all the ALL_CAPS variables we will use below, so their naming conventions are consistent and they compile together, as well as defining some of the function calls needed */
 
 
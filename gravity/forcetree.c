@@ -56,6 +56,19 @@ static float shortrange_table_tidal[NTAB];
 /*! toggles after first tree-memory allocation, has only influence on log-files */
 static int first_flag = 0;
 
+#ifdef GRAVITY_GROUP_EXPANSIONS
+/*! adds the traceless quadrupole moment (ordering xx,yy,zz,xy,xz,yz) of a point mass m at offset (dx,dy,dz) from the
+ *  center-of-mass of a node to 'quad'. if 'quad_sub' is set, the point is itself a daughter node carrying its own
+ *  moment (about its own center-of-mass), which is simply added (parallel-axis theorem) */
+static void force_add_quadrupole_moment(double *quad, double m, double dx, double dy, double dz, MyFloat *quad_sub)
+{
+    double r2 = dx*dx + dy*dy + dz*dz;
+    quad[0] += m * (3.*dx*dx - r2); quad[1] += m * (3.*dy*dy - r2); quad[2] += m * (3.*dz*dz - r2);
+    quad[3] += 3.*m*dx*dy; quad[4] += 3.*m*dx*dz; quad[5] += 3.*m*dy*dz;
+    if(quad_sub) {int k; for(k = 0; k < 6; k++) {quad[k] += quad_sub[k];}}
+}
+#endif
+
 static int tree_allocated_flag = 0;
 
 
@@ -114,9 +127,11 @@ static double fac_intp;
 int force_treebuild(int npart, struct unbind_data *mp)
 {
 
-    int flag;
+    int flag, n_rounds = 0;
+    PROFILE_BEGIN("force_treebuild");
     do
     {
+        n_rounds++;
         Numnodestree = force_treebuild_single(npart, mp);
 
         MPI_Allreduce(&Numnodestree, &flag, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
@@ -144,13 +159,41 @@ int force_treebuild(int npart, struct unbind_data *mp)
     
     force_treeupdate_pseudos(All.MaxPart);
     
+#ifdef NGB_COMPACT_TREE_NODES
+    force_build_ngb_nodes();
+#endif
+    
     TimeOfLastTreeConstruction = All.Time;
+    PROFILE_END(0, n_rounds, 0, 0, 0);
 
     return Numnodestree;
 }
 
 
 
+#ifdef NGB_COMPACT_TREE_NODES
+/*! This fills the compact copy of the node data read by the neighbor-search walk, once the tree (including the
+ *  top-level nodes from other tasks) is complete. Afterwards, force_drift_node() and force_update_hmax() keep the
+ *  drifted fields (len, hmax, Ti_current) of the copy current.
+ */
+void force_build_ngb_nodes(void)
+{
+    int no, k;
+    for(no = All.MaxPart; no < All.MaxPart + Numnodestree; no++)
+    {
+        for(k = 0; k < 3; k++) {NgbNodes[no].center[k] = Nodes[no].center[k];}
+        NgbNodes[no].len = Nodes[no].len;
+        if(!(Nodes[no].u.d.bitflags & (1 << BITFLAG_MULTIPLEPARTICLES)) && (Nodes[no].u.d.mass)) {NgbNodes[no].len = -1;} /* the walk always opens these */
+        NgbNodes[no].u.d.sibling = Nodes[no].u.d.sibling;
+        NgbNodes[no].u.d.nextnode = Nodes[no].u.d.nextnode;
+        NgbNodes[no].hmax = Extnodes[no].hmax;
+        NgbNodes[no].Ti_current = Nodes[no].Ti_current;
+    }
+}
+#endif
+
+
+
 /*! Constructs the gravitational oct-tree.
  *
  *  The index convention for accessing tree nodes is the following: the
@@ -174,7 +217,7 @@ int force_treebuild_single(int npart, struct unbind_data *mp)
     int nfree, th, nn, no;
     struct NODE *nfreep;
     MyFloat lenhalf;
-    peanokey key, morton, th_key, *morton_list;
+    peanokey key, th_key, *morton_list, *key_list;
     
     
     /* create an empty root node  */
@@ -209,6 +252,8 @@ int force_treebuild_single(int npart, struct unbind_data *mp)
     parent = -1;			/* note: will not be used below before it is changed */
     
     morton_list = (peanokey *) mymalloc("morton_list", NumPart * sizeof(peanokey));
+    key_list = (peanokey *) mymalloc("key_list", NumPart * sizeof(peanokey));
+    peano_hilbert_key_batch(npart, mp ? &mp[0].index : NULL, key_list, morton_list); /* keys of all particles to insert (stored at the particle index) */
     
     /* now we insert all particles */
     for(k = 0; k < npart; k++)
@@ -220,11 +265,7 @@ int force_treebuild_single(int npart, struct unbind_data *mp)
         
         rep = 0;
         
-        key = peano_and_morton_key((int) ((P[i].Pos[0] - DomainCorner[0]) * DomainFac),
-                                   (int) ((P[i].Pos[1] - DomainCorner[1]) * DomainFac),
-                                   (int) ((P[i].Pos[2] - DomainCorner[2]) * DomainFac), BITS_PER_DIMENSION,
-                                   &morton);
-        morton_list[i] = morton;
+        key = key_list[i];
         
         shift = 3 * (BITS_PER_DIMENSION - 1);
         
@@ -245,7 +286,7 @@ int force_treebuild_single(int npart, struct unbind_data *mp)
             {
                 if(shift >= 0)
                 {
-                    subnode = ((morton >> shift) & 7);
+                    subnode = ((morton_list[i] >> shift) & 7);
                 }
                 else
                 {
@@ -389,6 +430,7 @@ int force_treebuild_single(int npart, struct unbind_data *mp)
                     }
                     else
                     {
+                        myfree(key_list);
                         myfree(morton_list);
                         return -1;
                     }
@@ -397,6 +439,7 @@ int force_treebuild_single(int npart, struct unbind_data *mp)
         }
     }
     
+    myfree(key_list);
     myfree(morton_list);
     
     
@@ -883,6 +926,19 @@ void force_update_node_recursive(int no, int sib, int father)
         Nodes[no].u.d.s[1] = s[1];
         Nodes[no].u.d.s[2] = s[2];
         Nodes[no].GravCost = 0;
+#ifdef GRAVITY_GROUP_EXPANSIONS
+        {
+            double quad[6] = {0,0,0,0,0,0}; /* now that the center-of-mass is known, sum the moments of the daughters about it */
+            for(j = 0; j < 8; j++)
+            {
+                if((p = suns[j]) < 0) {continue;}
+                if(p >= All.MaxPart + MaxNodes) {continue;} /* pseudo particle: no mass assigned yet */
+                if(p >= All.MaxPart) {force_add_quadrupole_moment(quad, Nodes[p].u.d.mass, Nodes[p].u.d.s[0]-s[0], Nodes[p].u.d.s[1]-s[1], Nodes[p].u.d.s[2]-s[2], Nodes[p].quad);}
+                else {force_add_quadrupole_moment(quad, P[p].Mass, P[p].Pos[0]-s[0], P[p].Pos[1]-s[1], P[p].Pos[2]-s[2], NULL);}
+            }
+            for(k = 0; k < 6; k++) {Nodes[no].quad[k] = quad[k];}
+        }
+#endif
 #ifdef RT_USE_TREECOL_FOR_NH
         Nodes[no].gasmass = gasmass;
 #endif	
@@ -1001,6 +1057,9 @@ void force_exchange_pseudodata(void)
 #if defined(ADAPTIVE_GRAVSOFT_FORGAS) || defined(ADAPTIVE_GRAVSOFT_FORALL)
         MyFloat maxsoft;
 #endif
+#ifdef GRAVITY_GROUP_EXPANSIONS
+        MyFloat quad[6];
+#endif
 #ifdef RT_USE_GRAVTREE
         MyFloat stellar_lum[N_RT_FREQ_BINS];
 #ifdef CHIMES_STELLAR_FLUXES 
@@ -1065,6 +1124,9 @@ void force_exchange_pseudodata(void)
 #if defined(ADAPTIVE_GRAVSOFT_FORGAS) || defined(ADAPTIVE_GRAVSOFT_FORALL)
             DomainMoment[i].maxsoft = Nodes[no].maxsoft;
 #endif
+#ifdef GRAVITY_GROUP_EXPANSIONS
+            {int k; for(k=0;k<6;k++) {DomainMoment[i].quad[k] = Nodes[no].quad[k];}}
+#endif
 #ifdef RT_USE_GRAVTREE
             int k; for(k=0;k<N_RT_FREQ_BINS;k++) {DomainMoment[i].stellar_lum[k] = Nodes[no].stellar_lum[k];}
 #ifdef CHIMES_STELLAR_FLUXES 
@@ -1154,6 +1216,9 @@ void force_exchange_pseudodata(void)
 #if defined(ADAPTIVE_GRAVSOFT_FORGAS) || defined(ADAPTIVE_GRAVSOFT_FORALL)
                     Nodes[no].maxsoft = DomainMoment[i].maxsoft;
 #endif
+#ifdef GRAVITY_GROUP_EXPANSIONS
+                    {int k; for(k=0;k<6;k++) {Nodes[no].quad[k] = DomainMoment[i].quad[k];}}
+#endif
 #ifdef RT_USE_GRAVTREE
                     int k; for(k=0;k<N_RT_FREQ_BINS;k++) {Nodes[no].stellar_lum[k] = DomainMoment[i].stellar_lum[k];}
 #ifdef CHIMES_STELLAR_FLUXES 
@@ -1480,6 +1545,12 @@ void force_treeupdate_pseudos(int no)
     Nodes[no].u.d.bitflags &= (~BITFLAG_MASK);	/* this clears the bits */
     Nodes[no].u.d.bitflags |= multiple_flag;
     Nodes[no].maxsoft = maxsoft;
+#ifdef GRAVITY_GROUP_EXPANSIONS
+    double quad[6] = {0,0,0,0,0,0}; /* sum the moments of the 8 daughters about the new center-of-mass */
+    for(j = 0, p = Nodes[no].u.d.nextnode; j < 8; j++, p = Nodes[p].u.d.sibling)
+        {force_add_quadrupole_moment(quad, Nodes[p].u.d.mass, Nodes[p].u.d.s[0]-s[0], Nodes[p].u.d.s[1]-s[1], Nodes[p].u.d.s[2]-s[2], Nodes[p].quad);}
+    for(j = 0; j < 6; j++) {Nodes[no].quad[j] = quad[j];}
+#endif
 }
 
 
@@ -2652,6 +2723,584 @@ int force_treeevaluate(int target, int mode, int *exportflag, int *exportnodecou
 }
 
 
+#ifdef GRAVITY_TREE_INTERACTION_LISTS
+/*! length of the (per-thread, stack-resident) source list. the walk flushes it through the force kernel whenever it fills,
+ *  so it only needs to be long enough to amortize the flush; likewise for the list of pseudo-particles to be exported */
+#define GRAVITY_INTERACTION_LIST_LENGTH 256
+#define GRAVITY_GROUP_PSEUDO_LIST_LENGTH 64
+
+/*! target data for one member of a group sharing a tree-walk */
+struct gravity_group_target
+{
+    int index;
+    double pos[3], soft, aold;
+#ifdef PMGRID
+    double asmthfac, rcut;
+#endif
+    MyLongDouble acc[3];
+#ifdef EVALPOTENTIAL
+    MyLongDouble pot;
+#endif
+    int ninteractions;
+};
+
+/*! interaction list (stored as separate arrays so the kernel loop below runs over contiguous memory): for each accepted
+ *  node or particle we hold its position (center-of-mass for nodes), mass, and softening (node maxsoft for nodes) */
+struct gravity_interaction_list
+{
+    int N;
+    double x[GRAVITY_INTERACTION_LIST_LENGTH], y[GRAVITY_INTERACTION_LIST_LENGTH], z[GRAVITY_INTERACTION_LIST_LENGTH];
+    double mass[GRAVITY_INTERACTION_LIST_LENGTH], soft[GRAVITY_INTERACTION_LIST_LENGTH];
+#ifdef GRAVITY_GROUP_EXPANSIONS
+    double qxx[GRAVITY_INTERACTION_LIST_LENGTH], qyy[GRAVITY_INTERACTION_LIST_LENGTH], qzz[GRAVITY_INTERACTION_LIST_LENGTH]; /* node quadrupole (zero for particles) */
+    double qxy[GRAVITY_INTERACTION_LIST_LENGTH], qxz[GRAVITY_INTERACTION_LIST_LENGTH], qyz[GRAVITY_INTERACTION_LIST_LENGTH];
+#endif
+};
+
+#ifdef GRAVITY_GROUP_EXPANSIONS
+/*! local (Taylor) expansion of the far-field of the nodes which were accepted for the group as a whole, about the group
+ *  center: potential, acceleration, and the tidal tensor (xx,yy,zz,xy,xz,yz; the derivative of the acceleration) */
+struct gravity_local_expansion
+{
+    double phi, g[3], T[6];
+};
+#endif
+
+
+/*! This evaluates every source in the interaction list for a single target, and adds the result to the target's
+ *  accumulators. The Newtonian (far-field) part is a flat loop without data-dependent branches, so it can be
+ *  vectorized by the compiler; the (few) sources within the softening length are then re-done with kernel_gravity()
+ *  in a short scalar pass. The result is identical to the inline evaluation in force_treeevaluate(), up to round-off.
+ */
+static void force_evaluate_interaction_list(struct gravity_interaction_list *list, struct gravity_group_target *t)
+{
+    int k, nlist = list->N, ninteractions = 0;
+    double acc_x = 0, acc_y = 0, acc_z = 0, pos_x = t->pos[0], pos_y = t->pos[1], pos_z = t->pos[2], soft = t->soft;
+    double r2_list[GRAVITY_INTERACTION_LIST_LENGTH], h_list[GRAVITY_INTERACTION_LIST_LENGTH];
+#ifdef PMGRID
+    double asmthfac = t->asmthfac;
+#endif
+#ifdef EVALPOTENTIAL
+    double pot = 0;
+#endif
+
+#ifdef _OPENMP
+#ifdef EVALPOTENTIAL
+#pragma omp simd reduction(+:acc_x,acc_y,acc_z,pot,ninteractions)
+#else
+#pragma omp simd reduction(+:acc_x,acc_y,acc_z,ninteractions)
+#endif
+#endif
+    for(k = 0; k < nlist; k++)
+    {
+        double dx = list->x[k] - pos_x, dy = list->y[k] - pos_y, dz = list->z[k] - pos_z;
+        GRAVITY_NEAREST_XYZ(dx,dy,dz,-1);
+        double r2 = dx*dx + dy*dy + dz*dz, h = (soft > list->soft[k]) ? soft : list->soft[k];
+        double rinv = (r2 > 0) ? 1. / sqrt(r2) : 0; /* zero separation (the target itself) gives no force */
+        double fac = (r2 >= h*h) ? list->mass[k] * rinv*rinv*rinv : 0; /* sources inside the softening are done below */
+#ifdef EVALPOTENTIAL
+        double facpot = (r2 >= h*h) ? -list->mass[k] * rinv : 0;
+#endif
+#ifdef PMGRID
+        int tabindex = (int) (asmthfac * r2 * rinv);
+        fac *= (tabindex < NTAB) ? shortrange_table[tabindex] : 0;
+#if defined(EVALPOTENTIAL) && !(defined(BOX_PERIODIC) && !defined(GRAVITY_NOT_PERIODIC))
+        facpot *= (tabindex < NTAB) ? shortrange_table_potential[tabindex] : 0;
+#endif
+#endif
+#if defined(EVALPOTENTIAL) && !(defined(BOX_PERIODIC) && !defined(GRAVITY_NOT_PERIODIC))
+        pot += facpot;
+#endif
+        acc_x += dx * fac;
+        acc_y += dy * fac;
+        acc_z += dz * fac;
+#ifdef GRAVITY_GROUP_EXPANSIONS
+        /* quadrupole correction for (Newtonian) node interactions: with Q.d and d.Q.d, the field is -Q.d/r^5 + (5/2)(d.Q.d) d/r^7 */
+        double qd_x = list->qxx[k]*dx + list->qxy[k]*dy + list->qxz[k]*dz, qd_y = list->qxy[k]*dx + list->qyy[k]*dy + list->qyz[k]*dz, qd_z = list->qxz[k]*dx + list->qyz[k]*dy + list->qzz[k]*dz;
+        double dqd = dx*qd_x + dy*qd_y + dz*qd_z, rinv5 = (r2 >= h*h) ? rinv*rinv*rinv*rinv*rinv : 0, facq = 2.5 * dqd * rinv5 * rinv*rinv;
+        acc_x += dx * facq - qd_x * rinv5;
+        acc_y += dy * facq - qd_y * rinv5;
+        acc_z += dz * facq - qd_z * rinv5;
+#if defined(EVALPOTENTIAL) && !(defined(BOX_PERIODIC) && !defined(GRAVITY_NOT_PERIODIC))
+        pot -= 0.5 * dqd * rinv5;
+#endif
+#endif
+        ninteractions += (r2 > 0);
+        r2_list[k] = r2;
+        h_list[k] = h;
+    }
+
+    for(k = 0; k < nlist; k++) /* softened (near-field) interactions */
+    {
+        if((r2_list[k] <= 0) || (r2_list[k] >= h_list[k]*h_list[k])) {continue;}
+        double dx = list->x[k] - pos_x, dy = list->y[k] - pos_y, dz = list->z[k] - pos_z;
+        GRAVITY_NEAREST_XYZ(dx,dy,dz,-1);
+        double r = sqrt(r2_list[k]), h_inv = 1. / h_list[k], h3_inv = h_inv*h_inv*h_inv, u = r * h_inv;
+        double fac = list->mass[k] * kernel_gravity(u, h_inv, h3_inv, 1);
+#ifdef PMGRID
+        int tabindex = (int) (asmthfac * r);
+        if(tabindex >= NTAB) {continue;}
+        fac *= shortrange_table[tabindex];
+#endif
+#if defined(EVALPOTENTIAL) && !(defined(BOX_PERIODIC) && !defined(GRAVITY_NOT_PERIODIC))
+        double facpot = list->mass[k] * kernel_gravity(u, h_inv, h3_inv, -1);
+#ifdef PMGRID
+        facpot *= shortrange_table_potential[tabindex];
+#endif
+        pot += facpot;
+#endif
+        acc_x += dx * fac;
+        acc_y += dy * fac;
+        acc_z += dz * fac;
+    }
+
+#if defined(EVALPOTENTIAL) && defined(BOX_PERIODIC) && !defined(GRAVITY_NOT_PERIODIC)
+    for(k = 0; k < nlist; k++) /* periodic potential needs the (tabulated) Ewald-summed form for every interaction */
+    {
+        if(r2_list[k] <= 0) {continue;}
+        double dx = list->x[k] - pos_x, dy = list->y[k] - pos_y, dz = list->z[k] - pos_z;
+        GRAVITY_NEAREST_XYZ(dx,dy,dz,-1);
+#ifdef PMGRID
+        if((int) (asmthfac * sqrt(r2_list[k])) >= NTAB) {continue;}
+#endif
+        pot += list->mass[k] * ewald_pot_corr(dx, dy, dz);
+    }
+#endif
+
+    t->acc[0] += FLT(acc_x);
+    t->acc[1] += FLT(acc_y);
+    t->acc[2] += FLT(acc_z);
+#ifdef EVALPOTENTIAL
+    t->pot += FLT(pot);
+#endif
+    t->ninteractions += ninteractions;
+}
+
+
+/*! This registers the exports of every target in the group to the pseudo-particles (top-level nodes on other tasks)
+ *  collected during the walk, exactly as force_treeevaluate() does for a single target. Targets are done in order;
+ *  if the export buffer fills, the number of targets whose exports were completely registered is returned.
+ */
+static int force_treeevaluate_group_exports(struct gravity_group_target *group, int ntargets, int *pseudo_list, int npseudo, int *exportflag, int *exportnodecount, int *exportindex)
+{
+    int k, n, task, nexp = 0, target;
+    for(k = 0; k < ntargets; k++)
+    {
+        target = group[k].index;
+        for(n = 0; n < npseudo; n++)
+        {
+            if(exportflag[task = DomainTask[pseudo_list[n]]] != target)
+            {
+                exportflag[task] = target;
+                exportnodecount[task] = NODELISTLENGTH;
+            }
+            if(exportnodecount[task] == NODELISTLENGTH)
+            {
+                int exitFlag = 0;
+                LOCK_NEXPORT;
+#ifdef _OPENMP
+#pragma omp critical(_nexport_)
+#endif
+                {
+                    if(Nexport >= All.BunchSize)
+                    {
+                        /* out of buffer space. Need to discard work for this particle and interrupt */
+                        BufferFullFlag = 1;
+                        exitFlag = 1;
+                    }
+                    else
+                    {
+                        nexp = Nexport;
+                        Nexport++;
+                    }
+                }
+                UNLOCK_NEXPORT;
+                if(exitFlag) {return k;}
+                
+                exportnodecount[task] = 0;
+                exportindex[task] = nexp;
+                DataIndexTable[nexp].Task = task;
+                DataIndexTable[nexp].Index = target;
+                DataIndexTable[nexp].IndexGet = nexp;
+            }
+            DataNodeList[exportindex[task]].NodeList[exportnodecount[task]++] = DomainNodeIndex[pseudo_list[n]];
+            if(exportnodecount[task] < NODELISTLENGTH) {DataNodeList[exportindex[task]].NodeList[exportnodecount[task]] = -1;}
+        }
+    }
+    return ntargets;
+}
+
+
+#ifdef GRAVITY_GROUP_EXPANSIONS
+/*! This adds the field of node nop, at separation (dx,dy,dz) from the group center, to the local expansion L
+ *  (monopole and quadrupole to the potential and acceleration, monopole to the tidal tensor) */
+static void force_add_node_to_local_expansion(struct gravity_local_expansion *L, struct NODE *nop, double dx, double dy, double dz)
+{
+    double m = nop->u.d.mass, r2 = dx*dx + dy*dy + dz*dz, rinv = 1. / sqrt(r2), rinv2 = rinv*rinv, rinv5 = rinv2*rinv2*rinv;
+    double fac = m * rinv*rinv2, fac_T = 3. * fac * rinv2;
+    double qd_x = nop->quad[0]*dx + nop->quad[3]*dy + nop->quad[4]*dz, qd_y = nop->quad[3]*dx + nop->quad[1]*dy + nop->quad[5]*dz, qd_z = nop->quad[4]*dx + nop->quad[5]*dy + nop->quad[2]*dz;
+    double dqd = dx*qd_x + dy*qd_y + dz*qd_z, facq = 2.5 * dqd * rinv5 * rinv2;
+    L->phi += -m * rinv - 0.5 * dqd * rinv5;
+    L->g[0] += dx * (fac + facq) - qd_x * rinv5;
+    L->g[1] += dy * (fac + facq) - qd_y * rinv5;
+    L->g[2] += dz * (fac + facq) - qd_z * rinv5;
+    L->T[0] += dx*dx*fac_T - fac; L->T[1] += dy*dy*fac_T - fac; L->T[2] += dz*dz*fac_T - fac;
+    L->T[3] += dx*dy*fac_T; L->T[4] += dx*dz*fac_T; L->T[5] += dy*dz*fac_T;
+}
+
+/*! This evaluates the local expansion L at the position of group member t (offset from the group center) */
+static void force_evaluate_local_expansion(struct gravity_local_expansion *L, double *center, struct gravity_group_target *t)
+{
+    double dx = t->pos[0] - center[0], dy = t->pos[1] - center[1], dz = t->pos[2] - center[2];
+    GRAVITY_NEAREST_XYZ(dx,dy,dz,-1);
+    double T_dx = L->T[0]*dx + L->T[3]*dy + L->T[4]*dz, T_dy = L->T[3]*dx + L->T[1]*dy + L->T[5]*dz, T_dz = L->T[4]*dx + L->T[5]*dy + L->T[2]*dz;
+    t->acc[0] += FLT(L->g[0] + T_dx);
+    t->acc[1] += FLT(L->g[1] + T_dy);
+    t->acc[2] += FLT(L->g[2] + T_dz);
+#ifdef EVALPOTENTIAL
+    t->pot += FLT(L->phi - (L->g[0]*dx + L->g[1]*dy + L->g[2]*dz) - 0.5 * (dx*T_dx + dy*T_dy + dz*T_dz));
+#endif
+}
+#endif
+
+
+/*! Interaction-list version of force_treeevaluate(). In mode 0, a group of spatially-adjacent local targets shares one
+ *  tree-walk: the opening criteria are applied to the bounding sphere of the group (so every node accepted is one which
+ *  would have been accepted for each member individually), and each accepted node or particle is appended to a short
+ *  source list which is then evaluated for all members by force_evaluate_interaction_list(). In mode 1 (imported
+ *  elements, each with its own list of starting nodes) the group is a single element. The return value is the number
+ *  of interactions for the targets which finished, with *ndone set to the number of targets (in order) finished; if
+ *  the export buffer fills before even the first target is done, -1 is returned.
+ */
+int force_treeevaluate_grouped(int *targets, int ntargets, int mode, int *exportflag, int *exportnodecount, int *exportindex, int *ndone)
+{
+    struct gravity_group_target group[ACTIVE_LIST_MAX_CHUNK];
+    struct gravity_interaction_list list;
+    struct NODE *nop = 0;
+    int k, no, target, nodesinlist = 0, listindex = 0, ninteractions = 0, npseudo = 0, pseudo_list[GRAVITY_GROUP_PSEUDO_LIST_LENGTH];
+    double r2, dx, dy, dz, mass, r_min, h, center[3], radius, soft_min, soft_max, aold_min, bbox_min[3], bbox_max[3];
+#if defined(BOX_PERIODIC) && !defined(GRAVITY_NOT_PERIODIC)
+    double xtmp; /* scratch for the box-wrapping macros */
+#endif
+    // cache some global vars in local vars to help compiler with alias analysis
+    int maxPart = All.MaxPart;
+    int maxNodes = MaxNodes;
+    integertime ti_Current = All.Ti_Current;
+    double errTol2 = All.ErrTolTheta * All.ErrTolTheta;
+#ifdef PMGRID
+    double eff_dist, rcut = 0, rcut2;
+#endif
+#ifdef GRAVITY_GROUP_EXPANSIONS
+    struct gravity_local_expansion local = {0};
+    int nlocal = 0;
+#endif
+    
+    *ndone = 0;
+    if(mode != 0) {ntargets = 1;}
+    if(ntargets > ACTIVE_LIST_MAX_CHUNK) {ntargets = ACTIVE_LIST_MAX_CHUNK;}
+    if(ntargets < 1) {return 0;}
+    
+    soft_min = MAX_REAL_NUMBER; soft_max = 0; aold_min = MAX_REAL_NUMBER;
+    for(k = 0; k < 3; k++) {bbox_min[k] = MAX_REAL_NUMBER; bbox_max[k] = -MAX_REAL_NUMBER;}
+    for(k = 0; k < ntargets; k++)
+    {
+        int j, ptype; double aold; MyDouble pos[3];
+        target = group[k].index = targets[k];
+        if(mode == 0)
+        {
+            for(j = 0; j < 3; j++) {pos[j] = P[target].Pos[j];}
+            ptype = P[target].Type; aold = All.ErrTolForceAcc * P[target].OldAcc;
+        }
+        else
+        {
+            for(j = 0; j < 3; j++) {pos[j] = GravDataGet[target].Pos[j];}
+            ptype = GravDataGet[target].Type; aold = All.ErrTolForceAcc * GravDataGet[target].OldAcc;
+        }
+        for(j = 0; j < 3; j++)
+        {
+            group[k].pos[j] = pos[j]; group[k].acc[j] = 0;
+            if(pos[j] < bbox_min[j]) {bbox_min[j] = pos[j];}
+            if(pos[j] > bbox_max[j]) {bbox_max[j] = pos[j];}
+        }
+        group[k].soft = All.ForceSoftening[ptype]; group[k].aold = aold; group[k].ninteractions = 0;
+#ifdef EVALPOTENTIAL
+        group[k].pot = 0;
+#endif
+#ifdef PMGRID
+        group[k].rcut = All.Rcut[0]; group[k].asmthfac = 0.5 / All.Asmth[0] * (NTAB / 3.0);
+#ifdef PM_PLACEHIGHRESREGION
+        if(pmforce_is_particle_high_res(ptype, pos)) {group[k].rcut = All.Rcut[1]; group[k].asmthfac = 0.5 / All.Asmth[1] * (NTAB / 3.0);}
+#endif
+        if(group[k].rcut > rcut) {rcut = group[k].rcut;}
+#endif
+        if(group[k].soft < soft_min) {soft_min = group[k].soft;}
+        if(group[k].soft > soft_max) {soft_max = group[k].soft;}
+        if(aold < aold_min) {aold_min = aold;}
+    }
+    for(k = 0, radius = 0; k < 3; k++) {center[k] = 0.5 * (bbox_min[k] + bbox_max[k]); radius += (bbox_max[k] - bbox_min[k]) * (bbox_max[k] - bbox_min[k]);}
+    radius = 0.5 * sqrt(radius); /* every member lies within this distance of the group center */
+#ifdef PMGRID
+    rcut2 = rcut * rcut;
+#endif
+    
+    list.N = 0;
+    if(mode == 0)
+    {
+        no = maxPart;		/* root node */
+    }
+    else
+    {
+        nodesinlist++;
+        no = GravDataGet[targets[0]].NodeList[0];
+        no = Nodes[no].u.d.nextnode;	/* open it */
+    }
+    
+    while(no >= 0)
+    {
+        while(no >= 0)
+        {
+            if(no < maxPart)
+            {
+                /* the index of the node is the index of the particle */
+                if(P[no].Ti_current != ti_Current)
+                {
+                    LOCK_PARTNODEDRIFT;
+#ifdef _OPENMP
+#pragma omp critical(_partnodedrift_)
+#endif
+                    drift_particle(no, ti_Current);
+                    UNLOCK_PARTNODEDRIFT;
+                }
+                mass = P[no].Mass;
+                if(mass > 0)
+                {
+                    list.x[list.N] = P[no].Pos[0]; list.y[list.N] = P[no].Pos[1]; list.z[list.N] = P[no].Pos[2];
+                    list.mass[list.N] = mass; list.soft[list.N] = All.ForceSoftening[P[no].Type];
+#ifdef GRAVITY_GROUP_EXPANSIONS
+                    list.qxx[list.N] = list.qyy[list.N] = list.qzz[list.N] = list.qxy[list.N] = list.qxz[list.N] = list.qyz[list.N] = 0;
+#endif
+                    if(++list.N == GRAVITY_INTERACTION_LIST_LENGTH) {for(k = 0; k < ntargets; k++) {force_evaluate_interaction_list(&list, &group[k]);} list.N = 0;}
+                }
+                if(TakeLevel >= 0) {P[no].GravCost[TakeLevel] += ntargets;}
+                no = Nextnode[no];
+                continue;
+            }
+            
+            if(no >= maxPart + maxNodes)	/* pseudo particle */
+            {
+                if(mode == 0)
+                {
+                    if(npseudo == GRAVITY_GROUP_PSEUDO_LIST_LENGTH) /* register what we have so far, and drop any targets which no longer fit in the export buffer */
+                    {
+                        ntargets = force_treeevaluate_group_exports(group, ntargets, pseudo_list, npseudo, exportflag, exportnodecount, exportindex);
+                        if(ntargets == 0) {return -1;}
+                        npseudo = 0;
+                    }
+                    pseudo_list[npseudo++] = no - (maxPart + maxNodes);
+                }
+                no = Nextnode[no - maxNodes];
+                continue;
+            }
+            
+            nop = &Nodes[no];
+            
+            if(mode == 1)
+            {
+                if(nop->u.d.bitflags & (1 << BITFLAG_TOPLEVEL))	/* we reached a top-level node again, which means that we are done with the branch */
+                {
+                    no = -1;
+                    continue;
+                }
+            }
+            
+            mass = nop->u.d.mass;
+            if(!(nop->u.d.bitflags & (1 << BITFLAG_MULTIPLEPARTICLES)))
+            {
+                /* open cell */
+                if(mass)
+                {
+                    no = nop->u.d.nextnode;
+                    continue;
+                }
+            }
+            
+            if(nop->Ti_current != ti_Current)
+            {
+                LOCK_PARTNODEDRIFT;
+#ifdef _OPENMP
+#pragma omp critical(_partnodedrift_)
+#endif
+                force_drift_node(no, ti_Current);
+                UNLOCK_PARTNODEDRIFT;
+            }
+            
+            dx = nop->u.d.s[0] - center[0];
+            dy = nop->u.d.s[1] - center[1];
+            dz = nop->u.d.s[2] - center[2];
+            GRAVITY_NEAREST_XYZ(dx,dy,dz,-1);
+            r_min = sqrt(dx * dx + dy * dy + dz * dz) - radius; /* closest approach of any member of the group */
+            r2 = (r_min > 0) ? r_min * r_min : 0;
+            
+#ifdef PMGRID
+            /* check whether we can stop walking along this branch (true only if it is true for every member) */
+            if(r2 > rcut2)
+            {
+                eff_dist = rcut + 0.5 * nop->len + radius;
+                if((GRAVITY_NGB_PERIODIC_BOX_LONG_X(nop->center[0] - center[0], nop->center[1] - center[1], nop->center[2] - center[2], -1) > eff_dist) ||
+                   (GRAVITY_NGB_PERIODIC_BOX_LONG_Y(nop->center[0] - center[0], nop->center[1] - center[1], nop->center[2] - center[2], -1) > eff_dist) ||
+                   (GRAVITY_NGB_PERIODIC_BOX_LONG_Z(nop->center[0] - center[0], nop->center[1] - center[1], nop->center[2] - center[2], -1) > eff_dist))
+                {
+                    no = nop->u.d.sibling;
+                    continue;
+                }
+            }
+#endif
+            
+            if(errTol2)	/* check Barnes-Hut opening criterion */
+            {
+                if(nop->len * nop->len > r2 * errTol2)
+                {
+                    /* open cell */
+                    no = nop->u.d.nextnode;
+                    continue;
+                }
+            }
+#ifndef GRAVITY_HYBRID_OPENING_CRIT
+            else		/* check relative opening criterion */
+#else
+            if(!(All.Ti_Current == 0 && RestartFlag != 1))
+#endif
+            {
+                /* force node to open if any member is within the gravitational softening length */
+                if((r2 < (soft_max+0.6*nop->len)*(soft_max+0.6*nop->len)) || (r2 < (nop->maxsoft+0.6*nop->len)*(nop->maxsoft+0.6*nop->len)))
+                {
+                    no = nop->u.d.nextnode;
+                    continue;
+                }
+                if(mass * nop->len * nop->len > r2 * r2 * aold_min)
+                {
+                    /* open cell */
+                    no = nop->u.d.nextnode;
+                    continue;
+                }
+                /* check in addition whether any member could lie inside the cell */
+                h = 0.60 * nop->len + radius;
+                if((GRAVITY_NGB_PERIODIC_BOX_LONG_X(nop->center[0] - center[0], nop->center[1] - center[1], nop->center[2] - center[2], -1) < h) &&
+                   (GRAVITY_NGB_PERIODIC_BOX_LONG_Y(nop->center[0] - center[0], nop->center[1] - center[1], nop->center[2] - center[2], -1) < h) &&
+                   (GRAVITY_NGB_PERIODIC_BOX_LONG_Z(nop->center[0] - center[0], nop->center[1] - center[1], nop->center[2] - center[2], -1) < h))
+                {
+                    no = nop->u.d.nextnode;
+                    continue;
+                }
+            }
+            
+            if(soft_min < nop->maxsoft)
+            {
+                if(r2 < nop->maxsoft * nop->maxsoft)
+                {
+                    if(maskout_different_softening_flag(nop->u.d.bitflags))	/* bit-5 signals that there are particles of different softening in the node */
+                    {
+                        no = nop->u.d.nextnode;
+                        continue;
+                    }
+                }
+            }
+            
+            if(TakeLevel >= 0) {nop->GravCost += ntargets;}
+            no = nop->u.d.sibling;	/* ok, node can be used */
+            
+#ifdef GRAVITY_GROUP_EXPANSIONS
+            /* if the node would also be accepted were it larger by the diameter of the group, as seen from the group
+               center, and every member is outside its softening, it is folded once into the group's local expansion
+               rather than being evaluated for each member separately */
+            if((ntargets > 1) && (mass > 0) && (r_min > DMAX(soft_max, nop->maxsoft)))
+            {
+                double len_eff = nop->len + 2. * radius, r2_c = dx*dx + dy*dy + dz*dz;
+                int use_local_expansion = (r2_c > 4. * len_eff * len_eff); /* keep well inside the radius of convergence */
+                if(errTol2) {if(len_eff * len_eff > r2_c * errTol2) {use_local_expansion = 0;}}
+                else {if(mass * len_eff * len_eff > r2_c * r2_c * aold_min) {use_local_expansion = 0;}}
+#if defined(BOX_PERIODIC) && !defined(GRAVITY_NOT_PERIODIC)
+                /* every member must see the same periodic image of the node (and the potential needs the per-member Ewald correction) */
+                if(sqrt(r2_c) + len_eff > DMIN(boxHalf_X, DMIN(boxHalf_Y, boxHalf_Z))) {use_local_expansion = 0;}
+#ifdef EVALPOTENTIAL
+                use_local_expansion = 0;
+#endif
+#endif
+                if(use_local_expansion)
+                {
+                    force_add_node_to_local_expansion(&local, nop, dx, dy, dz);
+                    nlocal++;
+                    continue;
+                }
+            }
+#endif
+            if(mass > 0)
+            {
+                list.x[list.N] = nop->u.d.s[0]; list.y[list.N] = nop->u.d.s[1]; list.z[list.N] = nop->u.d.s[2];
+                list.mass[list.N] = mass; list.soft[list.N] = nop->maxsoft;
+#ifdef GRAVITY_GROUP_EXPANSIONS
+                list.qxx[list.N] = nop->quad[0]; list.qyy[list.N] = nop->quad[1]; list.qzz[list.N] = nop->quad[2];
+                list.qxy[list.N] = nop->quad[3]; list.qxz[list.N] = nop->quad[4]; list.qyz[list.N] = nop->quad[5];
+#endif
+                if(++list.N == GRAVITY_INTERACTION_LIST_LENGTH) {for(k = 0; k < ntargets; k++) {force_evaluate_interaction_list(&list, &group[k]);} list.N = 0;}
+            }
+        } // closes inner (while(no>=0)) check
+        if(mode == 1)
+        {
+            listindex++;
+            if(listindex < NODELISTLENGTH)
+            {
+                no = GravDataGet[targets[0]].NodeList[listindex];
+                if(no >= 0)
+                {
+                    nodesinlist++;
+                    no = Nodes[no].u.d.nextnode;	/* open it */
+                }
+            }
+        } // closes (mode == 1) check
+    } // closes outer (while(no>=0)) check
+    
+    if(list.N > 0) {for(k = 0; k < ntargets; k++) {force_evaluate_interaction_list(&list, &group[k]);}}
+    if(npseudo > 0)
+    {
+        ntargets = force_treeevaluate_group_exports(group, ntargets, pseudo_list, npseudo, exportflag, exportnodecount, exportindex);
+        if(ntargets == 0) {return -1;}
+    }
+    
+    /* store result at the proper place */
+    for(k = 0; k < ntargets; k++)
+    {
+        target = group[k].index;
+#ifdef GRAVITY_GROUP_EXPANSIONS
+        if(nlocal > 0) {force_evaluate_local_expansion(&local, center, &group[k]); group[k].ninteractions += nlocal;}
+#endif
+        if(mode == 0)
+        {
+            P[target].GravAccel[0] = group[k].acc[0];
+            P[target].GravAccel[1] = group[k].acc[1];
+            P[target].GravAccel[2] = group[k].acc[2];
+#ifdef EVALPOTENTIAL
+            P[target].Potential = group[k].pot;
+#endif
+        }
+        else
+        {
+            GravDataResult[target].Acc[0] = group[k].acc[0];
+            GravDataResult[target].Acc[1] = group[k].acc[1];
+            GravDataResult[target].Acc[2] = group[k].acc[2];
+#ifdef EVALPOTENTIAL
+            GravDataResult[target].Potential = group[k].pot;
+#endif
+            *exportflag = nodesinlist;
+        }
+        ninteractions += group[k].ninteractions;
+    }
+    *ndone = ntargets;
+    return ninteractions;
+}
+#endif // GRAVITY_TREE_INTERACTION_LISTS
+
+
 
 
 
@@ -3626,6 +4275,15 @@ void force_treeallocate(int maxnodes, int maxpart)
     allbytes += bytes;
     Nodes = Nodes_base - All.MaxPart;
     Extnodes = Extnodes_base - All.MaxPart;
+#ifdef NGB_COMPACT_TREE_NODES
+    if(!(NgbNodes_base = (struct NGBNODE *) mymalloc("NgbNodes_base", bytes = (MaxNodes + 1) * sizeof(struct NGBNODE))))
+    {
+        printf("failed to allocate memory for %d compact neighbor-search tree-nodes (%g MB).\n", MaxNodes, bytes / (1024.0 * 1024.0));
+        endrun(3);
+    }
+    allbytes += bytes;
+    NgbNodes = NgbNodes_base - All.MaxPart;
+#endif
     if(!(Nextnode = (int *) mymalloc("Nextnode", bytes = (maxpart + NTopnodes) * sizeof(int))))
     {
         printf("Failed to allocate %d spaces for 'Nextnode' array (%g MB)\n",
@@ -3669,6 +4327,9 @@ void force_treefree(void)
     {
         myfree(Father);
         myfree(Nextnode);
+#ifdef NGB_COMPACT_TREE_NODES
+        myfree(NgbNodes_base);
+#endif
         myfree(Extnodes_base);
         myfree(Nodes_base);
         myfree(DomainNodeIndex);
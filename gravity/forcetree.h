@@ -38,6 +38,9 @@ void *gravity_primary_loop(void *p);
 void *gravity_secondary_loop(void *p);
 
 int force_treeevaluate(int target, int mode, int *exportflag, int *exportnodecount, int *exportindex);
+#ifdef GRAVITY_TREE_INTERACTION_LISTS
+int force_treeevaluate_grouped(int *targets, int ntargets, int mode, int *exportflag, int *exportnodecount, int *exportindex, int *ndone);
+#endif
 int force_treeevaluate_ewald_correction(int target, int mode, int *exportflag, int *exportnodecount, int *exportindex);
 int force_treeevaluate_potential(int target, int type, int *nexport, int *nsend_local);
 
@@ -77,6 +80,9 @@ int    force_treebuild_single(int npart, struct unbind_data *mp);
 int    force_treeevaluate_direct(int target, int mode);
 
 void   force_treefree(void);
+#ifdef NGB_COMPACT_TREE_NODES
+void   force_build_ngb_nodes(void);
+#endif
 void   force_update_node(int no, int flag);
 void   force_update_node_recursive(int no, int sib, int father);
 void   force_update_size_of_parent_node(int no);
@@ -345,6 +345,11 @@ void force_drift_node(int no, integertime time1)
     
   Extnodes[no].hmax *= exp(Extnodes[no].divVmax * dt_drift_hmax / NUMDIMS);
   Nodes[no].Ti_current = time1;
+#ifdef NGB_COMPACT_TREE_NODES
+  if(NgbNodes[no].len >= 0) {NgbNodes[no].len = Nodes[no].len;}
+  NgbNodes[no].hmax = Extnodes[no].hmax;
+  NgbNodes[no].Ti_current = time1;
+#endif
 }
 
 
@@ -391,6 +396,9 @@ void force_update_hmax(void)
             {
                 if(PPP[i].Hsml > Extnodes[no].hmax)
                     Extnodes[no].hmax = PPP[i].Hsml;
+#ifdef NGB_COMPACT_TREE_NODES
+                NgbNodes[no].hmax = Extnodes[no].hmax;
+#endif
                 
                 if(divVel > Extnodes[no].divVmax)
                     Extnodes[no].divVmax = divVel;
@@ -470,6 +478,9 @@ void force_update_hmax(void)
 	    {
 	      if(domainHmax_all[OffsetSIZE * i] > Extnodes[no].hmax)
 		Extnodes[no].hmax = domainHmax_all[OffsetSIZE * i];
+#ifdef NGB_COMPACT_TREE_NODES
+	      NgbNodes[no].hmax = Extnodes[no].hmax;
+#endif
 
 	      if(domainHmax_all[OffsetSIZE * i + 1] > Extnodes[no].divVmax)
 		Extnodes[no].divVmax = domainHmax_all[OffsetSIZE * i + 1];
@@ -56,6 +56,7 @@ void gravity_tree(void)
     double timecommsumm1 = 0, timecommsumm2 = 0, timewait1 = 0, timewait2 = 0, sum_costtotal, ewaldtot;
     double maxt, sumt, maxt1, sumt1, maxt2, sumt2, sumcommall, sumwaitall, plb, plb_max;
     CPU_Step[CPU_MISC] += measure_time();
+    PROFILE_BEGIN("gravity_tree");
     
     /* set new softening lengths */
     if(All.ComovingIntegrationOn) {set_softenings();}
@@ -132,7 +133,7 @@ void gravity_tree(void)
     /* begin main communication and tree-walk loop. note the ewald-iter terms here allow for multiple iterations for periodic-tree corrections if needed */
     for(Ewald_iter = 0; Ewald_iter <= ewald_max; Ewald_iter++)
     {
-        NextParticle = FirstActiveParticle;	/* begin with this index */
+        build_active_particle_list();	/* flatten the active list, and begin with its first element */
         do /* primary point-element loop */
         {
             iter++;
@@ -168,13 +169,7 @@ void gravity_tree(void)
             
             if(BufferFullFlag) /* we've filled the buffer or reached the end of the list, prepare for communications */
             {
-                int last_nextparticle = NextParticle; NextParticle = save_NextParticle;
-                while(NextParticle >= 0)
-                {
-                    if(NextParticle == last_nextparticle) {break;}
-                    if(ProcessedFlag[NextParticle] != 1) {break;}
-                    ProcessedFlag[NextParticle] = 2; NextParticle = NextActiveParticle[NextParticle];
-                }
+                rewind_active_particle_list(save_NextParticle); /* figure out where we are */
                 if(NextParticle == save_NextParticle) {endrun(114408);} /* in this case, the buffer is too small to process even a single particle */
             
                 int new_export = 0; /* actually calculate exports [so we can tell other tasks] */
@@ -382,7 +377,7 @@ void gravity_tree(void)
             tend = my_second(); timetree1 += timediff(tstart, tend);
             myfree(GravDataOut); myfree(GravDataIn);
             
-            if(NextParticle < 0) {ndone_flag = 1;} else {ndone_flag = 0;} /* figure out if we are done with the particular active set here */
+            if(NextParticle >= ActiveParticleListLength) {ndone_flag = 1;} else {ndone_flag = 0;} /* figure out if we are done with the particular active set here */
             tstart = my_second();
             MPI_Allreduce(&ndone_flag, &ndone, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD); /* call an allreduce to figure out if all tasks are also done here, otherwise we need to iterate */
             tend = my_second(); timewait2 += timediff(tstart, tend);
@@ -504,6 +499,7 @@ void gravity_tree(void)
     /* Now the force computation is finished: gather timing and diagnostic information */
     t1 = WallclockTime = my_second(); timeall += timediff(t0, t1);
     timetree = timetree1 + timetree2; timewait = timewait1 + timewait2; timecomm = timecommsumm1 + timecommsumm2;
+    PROFILE_END(n_exported, iter, Costtotal, timecomm, timewait);
     MPI_Reduce(&timetree, &sumt, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
     MPI_Reduce(&timetree, &maxt, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
     MPI_Reduce(&timetree1, &sumt1, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
@@ -551,71 +547,107 @@ void gravity_tree(void)
 
 void *gravity_primary_loop(void *p)
 {
-    int i, j, ret, thread_id = *(int *) p, *exportflag, *exportnodecount, *exportindex;
+    int i, j, k, ret, thread_id = *(int *) p, *exportflag, *exportnodecount, *exportindex, n_evaluated = 0; double t_thread_start = my_second();
     exportflag = Exportflag + thread_id * NTask; exportnodecount = Exportnodecount + thread_id * NTask; exportindex = Exportindex + thread_id * NTask;
     for(j = 0; j < NTask; j++) {exportflag[j] = -1;} /* Note: exportflag is local to each thread */
     
     while(1)
     {
-        int exitFlag = 0;
+        int exitFlag = 0, chunk_start, chunk_end;
+        if(BufferFullFlag != 0) {break;}
         LOCK_NEXPORT;
 #ifdef _OPENMP
-#pragma omp critical(_nexport_)
+#pragma omp atomic capture
 #endif
-        if(BufferFullFlag != 0 || NextParticle < 0) {exitFlag=1;}
-            else {i=NextParticle; ProcessedFlag[i]=0; NextParticle=NextActiveParticle[NextParticle];}
+        {chunk_start = NextParticle; NextParticle += ActiveParticleChunkSize;} /* claim a chunk of the flattened active list */
         UNLOCK_NEXPORT;
-        if(exitFlag) {break;}
-		 
+        if(chunk_start >= ActiveParticleListLength) {break;}
+        chunk_end = chunk_start + ActiveParticleChunkSize; if(chunk_end > ActiveParticleListLength) {chunk_end = ActiveParticleListLength;}
+        for(k = chunk_start; k < chunk_end; k++) {ProcessedFlag[ActiveParticleList[k]] = 0;}
 
-#if defined(BOX_PERIODIC) && !defined(GRAVITY_NOT_PERIODIC) && !defined(PMGRID)
-        if(Ewald_iter)
+        for(k = chunk_start; k < chunk_end; k++)
         {
-            ret = force_treeevaluate_ewald_correction(i, 0, exportflag, exportnodecount, exportindex);
-            if(ret >= 0) {Ewaldcount += ret; /* note: ewaldcount may be slightly incorrect for multiple threads if buffer gets filled up */} else {break; /* export buffer has filled up */}
-        }
-        else
+            if(BufferFullFlag != 0) {exitFlag = 1; break;}
+            i = ActiveParticleList[k];
+#if defined(BOX_PERIODIC) && !defined(GRAVITY_NOT_PERIODIC) && !defined(PMGRID)
+            if(Ewald_iter)
+            {
+                ret = force_treeevaluate_ewald_correction(i, 0, exportflag, exportnodecount, exportindex);
+                if(ret >= 0) {Ewaldcount += ret; /* note: ewaldcount may be slightly incorrect for multiple threads if buffer gets filled up */} else {exitFlag = 1; break; /* export buffer has filled up */}
+            }
+            else
 #endif
-        {
-            ret = force_treeevaluate(i, 0, exportflag, exportnodecount, exportindex);
-            if(ret < 0) {break;} /* export buffer has filled up */
-            Costtotal += ret;
+            {
+#ifdef GRAVITY_TREE_INTERACTION_LISTS
+                /* group this element with the following ones in the chunk which share its parent tree-node, and walk the tree once for all of them */
+                int ngroup, ndone, group_node = (Father[i] >= 0) ? Nodes[Father[i]].u.d.father : -1;
+                for(ngroup = 1; (k + ngroup < chunk_end) && (group_node >= 0); ngroup++)
+                {
+                    j = ActiveParticleList[k + ngroup];
+                    if((Father[j] < 0) || (Nodes[Father[j]].u.d.father != group_node)) {break;}
+                }
+                ret = force_treeevaluate_grouped(&ActiveParticleList[k], ngroup, 0, exportflag, exportnodecount, exportindex, &ndone);
+                for(j = 0; j < ndone; j++) {ProcessedFlag[ActiveParticleList[k + j]] = 1;} /* particles successfully finished */
+                n_evaluated += ndone;
+                if(ret >= 0) {Costtotal += ret;}
+                if(ndone < ngroup) {exitFlag = 1; break;} /* export buffer has filled up */
+                k += ngroup - 1;
+                continue;
+#else
+                ret = force_treeevaluate(i, 0, exportflag, exportnodecount, exportindex);
+                if(ret < 0) {exitFlag = 1; break;} /* export buffer has filled up */
+                Costtotal += ret;
+#endif
+            }
+            ProcessedFlag[i] = 1;	/* particle successfully finished */
+            n_evaluated++;
         }
-        ProcessedFlag[i] = 1;	/* particle successfully finished */
+        if(exitFlag) {break;}
     } // while loop
+    ThreadDispatchCount[thread_id] += n_evaluated; ThreadDispatchTime[thread_id] += timediff(t_thread_start, my_second());
     return NULL;
 }
 
 
 void *gravity_secondary_loop(void *p)
 {
-    int j, nodesinlist, dummy, ret;
+    int j, nodesinlist, dummy, ret, thread_id = *(int *) p, n_evaluated = 0, chunk_size = Nimport / (ACTIVE_LIST_CHUNKS_PER_THREAD * maxThreads); double t_thread_start = my_second();
+    if(chunk_size > ACTIVE_LIST_MAX_CHUNK) {chunk_size = ACTIVE_LIST_MAX_CHUNK;}
+    if(chunk_size < 1) {chunk_size = 1;}
     while(1)
     {
+        int chunk_start, chunk_end;
         LOCK_NEXPORT;
 #ifdef _OPENMP
-#pragma omp critical(_nexport_)
+#pragma omp atomic capture
 #endif
-        {
-            j = NextJ;
-            NextJ++;
-        }
+        {chunk_start = NextJ; NextJ += chunk_size;} /* claim a chunk of the imported elements */
         UNLOCK_NEXPORT;
-        if(j >= Nimport) {break;}
+        if(chunk_start >= Nimport) {break;}
+        chunk_end = chunk_start + chunk_size; if(chunk_end > Nimport) {chunk_end = Nimport;}
 
-#if defined(BOX_PERIODIC) && !defined(GRAVITY_NOT_PERIODIC) && !defined(PMGRID)
-        if(Ewald_iter)
+        for(j = chunk_start; j < chunk_end; j++)
         {
-            int cost = force_treeevaluate_ewald_correction(j, 1, &dummy, &dummy, &dummy);
-            Ewaldcount += cost;
-        }
-        else
+#if defined(BOX_PERIODIC) && !defined(GRAVITY_NOT_PERIODIC) && !defined(PMGRID)
+            if(Ewald_iter)
+            {
+                int cost = force_treeevaluate_ewald_correction(j, 1, &dummy, &dummy, &dummy);
+                Ewaldcount += cost;
+            }
+            else
 #endif
-        {
-            ret = force_treeevaluate(j, 1, &nodesinlist, &dummy, &dummy);
-            N_nodesinlist += nodesinlist; Costtotal += ret;
+            {
+#ifdef GRAVITY_TREE_INTERACTION_LISTS
+                ret = force_treeevaluate_grouped(&j, 1, 1, &nodesinlist, &dummy, &dummy, &dummy);
+#else
+                ret = force_treeevaluate(j, 1, &nodesinlist, &dummy, &dummy);
+#endif
+                N_nodesinlist += nodesinlist; Costtotal += ret;
+            }
+            n_evaluated++;
         }
     }
+    ThreadDispatchCount[thread_id] += n_evaluated; ThreadDispatchTime[thread_id] += timediff(t_thread_start, my_second());
     return NULL;
 }
 
@@ -709,6 +741,9 @@ static void msort_dataindex_with_tmp(struct data_index *b, size_t n, struct data
 
 void mysort_dataindex(void *b, size_t n, size_t s, int (*cmp) (const void *, const void *))
 {
+#ifdef RADIX_SORT
+    radix_sort_dataindex(b, n, s, cmp); return;
+#endif
     const size_t size = n * s;
     struct data_index *tmp = (struct data_index *) mymalloc("struct data_index *tmp", size);
     msort_dataindex_with_tmp((struct data_index *) b, n, tmp);
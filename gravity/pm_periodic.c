@@ -3181,7 +3181,7 @@ double PowerSpec_Efstathiou(double k)
 
 
 
-void calculate_power_spectra(int num, long long *ntot_type_all)
+void calculate_power_spectra(int num, long long *ntot_type_all, const char *outdir)
 {
   int i, typeflag[6];
 
@@ -3193,7 +3193,7 @@ void calculate_power_spectra(int num, long long *ntot_type_all)
       power_spec_totnumpart += ntot_type_all[i];
     }
 
-  sprintf(power_spec_fname, "%s/powerspec_%03d.txt", All.OutputDir, num);
+  sprintf(power_spec_fname, "%s/powerspec_%03d.txt", outdir, num);
 
   pmforce_periodic(1, typeflag);	/* calculate power spectrum for all particle types */
 
@@ -3210,7 +3210,7 @@ void calculate_power_spectra(int num, long long *ntot_type_all)
 	    typeflag[i] = 1;
 	    power_spec_totnumpart = ntot_type_all[i];
 
-	    sprintf(power_spec_fname, "%s/powerspec_type%d_%03d.txt", All.OutputDir, i, num);
+	    sprintf(power_spec_fname, "%s/powerspec_type%d_%03d.txt", outdir, i, num);
 
 	    pmforce_periodic(1, typeflag);	/* calculate power spectrum for type i */
 	  }
@@ -21,6 +21,24 @@
  * rewritten parallelism, new physics included, new variable/memory conventions added) by Phil Hopkins (phopkins@caltech.edu) for GIZMO.
  */
 
+#ifdef DENSITY_HSML_LOCAL_SOLVE
+#ifndef DENSITY_HSML_NTRIAL
+#define DENSITY_HSML_NTRIAL 6           /* number of trial kernel lengths (besides Hsml itself, half below and half above it) evaluated for particles still iterating */
+#endif
+#ifndef DENSITY_HSML_TRIAL_DLOG
+#define DENSITY_HSML_TRIAL_DLOG 0.1     /* spacing of the trial kernel lengths in ln(h): the default spans 0.74-1.35 Hsml */
+#endif
+static int DensityHsmlTrials;           /* set (on all tasks) for the passes in which the trial lengths are evaluated */
+static MyFloat *HsmlTrialSums;          /* for each particle, the kernel sum and its h-derivative at each trial length */
+
+/*! ratio of trial kernel length k to Hsml */
+static inline double density_hsml_trial_factor(int k)
+{
+    int m = k - DENSITY_HSML_NTRIAL/2; if(m >= 0) {m++;}
+    return exp(DENSITY_HSML_TRIAL_DLOG * m);
+}
+#endif
+
 struct kernel_density /*! defines a number of useful variables we will use below */
 {
   double dp[3],dv[3],r, wk, dwk, hinv, hinv3, hinv4, mj_wk, mj_dwk_r;
@@ -85,6 +103,7 @@ int density_isactive(int n)
 #define INPUTFUNCTION_NAME hydrokerneldensity_particle2in    /* name of the function which loads the element data needed (for e.g. broadcast to other processors, neighbor search) */
 #define OUTPUTFUNCTION_NAME hydrokerneldensity_out2particle  /* name of the function which takes the data returned from other processors and combines it back to the original elements */
 #define CONDITIONFUNCTION_FOR_EVALUATION if(density_isactive(i)) /* function for which elements will be 'active' and allowed to undergo operations. can be a function call, e.g. 'density_is_active(i)', or a direct function call like 'if(P[i].Mass>0)' */
+#define DOMAIN_COST_LOOP DOMAIN_COST_DENSITY /* physics loop this is counted under, when the per-particle cost is measured for the load-balancing (DOMAIN_MULTICONSTRAINT) */
 #include "../system/code_block_xchange_initialize.h" /* pre-define all the ALL_CAPS variables we will use below, so their naming conventions are consistent and they compile together, as well as defining some of the function calls needed */
 
 /*! this structure defines the variables that need to be sent -from- the 'searching' element */
@@ -132,6 +151,10 @@ static struct OUTPUT_STRUCT_NAME
     MyLongDouble DhsmlNgb;
     MyLongDouble Particle_DivVel;
     MyFloat NV_T[3][3];
+#ifdef DENSITY_HSML_LOCAL_SOLVE
+    MyLongDouble NgbTrial[DENSITY_HSML_NTRIAL];
+    MyLongDouble DhsmlNgbTrial[DENSITY_HSML_NTRIAL];
+#endif
 #if defined(HYDRO_MESHLESS_FINITE_VOLUME) && ((HYDRO_FIX_MESH_MOTION==5)||(HYDRO_FIX_MESH_MOTION==6))
     MyDouble ParticleVel[3];
 #endif
@@ -179,6 +202,13 @@ void hydrokerneldensity_out2particle(struct OUTPUT_STRUCT_NAME *out, int i, int
     ASSIGN_ADD(PPP[i].NumNgb, out->Ngb, mode);
     ASSIGN_ADD(PPP[i].DhsmlNgbFactor, out->DhsmlNgb, mode);
     ASSIGN_ADD(P[i].Particle_DivVel, out->Particle_DivVel,   mode);
+#ifdef DENSITY_HSML_LOCAL_SOLVE
+    for(k = 0; k < DENSITY_HSML_NTRIAL; k++)
+    {
+        ASSIGN_ADD(HsmlTrialSums[2*DENSITY_HSML_NTRIAL*i + 2*k], out->NgbTrial[k], mode);
+        ASSIGN_ADD(HsmlTrialSums[2*DENSITY_HSML_NTRIAL*i + 2*k + 1], out->DhsmlNgbTrial[k], mode);
+    }
+#endif
     
     if(P[i].Type == 0)
     {
@@ -260,6 +290,15 @@ int density_evaluate(int target, int mode, int *exportflag, int *exportnodecount
     struct kernel_density kernel; struct INPUT_STRUCT_NAME local; struct OUTPUT_STRUCT_NAME out; memset(&out, 0, sizeof(struct OUTPUT_STRUCT_NAME));
     if(mode == 0) {hydrokerneldensity_particle2in(&local, target, loop_iteration);} else {local = DATAGET_NAME[target];}
     h2 = local.Hsml * local.Hsml; kernel_hinv(local.Hsml, &kernel.hinv, &kernel.hinv3, &kernel.hinv4);
+    double h_search = local.Hsml;
+#ifdef DENSITY_HSML_LOCAL_SOLVE
+    int k_t; double h_t[DENSITY_HSML_NTRIAL], hinv_t[DENSITY_HSML_NTRIAL], hinv3_t[DENSITY_HSML_NTRIAL], hinv4_t[DENSITY_HSML_NTRIAL];
+    if(DensityHsmlTrials)
+    {
+        for(k_t = 0; k_t < DENSITY_HSML_NTRIAL; k_t++) {h_t[k_t] = local.Hsml * density_hsml_trial_factor(k_t); kernel_hinv(h_t[k_t], &hinv_t[k_t], &hinv3_t[k_t], &hinv4_t[k_t]);}
+        h_search = h_t[DENSITY_HSML_NTRIAL - 1]; /* search out to the largest trial length (on the exporting and the evaluating side) */
+    }
+#endif
 #if defined(BLACK_HOLES)
     out.BH_TimeBinGasNeighbor = TIMEBINS;
 #ifdef BH_ACCRETE_NEARESTFIRST
@@ -269,7 +308,7 @@ int density_evaluate(int target, int mode, int *exportflag, int *exportnodecount
     if(mode == 0) {startnode = All.MaxPart; /* root node */} else {startnode = DATAGET_NAME[target].NodeList[0]; startnode = Nodes[startnode].u.d.nextnode;    /* open it */}
     while(startnode >= 0) {
         while(startnode >= 0) {
-            numngb_inbox = ngb_treefind_variable_threads(local.Pos, local.Hsml, target, &startnode, mode, exportflag, exportnodecount, exportindex, ngblist);
+            numngb_inbox = ngb_treefind_variable_threads(local.Pos, h_search, target, &startnode, mode, exportflag, exportnodecount, exportindex, ngblist);
             if(numngb_inbox < 0) return -1;
             for(n = 0; n < numngb_inbox; n++)
             {
@@ -283,6 +322,19 @@ int density_evaluate(int target, int mode, int *exportflag, int *exportnodecount
                 kernel.dp[2] = local.Pos[2] - P[j].Pos[2];
                 NEAREST_XYZ(kernel.dp[0],kernel.dp[1],kernel.dp[2],1);
                 r2 = kernel.dp[0] * kernel.dp[0] + kernel.dp[1] * kernel.dp[1] + kernel.dp[2] * kernel.dp[2];
+#ifdef DENSITY_HSML_LOCAL_SOLVE
+                if(DensityHsmlTrials && (r2 < h_search * h_search)) /* neighbor sums at the trial lengths, for the local solve for Hsml in density() */
+                {
+                    double r_t = sqrt(r2), u_t, wk_t, dwk_t;
+                    for(k_t = 0; k_t < DENSITY_HSML_NTRIAL; k_t++)
+                    {
+                        if(r_t >= h_t[k_t]) {continue;}
+                        u_t = r_t * hinv_t[k_t]; kernel_main(u_t, hinv3_t[k_t], hinv4_t[k_t], &wk_t, &dwk_t, 0);
+                        out.NgbTrial[k_t] += wk_t;
+                        out.DhsmlNgbTrial[k_t] += -(NUMDIMS * hinv_t[k_t] * wk_t + u_t * dwk_t);
+                    }
+                }
+#endif
                 if(r2 < h2) /* this loop is only considering particles inside local.Hsml, i.e. seen-by-main */
                 {
                     kernel.r = sqrt(r2);
@@ -441,6 +493,62 @@ void density_evaluate_extra_physics_gas(struct INPUT_STRUCT_NAME *local, struct
 
 
 
+#ifdef DENSITY_HSML_LOCAL_SOLVE
+/*! for a particle which is still iterating, uses the kernel sums at the trial lengths (found in the same pass as those at Hsml) to solve
+    for the kernel length giving desnumngb neighbors locally, instead of with further passes over the neighbors. The effective neighbor
+    number N(h) is interpolated between the two bracketing lengths with a cubic in (ln h, ln N), matching the slopes dlnN/dlnh given
+    by the kernel derivatives (as in DhsmlNgbFactor), and the root is found with Newton iterations; Left/Right are narrowed to the
+    trial lengths. Returns 1 if the target was bracketed (Hsml is then set to the solution, which the next pass only has to confirm).
+    Otherwise Hsml, NumNgb and DhsmlNgbFactor are moved to the trial length closest to the target, and 0 is returned, so the standard
+    update extrapolates from there */
+static int density_hsml_local_solve(int i, double desnumngb, double desnumngbdev, MyFloat *Left, MyFloat *Right)
+{
+    int k, n = DENSITY_HSML_NTRIAL + 1, a, it; double x[DENSITY_HSML_NTRIAL + 1], N[DENSITY_HSML_NTRIAL + 1], s[DENSITY_HSML_NTRIAL + 1];
+    for(k = 0; k < n; k++) /* (ln h, N, dlnN/dlnh) at the trial lengths and Hsml, in increasing order of h */
+    {
+        if(k == DENSITY_HSML_NTRIAL/2) {x[k] = log(PPP[i].Hsml); N[k] = PPP[i].NumNgb; s[k] = NUMDIMS / PPP[i].DhsmlNgbFactor; continue;}
+        int kt = (k < DENSITY_HSML_NTRIAL/2) ? k : k - 1; double h = PPP[i].Hsml * density_hsml_trial_factor(kt);
+        double S = HsmlTrialSums[2*DENSITY_HSML_NTRIAL*i + 2*kt], D = HsmlTrialSums[2*DENSITY_HSML_NTRIAL*i + 2*kt + 1];
+        x[k] = log(h); N[k] = NORM_COEFF * pow(h, NUMDIMS) * S; s[k] = (S > 0) ? NUMDIMS + h * D / S : NUMDIMS;
+    }
+    for(k = 0; k < n; k++)
+    {
+        if(!(s[k] > 0) || !isfinite(s[k])) {s[k] = NUMDIMS;} /* (N is non-decreasing in h, so only a positive slope is meaningful) */
+        if(N[k] < desnumngb - desnumngbdev) {Left[i] = DMAX(Left[i], exp(x[k]));}
+        if(N[k] > desnumngb + desnumngbdev) {if(Right[i] > 0) {Right[i] = DMIN(Right[i], exp(x[k]));} else {Right[i] = exp(x[k]);}}
+    }
+    if(!(N[n-1] >= desnumngb) || !(N[0] <= desnumngb)) /* not bracketed: move to the trial length closest to the target */
+    {
+        k = (N[n-1] < desnumngb) ? n-1 : 0;
+        PPP[i].Hsml = exp(x[k]); PPP[i].NumNgb = N[k]; PPP[i].DhsmlNgbFactor = NUMDIMS / s[k];
+        return 0;
+    }
+    for(a = 0; a < n - 2; a++) {if(N[a+1] >= desnumngb) {break;}} /* N[a] <= desnumngb <= N[a+1] */
+    double dx = x[a+1] - x[a], t;
+    if(N[a] > 0)
+    {
+        double ya = log(N[a]), yb = log(N[a+1]), Y = log(desnumngb);
+        t = (yb > ya) ? (Y - ya) / (yb - ya) : 0.5;
+        for(it = 0; it < 8; it++) /* Newton iterations on the cubic Hermite interpolant y(t), t in [0,1] */
+        {
+            double t2 = t*t, t3 = t2*t;
+            double y = (2*t3 - 3*t2 + 1) * ya + (t3 - 2*t2 + t) * dx * s[a] + (-2*t3 + 3*t2) * yb + (t3 - t2) * dx * s[a+1];
+            double dy = (6*t2 - 6*t) * ya + (3*t2 - 4*t + 1) * dx * s[a] + (-6*t2 + 6*t) * yb + (3*t2 - 2*t) * dx * s[a+1];
+            if(!(dy > 0)) {break;}
+            double dt = (Y - y) / dy; t += dt;
+            if(t < 0) {t = 0;} if(t > 1) {t = 1;}
+            if(fabs(dt) < 1.e-6) {break;}
+        }
+    } else {
+        t = 1 + (log(desnumngb) - log(N[a+1])) / (dx * s[a+1]); /* no neighbors at the lower end: Newton step from the upper one */
+        if(!(t > 0)) {t = 0.5;} if(t > 1) {t = 1;}
+    }
+    PPP[i].Hsml = exp(x[a] + t * dx);
+    return 1;
+}
+#endif
+
+
 /*! This function computes the local neighbor kernel for each active hydro element, the number of neighbours in the current kernel radius, and the divergence
  * and rotation of the velocity field.  This is used then to compute the effective volume of the element in MFM/MFV/SPH-type methods, which is then used to
  * update volumetric quantities like density and pressure. The routine iterates to attempt to find a target kernel size set adaptively -- see code user guide for details
@@ -452,6 +560,10 @@ void density(void)
     int i, npleft, iter=0, redo_particle, particle_set_to_minhsml_flag = 0, particle_set_to_maxhsml_flag = 0;
     Left = (MyFloat *) mymalloc("Left", NumPart * sizeof(MyFloat));
     Right = (MyFloat *) mymalloc("Right", NumPart * sizeof(MyFloat));
+#ifdef DENSITY_HSML_LOCAL_SOLVE
+    HsmlTrialSums = (MyFloat *) mymalloc("HsmlTrialSums", NumPart * 2 * DENSITY_HSML_NTRIAL * sizeof(MyFloat));
+    DensityHsmlTrials = 0; /* the trial lengths are only evaluated for the particles which did not converge in the first pass */
+#endif
     
     /* initialize anything we need to about the active particles before their loop */
     for(i = FirstActiveParticle; i >= 0; i = NextActiveParticle[i]) {
@@ -726,7 +838,11 @@ void density(void)
                             continue;
                         }
                     
-                    if((particle_set_to_maxhsml_flag==0)&&(particle_set_to_minhsml_flag==0))
+                    int hsml_solved_locally = 0;
+#ifdef DENSITY_HSML_LOCAL_SOLVE
+                    if(DensityHsmlTrials && (particle_set_to_maxhsml_flag==0) && (particle_set_to_minhsml_flag==0)) {hsml_solved_locally = density_hsml_local_solve(i, desnumngb, desnumngbdev, Left, Right);}
+#endif
+                    if((particle_set_to_maxhsml_flag==0)&&(particle_set_to_minhsml_flag==0)&&(hsml_solved_locally==0))
                     {
                         if(PPP[i].NumNgb < (desnumngb - desnumngbdev)) {Left[i] = DMAX(PPP[i].Hsml, Left[i]);}
                         else
@@ -844,6 +960,9 @@ void density(void)
         if(ntot > 0)
         {
             iter++;
+#ifdef DENSITY_HSML_LOCAL_SOLVE
+            DensityHsmlTrials = 1;
+#endif
             if(iter > 10) {PRINT_STATUS("ngb iteration %d: need to repeat for %d%09d particles", iter, (int) (ntot / 1000000000), (int) (ntot % 1000000000));}
             if(iter > MAXITER) {printf("failed to converge in neighbour iteration in density()\n"); fflush(stdout); endrun(1155);}
         }
@@ -852,6 +971,9 @@ void density(void)
     
     /* iteration is done - de-malloc everything now */
     #include "../system/code_block_xchange_perform_ops_demalloc.h" /* this de-allocates the memory for the MPI/OPENMP/Pthreads parallelization block which must appear above */
+#ifdef DENSITY_HSML_LOCAL_SOLVE
+    myfree(HsmlTrialSums);
+#endif
     myfree(Right); myfree(Left);
 
     /* mark as active again */
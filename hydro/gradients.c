@@ -574,6 +574,10 @@ void hydro_gradient_calc(void)
                                                              sizemax(sizeof(struct GasGraddata_in),sizeof(struct GasGraddata_out))));
     CPU_Step[CPU_DENSMISC] += measure_time();
     t0 = my_second();
+#ifdef HOT_PATH_PROFILER
+    long long n_rounds = 0;
+#endif
+    PROFILE_BEGIN("hydro_gradient_calc");
     Ngblist = (int *) mymalloc("Ngblist", NTaskTimesNumPart * sizeof(int));
     DataIndexTable = (struct data_index *) mymalloc("DataIndexTable", All.BunchSize * sizeof(struct data_index));
     DataNodeList = (struct data_nodelist *) mymalloc("DataNodeList", All.BunchSize * sizeof(struct data_nodelist));
@@ -653,10 +657,13 @@ void hydro_gradient_calc(void)
             }
         
         // now we actually begin the main gradient loop //
-        NextParticle = FirstActiveParticle;	/* begin with this index */
+        build_active_particle_list();	/* flatten the active list, and begin with its first element */
         do
         {
             BufferFullFlag = 0; Nexport = 0; save_NextParticle = NextParticle; tstart = my_second();
+#ifdef HOT_PATH_PROFILER
+            n_rounds++;
+#endif
             for(j = 0; j < NTask; j++) {Send_count[j] = 0; Exportflag[j] = -1;} /* do local particles and prepare export list */
 #ifdef PTHREADS_NUM_THREADS
             pthread_t mythreads[PTHREADS_NUM_THREADS - 1]; int threadid[PTHREADS_NUM_THREADS - 1]; pthread_attr_t attr;
@@ -682,13 +689,7 @@ void hydro_gradient_calc(void)
             
             if(BufferFullFlag) /* we've filled the buffer or reached the end of the list, prepare for communications */
             {
-                int last_nextparticle = NextParticle; NextParticle = save_NextParticle; /* figure out where we are */
-                while(NextParticle >= 0)
-                {
-                    if(NextParticle == last_nextparticle) {break;}
-                    if(ProcessedFlag[NextParticle] != 1) {break;}
-                    ProcessedFlag[NextParticle] = 2; NextParticle = NextActiveParticle[NextParticle];
-                }
+                rewind_active_particle_list(save_NextParticle); /* figure out where we are */
                 if(NextParticle == save_NextParticle) {endrun(113308);} /* in this case, the buffer is too small to process even a single particle */
                 
                 int new_export = 0; /* actually calculate exports [so we can tell other tasks] */
@@ -715,7 +716,11 @@ void hydro_gradient_calc(void)
             for(j = 0; j < Nexport; j++) {Send_count[DataIndexTable[j].Task]++;}
             MYSORT_DATAINDEX(DataIndexTable, Nexport, sizeof(struct data_index), data_index_compare); /* construct export count tables */
             tstart = my_second();
+#ifdef SPARSE_NEIGHBOR_EXCHANGE
+            mpi_sparse_exchange_counts(Send_count, Recv_count); /* tell only the tasks we export to about our counts */
+#else
             MPI_Alltoall(Send_count, 1, MPI_INT, Recv_count, 1, MPI_INT, MPI_COMM_WORLD); /* broadcast import/export counts */
+#endif
             tend = my_second(); timewait1 += timediff(tstart, tend);
             
             for(j = 0, Send_offset[0] = 0; j < NTask; j++) {if(j > 0) {Send_offset[j] = Send_offset[j - 1] + Send_count[j - 1];}} /* calculate export table offsets */
@@ -853,7 +858,7 @@ void hydro_gradient_calc(void)
             if(gradient_iteration==0) {myfree(GasGradDataOut);} else {myfree(GasGradDataOut_iter);} /* free the structures used to receive results, weve used it */
             myfree(GasGradDataIn); /* free the structures used to prepare our initial export data, we're done here! */
 
-            if(NextParticle < 0) {ndone_flag = 1;} else {ndone_flag = 0;} /* figure out if we are done with the particular active set here */
+            if(NextParticle >= ActiveParticleListLength) {ndone_flag = 1;} else {ndone_flag = 0;} /* figure out if we are done with the particular active set here */
             tstart = my_second();
             MPI_Allreduce(&ndone_flag, &ndone, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD); /* call an allreduce to figure out if all tasks are also done here, otherwise we need to iterate */
             tend = my_second(); timewait2 += timediff(tstart, tend);
@@ -1679,6 +1684,7 @@ void hydro_gradient_calc(void)
     timecomp = timecomp1 + timecomp2;
     timewait = timewait1 + timewait2;
     timecomm = timecommsumm1 + timecommsumm2;
+    PROFILE_END(n_exported, n_rounds, 0, timecomm, timewait);
     
     CPU_Step[CPU_DENSCOMPUTE] += timecomp;
     CPU_Step[CPU_DENSWAIT] += timewait;
@@ -1753,6 +1759,10 @@ int GasGrad_evaluate(int target, int mode, int *exportflag, int *exportnodecount
     {
         while(startnode >= 0)
         {
+#ifdef NGB_LIST_CACHE
+            if(mode == 0 && gradient_iteration > 0 && (numngb = ngb_list_cache_fetch(target, ngblist)) >= 0) {startnode = -1;} else { /* re-use the list from the first sweep */
+            if(mode == 0 && gradient_iteration == 0) {ngb_list_cache_open(target);}
+#endif
 #ifdef TURB_DIFF_DYNAMIC
             if (gradient_iteration == 0) {
                 numngb = ngb_treefind_pairs_threads(local.Pos, All.TurbDynamicDiffFac * kernel.h_i, target, &startnode, mode, exportflag, exportnodecount, exportindex, ngblist);
@@ -1766,6 +1776,10 @@ int GasGrad_evaluate(int target, int mode, int *exportflag, int *exportnodecount
             
             if(numngb < 0)
                 return -1;
+#ifdef NGB_LIST_CACHE
+            if(mode == 0 && gradient_iteration == 0) {ngb_list_cache_store(target, ngblist, numngb);}
+            }
+#endif
             
             for(n = 0; n < numngb; n++)
             {
@@ -2286,7 +2300,9 @@ void *GasGrad_evaluate_primary(void *p, int gradient_iteration)
 {
 #define CONDITION_FOR_EVALUATION if(P[i].Type==0)
 #define EVALUATION_CALL GasGrad_evaluate(i,0,exportflag,exportnodecount,exportindex,ngblist,gradient_iteration)
+#define DOMAIN_COST_LOOP DOMAIN_COST_HYDRO
 #include "../system/code_block_primary_loop_evaluation.h"
+#undef DOMAIN_COST_LOOP
 #undef CONDITION_FOR_EVALUATION
 #undef EVALUATION_CALL
 }
@@ -135,6 +135,9 @@ int hydro_force_evaluate(int target, int mode, int *exportflag, int *exportnodec
             /* --------------------------------------------------------------------------------- */
             /* get the neighbor list */
             /* --------------------------------------------------------------------------------- */
+#ifdef NGB_LIST_CACHE
+            if(mode == 0 && (numngb = ngb_list_cache_fetch(target, ngblist)) >= 0) {startnode = -1;} else /* list stored by the gradient pass */
+#endif
             numngb = ngb_treefind_pairs_threads(local.Pos, kernel.h_i, target, &startnode, mode, exportflag,
                                        exportnodecount, exportindex, ngblist);
             if(numngb < 0) return -1;
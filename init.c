@@ -192,6 +192,10 @@ void init(void)
 #if defined(BLACK_HOLES) || defined(GALSF_SUBGRID_WINDS)
     All.TimeNextOnTheFlyFoF = All.TimeBegin;
 #endif
+#ifdef INSITU_ANALYSIS
+    All.TimeNextInSitu = All.TimeBegin;
+    All.InSituCount = 0;
+#endif
     
     for(i = 0; i < GRAVCOSTLEVELS; i++)
         All.LevelToTimeBin[i] = 0;
@@ -199,6 +203,11 @@ void init(void)
     for(i = 0; i < NumPart; i++)
         for(j = 0; j < GRAVCOSTLEVELS; j++)
             P[i].GravCost[j] = 0;
+#ifdef DOMAIN_MULTICONSTRAINT
+    for(i = 0; i < NumPart; i++)
+        for(j = 0; j < DOMAIN_COST_LOOPS; j++)
+            P[i].MeasuredCost[j] = 0;
+#endif
     
     if(All.ComovingIntegrationOn)	/*  change to new velocity variable */
     {
@@ -832,7 +841,7 @@ void init(void)
 #endif
         
 #ifdef FOF
-        fof_fof(RestartSnapNum);
+        fof_fof(RestartSnapNum, All.OutputDir);
 #endif
         endrun(0);
     }
@@ -853,11 +862,11 @@ void init(void)
             n_type[P[n].Type]++;
         sumup_large_ints(6, n_type, ntot_type_all);
         
-        calculate_power_spectra(RestartSnapNum, ntot_type_all);
+        calculate_power_spectra(RestartSnapNum, ntot_type_all, All.OutputDir);
 #endif
 #endif
         force_treebuild(NumPart, NULL);
-        twopoint();
+        twopoint(RestartSnapNum, All.OutputDir);
         endrun(0);
     }
 #endif
@@ -1180,7 +1189,7 @@ void test_id_uniqueness(void)
     for(i = 0; i < NumPart; i++)
         ids[i] = P[i].ID;
     
-    parallel_sort(ids, NumPart, sizeof(MyIDType), compare_IDs);
+    parallel_sort_radix(ids, NumPart, sizeof(MyIDType), compare_IDs, key_IDs);
     
     for(i = 1; i < NumPart; i++)
         if(ids[i] == ids[i - 1])
@@ -1216,6 +1225,11 @@ void test_id_uniqueness(void)
     }
 }
 
+unsigned long long key_IDs(const void *a)
+{
+    return *((MyIDType *) a);
+}
+
 int compare_IDs(const void *a, const void *b)
 {
     if(*((MyIDType *) a) < *((MyIDType *) b))
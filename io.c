@@ -38,6 +38,7 @@ void savepositions(int num)
     int n, filenr, gr, ngroups, masterTask, lastTask;
     
     CPU_Step[CPU_MISC] += measure_time();
+    PROFILE_BEGIN("savepositions");
 
 #ifdef CHIMES_REDUCED_OUTPUT 
     if (num % N_chimes_full_output_freq == 0)
@@ -115,17 +116,26 @@ void savepositions(int num)
             sprintf(buf, "%s%s_%03d", All.OutputDir, All.SnapshotFileBase, num);
         
         
-        ngroups = All.NumFilesPerSnapshot / All.NumFilesWrittenInParallel;
-        if((All.NumFilesPerSnapshot % All.NumFilesWrittenInParallel))
-            ngroups++;
-        
-        for(gr = 0; gr < ngroups; gr++)
+#if defined(HAVE_HDF5) && defined(IO_HDF5_PARALLEL)
+        if(All.SnapFormat == 3)
         {
-            if((filenr / All.NumFilesWrittenInParallel) == gr)	/* ok, it's this processor's turn */
+            write_file_hdf5_parallel(buf, filenr); /* all files at once, each written collectively by its tasks */
+        }
+        else
+#endif
+        {
+            ngroups = All.NumFilesPerSnapshot / All.NumFilesWrittenInParallel;
+            if((All.NumFilesPerSnapshot % All.NumFilesWrittenInParallel))
+                ngroups++;
+            
+            for(gr = 0; gr < ngroups; gr++)
             {
-                write_file(buf, masterTask, lastTask);
+                if((filenr / All.NumFilesWrittenInParallel) == gr)	/* ok, it's this processor's turn */
+                {
+                    write_file(buf, masterTask, lastTask);
+                }
+                MPI_Barrier(MPI_COMM_WORLD);
             }
-            MPI_Barrier(MPI_COMM_WORLD);
         }
         
         myfree(CommBuffer);
@@ -135,6 +145,7 @@ void savepositions(int num)
         
         All.Ti_lastoutput = All.Ti_Current;
         
+        PROFILE_END(0, 0, 0, 0, 0);
         CPU_Step[CPU_SNAPSHOT] += measure_time();
 }
     
@@ -144,7 +155,7 @@ void savepositions(int num)
         if(ThisTask == 0)
             printf("\ncomputing group catalogue...\n");
         
-        fof_fof(num);
+        fof_fof(num, All.OutputDir);
         
         if(ThisTask == 0)
             printf("done with group catalogue.\n");
@@ -159,7 +170,7 @@ void savepositions(int num)
         if(ThisTask == 0)
             printf("\ncomputing power spectra...\n");
         
-        calculate_power_spectra(num, &ntot_type_all[0]);
+        calculate_power_spectra(num, &ntot_type_all[0], All.OutputDir);
         
         if(ThisTask == 0)
             printf("done with power spectra.\n");
@@ -3706,65 +3717,183 @@ void get_dataset_name(enum iofields blocknr, char *buf)
 
 
 
-/*! This function writes a snapshot file containing the data from processors
- *  'writeTask' to 'lastTask'. 'writeTask' is the one that actually writes.
- *  Each snapshot file contains a header first, then particle positions,
- *  velocities and ID's.  Then particle masses are written for those particle
- *  types with zero entry in MassTable.  After that, first the internal
- *  energies u, and then the density is written for the SPH particles.  If
- *  cooling is enabled, mean molecular weight and neutral hydrogen abundance
- *  are written for the gas particles. This is followed by the gas kernel
- *  length and further blocks of information, depending on included physics
- *  and compile-time flags.
+#ifdef HAVE_HDF5
+/*! This function returns (a copy of) the HDF5 datatype in which block 'blocknr' is written
  */
-void write_file(char *fname, int writeTask, int lastTask)
+static hid_t get_hdf5_datatype_in_block(enum iofields blocknr)
 {
-    int type, bytes_per_blockelement, npart, nextblock, typelist[6];
-    int n_for_this_task, n, p, pc, offset = 0, task, i;
-    size_t blockmaxlen;
-    int ntot_type[6], nn[6];
-    enum iofields blocknr;
-    char label[8];
-    int bnr;
-    int blksize;
-    MPI_Status status;
-    FILE *fd = 0;
-    
-#ifdef HAVE_HDF5
-    hid_t hdf5_file = 0, hdf5_grp[6], hdf5_headergrp = 0, hdf5_dataspace_memory;
-    hid_t hdf5_datatype = 0, hdf5_dataspace_in_file = 0, hdf5_dataset = 0;
-    herr_t hdf5_status;
-    hsize_t dims[2], count[2], start[2];
-    int rank = 0, pcsum = 0;
-    char buf[500];
-#endif
-    
-#define SKIP  {my_fwrite(&blksize,sizeof(int),1,fd);}
-    
-    /* determine particle numbers of each type in file */
-    
-    if(ThisTask == writeTask)
+    hid_t hdf5_datatype = 0;
+    switch (get_datatype_in_block(blocknr))
     {
-        for(n = 0; n < 6; n++)
-            ntot_type[n] = n_type[n];
-        
-        for(task = writeTask + 1; task <= lastTask; task++)
-        {
-            MPI_Recv(&nn[0], 6, MPI_INT, task, TAG_LOCALN, MPI_COMM_WORLD, &status);
-            for(n = 0; n < 6; n++)
-                ntot_type[n] += nn[n];
-        }
-        
-        for(task = writeTask + 1; task <= lastTask; task++)
-            MPI_Send(&ntot_type[0], 6, MPI_INT, task, TAG_N, MPI_COMM_WORLD);
+        case 0:
+            hdf5_datatype = H5Tcopy(H5T_NATIVE_UINT);
+            break;
+        case 1:
+#ifdef OUTPUT_IN_DOUBLEPRECISION
+            hdf5_datatype = H5Tcopy(H5T_NATIVE_DOUBLE);
+#else
+            hdf5_datatype = H5Tcopy(H5T_NATIVE_FLOAT);
+#endif
+            break;
+        case 2:
+            hdf5_datatype = H5Tcopy(H5T_NATIVE_UINT64);
+            break;
+        case 3:
+#ifdef OUTPUT_POSITIONS_IN_DOUBLE
+            hdf5_datatype = H5Tcopy(H5T_NATIVE_DOUBLE);
+#else 
+            hdf5_datatype = H5Tcopy(H5T_NATIVE_FLOAT);
+#endif
+            break;
     }
-    else
+    return hdf5_datatype;
+}
+
+
+
+#ifdef IO_HDF5_FIELD_POLICIES
+/*
+ * Per-field output policies for HDF5 snapshots (IO_HDF5_FIELD_POLICIES): all datasets are chunked, shuffled and
+ * deflated (level 'OutputCompressionLevel'; low levels are fast). Positions can be quantized to a fixed fraction
+ * 'OutputPositionPrecision' of the box (HDF5 scale-offset filter), and purely diagnostic floating-point fields (those
+ * listed in get_output_policy_in_block(), which are either not read back by a restart from a snapshot or are re-computed
+ * from the other fields when it starts) can be stored with only 'OutputDerivedFieldMantissaBits' bits of mantissa, i.e.
+ * with a relative error below 2^-(bits+1), which makes them compress far better. All other fields -- including the
+ * internal energy and metallicities, which are evolved state -- are always kept exactly. Setting these two parameters
+ * to zero keeps all fields lossless.
+ */
+#define IO_POLICY_CHUNK_LENGTH 65536 /* default number of particles per chunk */
+
+struct io_field_policy
+{
+    int deflate;            /* deflate level (0 for none) */
+    int scaleoffset_digits; /* decimal digits kept by the scale-offset filter (<0 for none) */
+    int mantissa_bits;      /* number of mantissa bits kept (0 for all) */
+};
+
+/*! This function returns the output policy for block 'blocknr'
+ */
+static void get_output_policy_in_block(enum iofields blocknr, struct io_field_policy *pol)
+{
+    pol->deflate = All.OutputCompressionLevel;
+    pol->scaleoffset_digits = -1;
+    pol->mantissa_bits = 0;
+    if(get_datatype_in_block(blocknr) == 0 || get_datatype_in_block(blocknr) == 2) {return;} /* integers: lossless */
+    switch(blocknr)
     {
-        MPI_Send(&n_type[0], 6, MPI_INT, writeTask, TAG_LOCALN, MPI_COMM_WORLD);
-        MPI_Recv(&ntot_type[0], 6, MPI_INT, writeTask, TAG_N, MPI_COMM_WORLD, &status);
+        case IO_POS:
+            if(All.OutputPositionPrecision > 0 && All.BoxSize > 0) {pol->scaleoffset_digits = (int) ceil(-log10(All.OutputPositionPrecision * All.BoxSize)); if(pol->scaleoffset_digits < 0) {pol->scaleoffset_digits = 0;}}
+            break;
+        /* diagnostic fields: re-computed at start-up (density, kernel lengths, ionization state, star formation rates) or never read back */
+        case IO_RHO:
+        case IO_NE:
+        case IO_NH:
+        case IO_HSML:
+        case IO_HSMS:
+        case IO_SFR:
+        case IO_POT:
+        case IO_ACCEL:
+        case IO_DTENTR:
+        case IO_STRESSDIAG:
+        case IO_STRESSOFFDIAG:
+        case IO_STRESSBULK:
+        case IO_SHEARCOEFF:
+        case IO_TSTP:
+        case IO_DBDT:
+        case IO_DIVB:
+        case IO_ABVC:
+        case IO_AMDC:
+        case IO_GRADPHI:
+        case IO_ROTB:
+        case IO_COOLRATE:
+        case IO_CONDRATE:
+        case IO_DENN:
+        case IO_CRATE:
+        case IO_HRATE:
+        case IO_NHRATE:
+        case IO_HHRATE:
+        case IO_MCRATE:
+        case IO_PRESSURE:
+        case IO_EOSCS:
+        case IO_TIDALTENSORPS:
+        case IO_RAD_ACCEL:
+        case IO_EDDINGTON_TENSOR:
+        case IO_COSMICRAY_KAPPA:
+        case IO_VRMS:
+        case IO_VBULK:
+        case IO_VRAD:
+        case IO_VTAN:
+        case IO_VDIV:
+        case IO_VROT:
+        case IO_VORT:
+        case IO_TRUENGB:
+        case IO_AGS_RHO:
+        case IO_AGS_QPT:
+        case IO_AGS_OMEGA:
+        case IO_AGS_CORR:
+        case IO_AGS_NGBS:
+        case IO_VSTURB_DISS:
+        case IO_VSTURB_DRIVE:
+        case IO_MG_PHI:
+        case IO_MG_ACCEL:
+        case IO_TURB_DIFF_COEFF:
+        case IO_DYNERROR:
+        case IO_DYNERRORDEFAULT:
+            pol->mantissa_bits = All.OutputDerivedFieldMantissaBits;
+            break;
+        default:
+            break; /* evolved state (read back by restarts from snapshots) or not listed above: lossless */
     }
-    
-    /* fill file header */
+}
+
+/*! This function returns the dataset-creation property list implementing the output policy of block 'blocknr',
+ *  for a dataset of dimensions 'dims' with 'chunk_length' particles per chunk (0 for the default)
+ */
+static hid_t get_hdf5_dataset_plist_in_block(enum iofields blocknr, int rank, hsize_t *dims, hsize_t chunk_length)
+{
+    struct io_field_policy pol; hsize_t cdims[2]; hid_t plist = H5Pcreate(H5P_DATASET_CREATE);
+    get_output_policy_in_block(blocknr, &pol);
+    if(chunk_length <= 0) {chunk_length = IO_POLICY_CHUNK_LENGTH;}
+    cdims[0] = (chunk_length < dims[0]) ? chunk_length : dims[0]; cdims[1] = dims[1];
+    if(cdims[0] <= 0) {return plist;} /* filters need chunking, which needs a non-empty dataset */
+    H5Pset_chunk(plist, rank, cdims);
+    if(pol.scaleoffset_digits >= 0) {H5Pset_scaleoffset(plist, H5Z_SO_FLOAT_DSCALE, pol.scaleoffset_digits);}
+    H5Pset_shuffle(plist);
+    if(pol.deflate > 0) {H5Pset_deflate(plist, pol.deflate);}
+    return plist;
+}
+
+/*! This function rounds the 'pc' elements of block 'blocknr' in CommBuffer to the number of mantissa bits set by its
+ *  output policy (round-to-nearest on the bit pattern; infinities and NaNs are left alone)
+ */
+void apply_output_policy_to_buffer(enum iofields blocknr, int pc)
+{
+    struct io_field_policy pol; long long i, n; int drop;
+    get_output_policy_in_block(blocknr, &pol);
+    if(pol.mantissa_bits <= 0 || get_datatype_in_block(blocknr) != 1) {return;}
+    n = (long long) pc * get_values_per_blockelement(blocknr);
+#ifdef OUTPUT_IN_DOUBLEPRECISION
+    unsigned long long *u = (unsigned long long *) CommBuffer, half, mask;
+    drop = 52 - pol.mantissa_bits; if(drop <= 0) {return;}
+    half = 1ULL << (drop - 1); mask = ~((1ULL << drop) - 1);
+    for(i = 0; i < n; i++) {if((u[i] & 0x7ff0000000000000ULL) != 0x7ff0000000000000ULL) {u[i] = (u[i] + half) & mask;}}
+#else
+    unsigned int *u = (unsigned int *) CommBuffer, half, mask;
+    drop = 23 - pol.mantissa_bits; if(drop <= 0) {return;}
+    half = 1U << (drop - 1); mask = ~((1U << drop) - 1);
+    for(i = 0; i < n; i++) {if((u[i] & 0x7f800000U) != 0x7f800000U) {u[i] = (u[i] + half) & mask;}}
+#endif
+}
+#endif
+#endif
+
+
+
+/*! This function fills the header of a snapshot file, given the number of particles of each type in the file
+ */
+static void fill_snapshot_header(int *ntot_type)
+{
+    int n;
     
     for(n = 0; n < 6; n++)
     {
@@ -3827,6 +3956,70 @@ void write_file(char *fname, int writeTask, int lastTask)
 #else
     header.flag_doubleprecision = 0;
 #endif
+}
+
+
+
+/*! This function writes a snapshot file containing the data from processors
+ *  'writeTask' to 'lastTask'. 'writeTask' is the one that actually writes.
+ *  Each snapshot file contains a header first, then particle positions,
+ *  velocities and ID's.  Then particle masses are written for those particle
+ *  types with zero entry in MassTable.  After that, first the internal
+ *  energies u, and then the density is written for the SPH particles.  If
+ *  cooling is enabled, mean molecular weight and neutral hydrogen abundance
+ *  are written for the gas particles. This is followed by the gas kernel
+ *  length and further blocks of information, depending on included physics
+ *  and compile-time flags.
+ */
+void write_file(char *fname, int writeTask, int lastTask)
+{
+    int type, bytes_per_blockelement, npart, nextblock, typelist[6];
+    int n_for_this_task, n, p, pc, offset = 0, task, i;
+    size_t blockmaxlen;
+    int ntot_type[6], nn[6];
+    enum iofields blocknr;
+    char label[8];
+    int bnr;
+    int blksize;
+    MPI_Status status;
+    FILE *fd = 0;
+    
+#ifdef HAVE_HDF5
+    hid_t hdf5_file = 0, hdf5_grp[6], hdf5_headergrp = 0, hdf5_dataspace_memory;
+    hid_t hdf5_datatype = 0, hdf5_dataspace_in_file = 0, hdf5_dataset = 0;
+    herr_t hdf5_status;
+    hsize_t dims[2], count[2], start[2];
+    int rank = 0, pcsum = 0;
+    char buf[500];
+#endif
+    
+#define SKIP  {my_fwrite(&blksize,sizeof(int),1,fd);}
+    
+    /* determine particle numbers of each type in file */
+    
+    if(ThisTask == writeTask)
+    {
+        for(n = 0; n < 6; n++)
+            ntot_type[n] = n_type[n];
+        
+        for(task = writeTask + 1; task <= lastTask; task++)
+        {
+            MPI_Recv(&nn[0], 6, MPI_INT, task, TAG_LOCALN, MPI_COMM_WORLD, &status);
+            for(n = 0; n < 6; n++)
+                ntot_type[n] += nn[n];
+        }
+        
+        for(task = writeTask + 1; task <= lastTask; task++)
+            MPI_Send(&ntot_type[0], 6, MPI_INT, task, TAG_N, MPI_COMM_WORLD);
+    }
+    else
+    {
+        MPI_Send(&n_type[0], 6, MPI_INT, writeTask, TAG_LOCALN, MPI_COMM_WORLD);
+        MPI_Recv(&ntot_type[0], 6, MPI_INT, writeTask, TAG_N, MPI_COMM_WORLD, &status);
+    }
+    
+    /* fill file header */
+    fill_snapshot_header(ntot_type);
     
     /* open file and write header */
     
@@ -4008,29 +4201,7 @@ void write_file(char *fname, int writeTask, int lastTask)
 #ifdef HAVE_HDF5
                         if(ThisTask == writeTask && All.SnapFormat == 3 && header.npart[type] > 0)
                         {
-                            switch (get_datatype_in_block(blocknr))
-                            {
-                                case 0:
-                                    hdf5_datatype = H5Tcopy(H5T_NATIVE_UINT);
-                                    break;
-                                case 1:
-#ifdef OUTPUT_IN_DOUBLEPRECISION
-                                    hdf5_datatype = H5Tcopy(H5T_NATIVE_DOUBLE);
-#else
-                                    hdf5_datatype = H5Tcopy(H5T_NATIVE_FLOAT);
-#endif
-                                    break;
-                                case 2:
-                                    hdf5_datatype = H5Tcopy(H5T_NATIVE_UINT64);
-                                    break;
-                                case 3:
-#ifdef OUTPUT_POSITIONS_IN_DOUBLE
-                                    hdf5_datatype = H5Tcopy(H5T_NATIVE_DOUBLE);
-#else 
-                                    hdf5_datatype = H5Tcopy(H5T_NATIVE_FLOAT);
-#endif
-                                    break;
-                            }
+                            hdf5_datatype = get_hdf5_datatype_in_block(blocknr);
                             
                             dims[0] = header.npart[type];
                             dims[1] = get_values_per_blockelement(blocknr);
@@ -4042,7 +4213,11 @@ void write_file(char *fname, int writeTask, int lastTask)
                             get_dataset_name(blocknr, buf);
                             
                             hdf5_dataspace_in_file = H5Screate_simple(rank, dims, NULL);
-#ifndef IO_COMPRESS_HDF5
+#if defined(IO_HDF5_FIELD_POLICIES)
+                            hid_t plist_id = get_hdf5_dataset_plist_in_block(blocknr, rank, dims, 0);
+                            hdf5_dataset = H5Dcreate2(hdf5_grp[type], buf, hdf5_datatype, hdf5_dataspace_in_file, H5P_DEFAULT, plist_id, H5P_DEFAULT);
+                            H5Pclose(plist_id);
+#elif !defined(IO_COMPRESS_HDF5)
                             hdf5_dataset = H5Dcreate(hdf5_grp[type], buf, hdf5_datatype, hdf5_dataspace_in_file, H5P_DEFAULT);
 #else
                             if(dims[0] > 10)
@@ -4082,7 +4257,12 @@ void write_file(char *fname, int writeTask, int lastTask)
                                     pc = blockmaxlen;
                                 
                                 if(ThisTask == task)
+                                {
                                     fill_write_buffer(blocknr, &offset, pc, type);
+#ifdef IO_HDF5_FIELD_POLICIES
+                                    if(All.SnapFormat == 3) {apply_output_policy_to_buffer(blocknr, pc);}
+#endif
+                                }
                                 
                                 if(ThisTask == writeTask && task != writeTask)
                                     MPI_Recv(CommBuffer, bytes_per_blockelement * pc, MPI_BYTE, task,
@@ -4180,6 +4360,158 @@ void write_file(char *fname, int writeTask, int lastTask)
 
 
 
+#if defined(HAVE_HDF5) && defined(IO_HDF5_PARALLEL)
+/*! This function writes the snapshot file 'fname' with parallel HDF5: all tasks assigned to the file (those with the same
+ *  'filenr') open it together through MPI-IO, and each writes its own hyperslab of every dataset directly, with
+ *  collective transfers (so the data does not need to be funneled through a single writing task, and all files are
+ *  written at the same time). The datasets are chunked with 'HDF5ChunkSize' particles per chunk (contiguous if zero),
+ *  and the number of MPI-IO aggregators per file is set by 'HDF5Aggregators' (the MPI-IO default if zero).
+ *  The resulting file has exactly the same layout as the one written by write_file().
+ */
+void write_file_hdf5_parallel(char *fname, int filenr)
+{
+    int type, bytes_per_blockelement, npart, typelist[6], n, pc, offset, rank, file_rank, bnr, ntot_type[6];
+    long long n_loc[6], n_start[6], nrounds, nrounds_max, k;
+    size_t blockmaxlen;
+    enum iofields blocknr;
+    char buf[500];
+    MPI_Comm file_comm;
+    MPI_Info info;
+    hid_t hdf5_file, hdf5_grp[6], hdf5_headergrp, hdf5_plist, hdf5_xfer, hdf5_dataset, hdf5_datatype, hdf5_dataspace_in_file, hdf5_dataspace_memory;
+    hsize_t dims[2], count[2], start[2];
+    
+    MPI_Comm_split(MPI_COMM_WORLD, filenr, ThisTask, &file_comm);
+    
+    /* particle numbers of each type in the file, and the position of this task's particles within them */
+    for(n = 0; n < 6; n++) {n_loc[n] = n_type[n];}
+    MPI_Exscan(n_loc, n_start, 6, MPI_LONG_LONG, MPI_SUM, file_comm);
+    MPI_Comm_rank(file_comm, &file_rank);
+    if(file_rank == 0) {for(n = 0; n < 6; n++) {n_start[n] = 0;}} /* the result of MPI_Exscan is undefined on the first task */
+    MPI_Allreduce(n_type, ntot_type, 6, MPI_INT, MPI_SUM, file_comm);
+    fill_snapshot_header(ntot_type);
+    
+    /* open the file collectively: all calls creating groups, attributes and datasets below are collective over file_comm */
+    MPI_Info_create(&info);
+    if(All.HDF5Aggregators > 0) {sprintf(buf, "%d", All.HDF5Aggregators); MPI_Info_set(info, "cb_nodes", buf);}
+    MPI_Info_set(info, "romio_cb_write", "enable");
+    hdf5_plist = H5Pcreate(H5P_FILE_ACCESS);
+    H5Pset_fapl_mpio(hdf5_plist, file_comm, info);
+    sprintf(buf, "%s.hdf5", fname);
+    hdf5_file = H5Fcreate(buf, H5F_ACC_TRUNC, H5P_DEFAULT, hdf5_plist);
+    H5Pclose(hdf5_plist);
+    MPI_Info_free(&info);
+    if(hdf5_file < 0) {printf("can't open file `%s' for writing snapshot.\n", buf); endrun(123);}
+    
+    hdf5_headergrp = H5Gcreate(hdf5_file, "/Header", 0);
+    for(type = 0; type < 6; type++)
+    {
+        if(header.npart[type] > 0)
+        {
+            sprintf(buf, "/PartType%d", type);
+            hdf5_grp[type] = H5Gcreate(hdf5_file, buf, 0);
+        }
+    }
+    write_header_attributes_in_hdf5(hdf5_headergrp);
+    
+    hdf5_xfer = H5Pcreate(H5P_DATASET_XFER);
+    H5Pset_dxpl_mpio(hdf5_xfer, H5FD_MPIO_COLLECTIVE);
+    
+    for(bnr = 0; bnr < 1000; bnr++)
+    {
+        blocknr = (enum iofields) bnr;
+        if(blocknr == IO_SECONDORDERMASS) {continue;}
+        if(blocknr == IO_LASTENTRY) {break;}
+        if(!blockpresent(blocknr)) {continue;}
+        
+        bytes_per_blockelement = get_bytes_per_blockelement(blocknr, 0);
+        size_t MyBufferSize = All.BufferSize;
+        blockmaxlen = (size_t) ((MyBufferSize * 1024 * 1024) / bytes_per_blockelement);
+        npart = get_particles_in_block(blocknr, &typelist[0]);
+        if(npart <= 0) {continue;}
+        
+        if(ThisTask == 0)
+        {
+            get_dataset_name(blocknr, buf);
+            printf("writing block %d (%s)...\n", bnr, buf);
+        }
+        
+        for(type = 0; type < 6; type++)
+        {
+            if(!typelist[type] || header.npart[type] <= 0) {continue;}
+            
+            hdf5_datatype = get_hdf5_datatype_in_block(blocknr);
+            dims[0] = header.npart[type];
+            dims[1] = get_values_per_blockelement(blocknr);
+            rank = (dims[1] == 1) ? 1 : 2;
+            hdf5_dataspace_in_file = H5Screate_simple(rank, dims, NULL);
+            
+#ifdef IO_HDF5_FIELD_POLICIES
+            hdf5_plist = get_hdf5_dataset_plist_in_block(blocknr, rank, dims, (hsize_t) All.HDF5ChunkSize);
+#else
+            hdf5_plist = H5Pcreate(H5P_DATASET_CREATE);
+            if(All.HDF5ChunkSize > 0)
+            {
+                count[0] = (hsize_t) All.HDF5ChunkSize; if(count[0] > dims[0]) {count[0] = dims[0];}
+                count[1] = dims[1];
+                H5Pset_chunk(hdf5_plist, rank, count);
+#ifdef IO_COMPRESS_HDF5
+                H5Pset_deflate(hdf5_plist, 4);
+#endif
+            }
+#endif
+            get_dataset_name(blocknr, buf);
+            hdf5_dataset = H5Dcreate2(hdf5_grp[type], buf, hdf5_datatype, hdf5_dataspace_in_file, H5P_DEFAULT, hdf5_plist, H5P_DEFAULT);
+            H5Pclose(hdf5_plist);
+            
+            /* each task writes its particles in pieces that fit into CommBuffer. the writes are collective, so every task
+               takes part in the same number of them (with an empty selection once it has nothing left to write) */
+            nrounds = (n_type[type] + (long long) blockmaxlen - 1) / (long long) blockmaxlen;
+            MPI_Allreduce(&nrounds, &nrounds_max, 1, MPI_LONG_LONG, MPI_MAX, file_comm);
+            for(k = 0, offset = 0, start[0] = n_start[type]; k < nrounds_max; k++)
+            {
+                pc = n_type[type] - k * (long long) blockmaxlen;
+                if(pc > (int) blockmaxlen) {pc = blockmaxlen;}
+                if(pc < 0) {pc = 0;}
+                
+                if(pc > 0)
+                {
+                    fill_write_buffer(blocknr, &offset, pc, type);
+#ifdef IO_HDF5_FIELD_POLICIES
+                    apply_output_policy_to_buffer(blocknr, pc);
+#endif
+                    start[1] = 0; count[0] = pc; count[1] = dims[1];
+                    H5Sselect_hyperslab(hdf5_dataspace_in_file, H5S_SELECT_SET, start, NULL, count, NULL);
+                    hdf5_dataspace_memory = H5Screate_simple(rank, count, NULL);
+                    start[0] += pc;
+                }
+                else
+                {
+                    H5Sselect_none(hdf5_dataspace_in_file);
+                    hdf5_dataspace_memory = H5Screate_simple(rank, dims, NULL);
+                    H5Sselect_none(hdf5_dataspace_memory);
+                }
+                H5Dwrite(hdf5_dataset, hdf5_datatype, hdf5_dataspace_memory, hdf5_dataspace_in_file, hdf5_xfer, CommBuffer);
+                H5Sclose(hdf5_dataspace_memory);
+            }
+            
+            H5Dclose(hdf5_dataset);
+            H5Sclose(hdf5_dataspace_in_file);
+            H5Tclose(hdf5_datatype);
+        }
+    }
+    
+    H5Pclose(hdf5_xfer);
+    for(type = 5; type >= 0; type--)
+        if(header.npart[type] > 0)
+            H5Gclose(hdf5_grp[type]);
+    H5Gclose(hdf5_headergrp);
+    H5Fclose(hdf5_file);
+    MPI_Comm_free(&file_comm);
+}
+#endif
+
+
+
 
 #ifdef HAVE_HDF5
 void write_header_attributes_in_hdf5(hid_t handle)
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <math.h>
 #include <time.h>
+#include <limits.h>
 #ifdef PTHREADS_NUM_THREADS
 #include <pthread.h>
 #endif
@@ -51,6 +52,85 @@ extern pthread_mutex_t mutex_nexport, mutex_partnodedrift;
 #endif
 
 
+#ifdef NGB_LIST_CACHE
+/*! This allocates the neighbor-list cache for the current set of active gas particles. It has to be called before
+ *  hydro_gradient_calc() and released with ngb_list_cache_free() after hydro_force(), since the lists sit below the
+ *  communication buffers of both passes in the mymalloc stack. The list storage is sized from the expected number
+ *  of pair neighbors, but never takes more than a quarter of the memory left over after reserving the (worst-case)
+ *  buffers of the two passes; particles whose list no longer fits simply fall back to the tree walk.
+ */
+void ngb_list_cache_allocate(void)
+{
+    int i; long long n_active = 0; size_t reserve, avail;
+    NgbListCache.Start = (int *) mymalloc("NgbListCache.Start", N_gas * sizeof(int));
+    NgbListCache.Length = (int *) mymalloc("NgbListCache.Length", N_gas * sizeof(int));
+    for(i = 0; i < N_gas; i++) {NgbListCache.Length[i] = -1;}
+    for(i = FirstActiveParticle; i >= 0; i = NextActiveParticle[i]) {if(P[i].Type == 0) {n_active++;}}
+    
+    reserve = maxThreads * NumPart * sizeof(int) + 4 * (size_t) All.BufferSize * 1024 * 1024 + N_gas * 1024;
+    avail = (FreeBytes > reserve) ? (FreeBytes - reserve) / 4 : 0;
+    NgbListCache.Capacity = (long long) (4 * All.DesNumNgb) * n_active;
+    if(NgbListCache.Capacity > avail / sizeof(int)) {NgbListCache.Capacity = avail / sizeof(int);}
+    if(NgbListCache.Capacity > INT_MAX) {NgbListCache.Capacity = INT_MAX;}
+    if(NgbListCache.Capacity < 1) {NgbListCache.Capacity = 1;}
+    NgbListCache.List = (int *) mymalloc("NgbListCache.List", NgbListCache.Capacity * sizeof(int));
+    NgbListCache.Used = 0;
+    NgbListCache.Ti_filled = All.Ti_Current;
+}
+
+/*! This releases the neighbor-list cache (in reverse order of allocation) */
+void ngb_list_cache_free(void)
+{
+    myfree(NgbListCache.List);
+    myfree(NgbListCache.Length);
+    myfree(NgbListCache.Start);
+    NgbListCache.Length = NULL;
+}
+
+/*! This is called right before the tree walk whose result should be stored for particle i: it clears the flag which
+ *  the walk sets (in ngb_codeblock_after_condition_threaded.h) when it reaches a pseudo-particle, i.e. when particle i
+ *  also needs to be exported, in which case the local list alone cannot replace the walk later on.
+ */
+void ngb_list_cache_open(int i)
+{
+    if(NgbListCache.Length) {NgbListCache.Length[i] = 0;}
+}
+
+/*! This stores the neighbor list of particle i found by the walk opened with ngb_list_cache_open() */
+void ngb_list_cache_store(int i, int *ngblist, int numngb)
+{
+    long long offset;
+    if(!NgbListCache.Length) {return;}
+    if(NgbListCache.Length[i] != 0) {return;} /* the walk reached other tasks */
+    LOCK_NEXPORT;
+#ifdef _OPENMP
+#pragma omp atomic capture
+#endif
+    {offset = NgbListCache.Used; NgbListCache.Used += numngb;}
+    UNLOCK_NEXPORT;
+    if(offset + numngb > NgbListCache.Capacity) {NgbListCache.Length[i] = -1; return;} /* out of space */
+    memcpy(&NgbListCache.List[offset], ngblist, numngb * sizeof(int));
+    NgbListCache.Start[i] = (int) offset;
+    NgbListCache.Length[i] = numngb;
+}
+
+/*! This copies the stored neighbor list of particle i into ngblist, and returns its length. If there is no valid
+ *  list, -1 is returned and the caller has to do the normal tree walk. The stored lists are a (possibly larger)
+ *  superset of the neighbors needed by the caller, in tree-walk order, so the caller's own distance checks give
+ *  exactly the same interactions (in the same order) as a fresh walk.
+ */
+int ngb_list_cache_fetch(int i, int *ngblist)
+{
+    int numngb;
+    if(!NgbListCache.Length) {return -1;}
+    if(NgbListCache.Ti_filled != All.Ti_Current) {return -1;}
+    if((numngb = NgbListCache.Length[i]) <= 0) {return -1;}
+    memcpy(ngblist, &NgbListCache.List[NgbListCache.Start[i]], numngb * sizeof(int));
+    return numngb;
+}
+#endif
+
+
 
 #ifdef REDUCE_TREEWALK_BRANCHING
 /* definitions and filter sub-routine for reduced branching, vectorized version of tree walk algorithm [more computations, but more 
@@ -90,6 +90,8 @@ void calculate_non_standard_physics(void);
 void compute_statistics(void);
 void execute_resubmit_command(void);
 void make_list_of_active_particles(void);
+void build_active_particle_list(void);
+void rewind_active_particle_list(int save_NextParticle);
 void output_extra_log_messages(void);
 
 
@@ -124,6 +126,13 @@ int ngb_treefind_variable_threads_targeted(MyDouble searchcenter[3], MyFloat hsm
 int ngb_treefind_pairs_threads_targeted(MyDouble searchcenter[3], MyFloat hsml, int target, int *startnode,
                                            int mode, int *exportflag, int *exportnodecount, int *exportindex,
                                            int *ngblist, int TARGET_BITMASK);
+#ifdef NGB_LIST_CACHE
+void ngb_list_cache_allocate(void);
+void ngb_list_cache_free(void);
+void ngb_list_cache_open(int i);
+void ngb_list_cache_store(int i, int *ngblist, int numngb);
+int ngb_list_cache_fetch(int i, int *ngblist);
+#endif
 
 
 
@@ -151,8 +160,8 @@ void myfree_msg(void *p, char *msg);
 void kspace_neutrinos_init(void);
 
 #ifdef OUTPUT_TWOPOINT_ENABLED
-void twopoint(void);
-void twopoint_save(void);
+void twopoint(int num, const char *outdir);
+void twopoint_save(int num, const char *outdir);
 int twopoint_ngb_treefind_variable(MyDouble searchcenter[3], MyFloat rsearch, int target, int *startnode, int mode, int *nexport, int *nsend_local);
 int twopoint_count_local(int target, int mode, int *nexport, int *nsend_local);
 #endif
@@ -181,11 +190,14 @@ int MPI_Sizelimited_Sendrecv(void *sendbuf, int sendcount, MPI_Datatype sendtype
 			     MPI_Datatype recvtype, int source, int recvtag, MPI_Comm comm, MPI_Status * status);
 
 int mpi_calculate_offsets(int *send_count, int *send_offset, int *recv_count, int *recv_offset, int send_identical);
+#ifdef SPARSE_NEIGHBOR_EXCHANGE
+void mpi_sparse_exchange_counts(int *send_count, int *recv_count);
+#endif
 void sort_based_on_field(void *data, int field_offset, int n_items, int item_size, void **data2ptr);
 void mpi_distribute_items_to_tasks(void *data, int task_offset, int *n_items, int *max_n, int item_size);
 
 void parallel_sort_special_P_GrNr_ID(void);
-void calculate_power_spectra(int num, long long *ntot_type_all);
+void calculate_power_spectra(int num, long long *ntot_type_all, const char *outdir);
 
 int pmforce_is_particle_high_res(int type, MyDouble *pos);
 
@@ -211,7 +223,15 @@ double INLINE_FUNC Get_Particle_Size_for_turb(int i);
 #endif
 void parallel_sort(void *base, size_t nmemb, size_t size, int (*compar) (const void *, const void *));
 void parallel_sort_comm(void *base, size_t nmemb, size_t size, int (*compar) (const void *, const void *), MPI_Comm comm);
+typedef unsigned long long (*radix_key_function)(const void *element);
+void parallel_sort_radix(void *base, size_t nmemb, size_t size, int (*compar) (const void *, const void *), radix_key_function getkey);
+#ifdef RADIX_SORT
+void radix_sort_peano(void *b, size_t n, size_t s, int (*cmp) (const void *, const void *));
+void radix_sort_dataindex(void *b, size_t n, size_t s, int (*cmp) (const void *, const void *));
+void radix_sort_records(void *b, size_t n, size_t s, radix_key_function getkey);
+#endif
 int compare_IDs(const void *a, const void *b);
+unsigned long long key_IDs(const void *a);
 void test_id_uniqueness(void);
 
 
@@ -251,7 +271,27 @@ void *myrealloc_movable_fullinfo(void *p, size_t n, const char *func, const char
 void myfree_fullinfo(void *p, const char *func, const char *file, int line);
 void myfree_movable_fullinfo(void *p, const char *func, const char *file, int line);
 
+#ifdef INSITU_ANALYSIS
+typedef void (*insitu_kernel_function)(int num);
+void insitu_register_kernel(const char *name, insitu_kernel_function func);
+void insitu_init(void);
+void insitu_analysis(void);
+#endif
+#ifdef HOT_PATH_PROFILER
+int profile_region_id(const char *name);
+void profile_begin(int id);
+void profile_end(long long n_exports, long long n_rounds, double n_interactions, double t_comm, double t_wait);
+void profile_write_step(double step_time);
+#endif
 void mymalloc_init(void);
+#if defined(NODE_SHARED_TABLES) || defined(COOL_TABULATED_RATES)
+void *shared_table_allocate(const char *name, size_t bytes, MPI_Win *win);
+void shared_table_free(MPI_Win *win);
+int shared_table_is_writer(void);
+MPI_Comm shared_table_leader_comm(void);
+void shared_table_sync(MPI_Win win);
+size_t shared_table_read_file(const char *fname, void *table, size_t bytes, MPI_Win win);
+#endif
 void dump_memory_table(void);
 void report_detailed_memory_usage_of_largest_task(size_t *OldHighMarkBytes, const char *label, const char *func, const char *file, int line);
 
@@ -322,7 +362,7 @@ int blackhole_evaluate_swallow(int target, int mode, int *nexport, int *nsend_lo
 int  blackhole_compare_key(const void *a, const void *b);
 
 
-void fof_fof(int num);
+void fof_fof(int num, const char *outdir);
 void fof_import_ghosts(void);
 void fof_course_binning(void);
 void fof_find_groups(void);
@@ -332,8 +372,8 @@ int fof_link_accross(void);
 void fof_exchange_id_lists(void);
 int fof_grid_compare(const void *a, const void *b);
 void fof_compile_catalogue(void);
-void fof_save_groups(int num);
-void fof_save_local_catalogue(int num);
+void fof_save_groups(int num, const char *outdir);
+void fof_save_local_catalogue(int num, const char *outdir);
 void fof_find_nearest_dmparticle(void);
 int fof_find_nearest_dmparticle_evaluate(int target, int mode, int *nexport, int *nsend_local);
 
@@ -345,6 +385,9 @@ void fof_make_black_holes(void);
 int io_compare_P_GrNr_ID(const void *a, const void *b);
 
 void write_file(char *fname, int readTask, int lastTask);
+#if defined(HAVE_HDF5) && defined(IO_HDF5_PARALLEL)
+void write_file_hdf5_parallel(char *fname, int filenr);
+#endif
 
 void distribute_file(int nfiles, int firstfile, int firsttask, int lasttask, int *filenr, int *master,
 		     int *last);
@@ -357,6 +400,9 @@ void get_dataset_name(enum iofields blocknr, char *buf);
 
 int blockpresent(enum iofields blocknr);
 void fill_write_buffer(enum iofields blocknr, int *pindex, int pc, int type);
+#if defined(HAVE_HDF5) && defined(IO_HDF5_FIELD_POLICIES)
+void apply_output_policy_to_buffer(enum iofields blocknr, int pc);
+#endif
 void empty_read_buffer(enum iofields blocknr, int offset, int pc, int type);
 
 long get_particles_in_block(enum iofields blocknr, int *typelist);
@@ -411,6 +457,7 @@ void reconstruct_timebins(void);
 void init_peano_map(void);
 peanokey peano_hilbert_key(int x, int y, int z, int bits);
 peanokey peano_and_morton_key(int x, int y, int z, int bits, peanokey *morton);
+void peano_hilbert_key_batch(int n, const int *index, peanokey *key, peanokey *morton);
 peanokey morton_key(int x, int y, int z, int bits);
 
 void catch_abort(int sig);
@@ -604,6 +651,9 @@ void rearrange_particle_sequence(void);
 void reorder_gas(void);
 void reorder_particles(void);
 void restart(int modus);
+#ifdef IO_RESTART_ASYNC
+void restart_async_complete(int wait);
+#endif
 void run(void);
 void savepositions(int num);
 void savepositions_ioformat1(int num);
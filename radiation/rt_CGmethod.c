@@ -234,7 +234,7 @@ void rt_diffusion_cg_matrix_multiply(double **matrixmult_in, double **matrixmult
     DataIndexTable = (struct data_index *) mymalloc("DataIndexTable", All.BunchSize * sizeof(struct data_index));
     DataNodeList = (struct data_nodelist *) mymalloc("DataNodeList", All.BunchSize * sizeof(struct data_nodelist));
     
-    NextParticle = FirstActiveParticle;	/* begin with this index */
+    build_active_particle_list();	/* flatten the active list, and begin with its first element */
     do
     {
         BufferFullFlag = 0;
@@ -274,15 +274,7 @@ void rt_diffusion_cg_matrix_multiply(double **matrixmult_in, double **matrixmult
 #endif
         if(BufferFullFlag)
         {
-            int last_nextparticle = NextParticle;
-            NextParticle = save_NextParticle;
-            while(NextParticle >= 0)
-            {
-                if(NextParticle == last_nextparticle) break;
-                if(ProcessedFlag[NextParticle] != 1) break;
-                ProcessedFlag[NextParticle] = 2;
-                NextParticle = NextActiveParticle[NextParticle];
-            }
+            rewind_active_particle_list(save_NextParticle); /* figure out where we are */
             if(NextParticle == save_NextParticle)
             {
                 /* in this case, the buffer is too small to process even a single particle */
@@ -378,7 +370,7 @@ void rt_diffusion_cg_matrix_multiply(double **matrixmult_in, double **matrixmult
         pthread_mutex_destroy(&mutex_nexport);
         pthread_attr_destroy(&attr);
 #endif
-        if(NextParticle < 0) {ndone_flag = 1;} else {ndone_flag = 0;}
+        if(NextParticle >= ActiveParticleListLength) {ndone_flag = 1;} else {ndone_flag = 0;}
         MPI_Allreduce(&ndone_flag, &ndone, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
         /* get the result */
         for(ngrp = 1; ngrp < (1 << PTask); ngrp++)
@@ -33,11 +33,12 @@
 void read_ic(char *fname)
 {
     long i;
-    int num_files, rest_files, ngroups, gr, filenr, masterTask, lastTask, groupMaster;
+    int num_files, rest_files, filenr, masterTask, lastTask;
     double u_init, molecular_weight;
     char buf[500];
     
     CPU_Step[CPU_MISC] += measure_time();
+    PROFILE_BEGIN("read_ic");
     
 #ifdef RESCALEVINI
     if(ThisTask == 0 && RestartFlag == 0)
@@ -60,6 +61,10 @@ void read_ic(char *fname)
         sprintf(buf, "%s.%d", fname, ThisTask + (rest_files - NTask));
         if(All.ICFormat == 3) {sprintf(buf, "%s.%d.hdf5", fname, ThisTask + (rest_files - NTask));}
         
+#ifdef IO_PARALLEL_IC_READ
+        read_file(buf, ThisTask, ThisTask); /* all tasks read at the same time */
+#else
+        int ngroups, gr, groupMaster;
         ngroups = NTask / All.NumFilesWrittenInParallel;
         if((NTask % All.NumFilesWrittenInParallel))
             ngroups++;
@@ -71,6 +76,7 @@ void read_ic(char *fname)
                 read_file(buf, ThisTask, ThisTask);
             MPI_Barrier(MPI_COMM_WORLD);
         }
+#endif
         
         rest_files -= NTask;
     }
@@ -93,6 +99,10 @@ void read_ic(char *fname)
                 sprintf(buf, "%s.hdf5", fname);
         }
         
+#ifdef IO_PARALLEL_IC_READ
+        read_file(buf, masterTask, lastTask); /* all files at the same time, each task reading its own part */
+#else
+        int ngroups, gr;
         ngroups = rest_files / All.NumFilesWrittenInParallel;
         if((rest_files % All.NumFilesWrittenInParallel))
             ngroups++;
@@ -103,6 +113,7 @@ void read_ic(char *fname)
                 read_file(buf, masterTask, lastTask);
             MPI_Barrier(MPI_COMM_WORLD);
         }
+#endif
     }
     
     
@@ -190,6 +201,7 @@ void read_ic(char *fname)
         fflush(stdout);
     }
     
+    PROFILE_END(0, 0, 0, 0, 0);
     CPU_Step[CPU_SNAPSHOT] += measure_time();
 }
 
@@ -646,6 +658,11 @@ void read_file(char *fname, int readTask, int lastTask)
     char label[4], buf[500];
     enum iofields blocknr;
     size_t bytes;
+    int is_reader = (ThisTask == readTask); /* does this task read from the file (otherwise it receives its particles from readTask) */
+#ifdef IO_PARALLEL_IC_READ
+    long long nskip, block_start = 0, type_start = 0;
+    is_reader = 1; /* every task opens the file and reads its own share of each block directly */
+#endif
     
 #ifdef HAVE_HDF5
     int rank, pcsum;
@@ -657,7 +674,7 @@ void read_file(char *fname, int readTask, int lastTask)
 #define SKIP  {my_fread(&blksize1,sizeof(int),1,fd);}
 #define SKIP2  {my_fread(&blksize2,sizeof(int),1,fd);}
     
-    if(ThisTask == readTask)
+    if(is_reader)
     {
         if(All.ICFormat == 1 || All.ICFormat == 2)
         {
@@ -673,8 +690,9 @@ void read_file(char *fname, int readTask, int lastTask)
                 SKIP;
                 my_fread(&label, sizeof(char), 4, fd);
                 my_fread(&nextblock, sizeof(int), 1, fd);
-                printf("Reading header => '%c%c%c%c' (%d byte)\n", label[0], label[1], label[2], label[3],
-                       nextblock);
+                if(ThisTask == readTask)
+                    printf("Reading header => '%c%c%c%c' (%d byte)\n", label[0], label[1], label[2], label[3],
+                           nextblock);
                 SKIP2;
             }
             
@@ -708,10 +726,12 @@ void read_file(char *fname, int readTask, int lastTask)
         }
 #endif
         
+#ifndef IO_PARALLEL_IC_READ
         for(task = readTask + 1; task <= lastTask; task++)
         {
             MPI_Ssend(&header, sizeof(header), MPI_BYTE, task, TAG_HEADER, MPI_COMM_WORLD);
         }
+#endif
         
     }
     else
@@ -963,7 +983,7 @@ void read_file(char *fname, int readTask, int lastTask)
             
             if(npart > 0)
             {
-                    if(ThisTask == readTask)
+                    if(is_reader)
                     {
                         if(All.ICFormat == 2)
                         {
@@ -977,9 +997,15 @@ void read_file(char *fname, int readTask, int lastTask)
                               SKIP2; 
                               SKIP; 
                             }
+#ifdef IO_PARALLEL_IC_READ
+                            block_start = ftell(fd);
+#endif
                         }
                     }
                 
+#ifdef IO_PARALLEL_IC_READ
+                type_start = 0; /* position of the data of the current type within the block */
+#endif
                 for(type = 0, offset = 0, nread = 0; type < 6; type++)
                 {
                     n_in_file = header.npart[type];
@@ -1009,6 +1035,14 @@ void read_file(char *fname, int readTask, int lastTask)
                                     endrun(1313);
                                 }
                             
+#ifdef IO_PARALLEL_IC_READ
+                            if(task != ThisTask) {continue;} /* only read our own share: skip to its start in the file */
+                            nskip = (task - readTask) * (n_in_file / ntask) + (((task - readTask) < (n_in_file % ntask)) ? (task - readTask) : (n_in_file % ntask));
+                            if(All.ICFormat == 1 || All.ICFormat == 2) {fseek(fd, block_start + type_start + nskip * bytes_per_blockelement, SEEK_SET);}
+#ifdef HAVE_HDF5
+                            pcsum = nskip;
+#endif
+#endif
                             
                             do
                             {
@@ -1017,7 +1051,7 @@ void read_file(char *fname, int readTask, int lastTask)
                                 if(pc > (int)blockmaxlen)
                                     pc = blockmaxlen;
                                 
-                                if(ThisTask == readTask)
+                                if(is_reader)
                                 {
                                     if(All.ICFormat == 1 || All.ICFormat == 2)
                                     {
@@ -1089,6 +1123,7 @@ void read_file(char *fname, int readTask, int lastTask)
 #endif
                                 }
                                 
+#ifndef IO_PARALLEL_IC_READ
                                 if(ThisTask == readTask && task != readTask && pc > 0)
                                     MPI_Ssend(CommBuffer, bytes_per_blockelement * pc, MPI_BYTE, task,
                                               TAG_PDATA, MPI_COMM_WORLD);
@@ -1096,6 +1131,7 @@ void read_file(char *fname, int readTask, int lastTask)
                                 if(ThisTask != readTask && task == ThisTask && pc > 0)
                                     MPI_Recv(CommBuffer, bytes_per_blockelement * pc, MPI_BYTE, readTask,
                                              TAG_PDATA, MPI_COMM_WORLD, &status);
+#endif
                                 
                                 if(ThisTask == task)
                                 {
@@ -1108,13 +1144,19 @@ void read_file(char *fname, int readTask, int lastTask)
                             }
                             while(n_for_this_task > 0);
                         }
+#ifdef IO_PARALLEL_IC_READ
+                        type_start += n_in_file * bytes_per_blockelement;
+#endif
                     }
                 }
                 
-                if(ThisTask == readTask)
+                if(is_reader)
                 {
                         if(All.ICFormat == 1 || All.ICFormat == 2)
                         {
+#ifdef IO_PARALLEL_IC_READ
+                            fseek(fd, block_start + blksize1, SEEK_SET); /* each task only read part of the block */
+#endif
                             SKIP2;
                             
                             if(blksize1 != blksize2)
@@ -1150,7 +1192,7 @@ void read_file(char *fname, int readTask, int lastTask)
             N_gas += n_for_this_task;
     }
     
-    if(ThisTask == readTask)
+    if(is_reader)
     {
         if(All.ICFormat == 1 || All.ICFormat == 2)
             fclose(fd);
@@ -9,11 +9,15 @@
 #include <sys/types.h>
 #include <sys/file.h>
 #include <unistd.h>
+#include <errno.h>
 #include <gsl/gsl_rng.h>
 
 #include "allvars.h"
 #include "proto.h"
 #include "domain.h"
+#ifdef IO_RESTART_ASYNC
+#include <pthread.h>
+#endif
 
 static FILE *fd;
 
@@ -23,6 +27,26 @@ static void byten(void *x, size_t n, int modus);
 
 int old_MaxPart = 0, new_MaxPart;
 
+#ifdef IO_RESTART_PORTABLE
+static int restart_portable(int modus);
+#endif
+
+#ifdef IO_RESTART_ASYNC
+/* state of the background write of the restart file of this task (see restart_async_complete) */
+static struct restart_async_data
+{
+    pthread_t thread;
+    int in_flight;              /* a restart file has been handed to the background thread, and its files not yet rotated */
+    volatile int done;          /* set by the background thread when the data is on disk */
+    int error;                  /* errno of a failed write (reported by the main thread) */
+    char *buffer;               /* staging buffer holding the serialized restart data */
+    size_t size;
+    char file[500], file_tmp[500], file_bak[500];
+}
+RestartAsync;
+static void restart_async_start(char *file, char *file_bak);
+#endif
+
 
 /* This function reads or writes the restart files.
  * Each processor writes its own restart file, with the
@@ -49,14 +73,20 @@ void restart(int modus)
     int nprocgroup, masterTask, groupTask;
     struct global_data_all_processes all_task0;
     int nmulti = MULTIPLEDOMAINS, regular_restarts_are_valid = 1, backup_restarts_are_valid = 1;
-    
+    if(modus == 0) {PROFILE_BEGIN("restart_write");} else {PROFILE_BEGIN("restart_read");}
+#ifdef IO_RESTART_ASYNC
+    if(modus == 0) {restart_async_complete(1);} /* blocks only if the previous restart file is still being written */
+#endif
+#ifdef IO_RESTART_PORTABLE
+    if(restart_portable(modus)) {PROFILE_END(0, 0, 0, 0, 0); return;} /* done with the single shared file: otherwise (no portable file found to read) fall back to the per-task files below */
+#endif
 
     
     if(ThisTask == 0 && modus == 0) // writing re-start files: move old files to .bak
     {
         sprintf(buf, "%s/restartfiles", All.OutputDir);
         mkdir(buf, 02755);
-#ifndef NOCALLSOFSYSTEM
+#if !defined(NOCALLSOFSYSTEM) && !defined(IO_RESTART_ASYNC) /* with IO_RESTART_ASYNC, the files are rotated once the new ones are complete */
         int i_Task_iter;
         for(i_Task_iter=0; i_Task_iter<NTask; i_Task_iter++)
         {
@@ -130,7 +160,11 @@ void restart(int modus)
 	    }
 	  else
 	    {
+#ifdef IO_RESTART_ASYNC
+	      if(!(fd = open_memstream(&RestartAsync.buffer, &RestartAsync.size))) /* serialize into memory: the file is written in the background */
+#else
 	      if(!(fd = fopen(buf, "w")))
+#endif
 		{
 		  printf("Restart file '%s' cannot be opened.\n", buf);
 		  endrun(7878);
@@ -308,6 +342,9 @@ void restart(int modus)
 	    }
 
 	  fclose(fd);
+#ifdef IO_RESTART_ASYNC
+	  if(modus == 0) {restart_async_start(buf, buf_bak);}
+#endif
 	}
       else			/* wait inside the group */
 	{
@@ -328,6 +365,7 @@ void restart(int modus)
 
       domain_Decomposition(0, 0, 0);
     }
+  PROFILE_END(0, 0, 0, 0, 0);
 }
 
 
@@ -352,3 +390,279 @@ void in(int *x, int modus)
   else
     my_fwrite(x, 1, sizeof(int), fd);
 }
+
+
+
+#ifdef IO_RESTART_PORTABLE
+/*
+ * With IO_RESTART_PORTABLE the restart data is written with MPI-IO into a single shared file,
+ * 'restartfiles/<RestartFile>.portable', which does not depend on the number of tasks that wrote it.
+ * The layout is: a header (written by task 0) with the sizes of the structures and the particle totals,
+ * followed by All, the active-timebin flags and the (task-independent) driving state; then the state of
+ * the random number generator of every writing task; then P of all gas particles (concatenated in task
+ * order), the matching SphP, and finally P of all non-gas particles. Each block is written collectively,
+ * with every task writing its own contiguous slice.
+ *
+ * On reading, each task (with any number of tasks) takes an equal contiguous share of the gas and of the
+ * non-gas particles, and a full domain decomposition is then done to redistribute them (the tree and domain
+ * data are not stored, since they are specific to the old task layout). The structures themselves are
+ * stored as raw bytes, so the file must be read by an executable compiled with the same options.
+ */
+
+#define RESTART_PORTABLE_MAGIC      0x47495a52  /* identifies the file type */
+#define RESTART_PORTABLE_VERSION    1
+#define RESTART_PORTABLE_CHUNK      ((long long) 1 << 30)  /* maximum bytes per MPI-IO call (counts are 'int') */
+
+struct restart_portable_header
+{
+    int Magic, Version, NTask, Nmulti;
+    int SizeAll, SizeP, SizeSphP, SizeRng;
+    long long TotNumPart, TotN_gas;
+};
+
+
+/*! collectively reads/writes 'nbytes' at 'offset' of the shared restart file, in chunks small enough for
+ *  the MPI-IO interface. all tasks must call this (with nbytes=0 if they have nothing to transfer). */
+static void restart_portable_collective(MPI_File fh, MPI_Offset offset, void *x, long long nbytes, int modus)
+{
+    long long n_chunks, n_chunks_max, k, n; MPI_Status status; char *p;
+    n_chunks = (nbytes + RESTART_PORTABLE_CHUNK - 1) / RESTART_PORTABLE_CHUNK;
+    MPI_Allreduce(&n_chunks, &n_chunks_max, 1, MPI_LONG_LONG, MPI_MAX, MPI_COMM_WORLD);
+    for(k = 0; k < n_chunks_max; k++)
+    {
+        n = nbytes - k * RESTART_PORTABLE_CHUNK; if(n > RESTART_PORTABLE_CHUNK) {n = RESTART_PORTABLE_CHUNK;}
+        if(n > 0) {p = (char *) x + k * RESTART_PORTABLE_CHUNK;} else {n = 0; p = (char *) x;} /* this task is done, but still has to take part in the collective call */
+        if(modus) {MPI_File_read_at_all(fh, offset + k * RESTART_PORTABLE_CHUNK, p, (int) n, MPI_BYTE, &status);}
+            else {MPI_File_write_at_all(fh, offset + k * RESTART_PORTABLE_CHUNK, p, (int) n, MPI_BYTE, &status);}
+    }
+}
+
+
+/*! reads (all tasks) or writes (task 0 only) one item of the header part of the shared restart file, and advances the offset */
+static void restart_portable_item(MPI_File fh, MPI_Offset *offset, void *x, size_t n, int modus)
+{
+    MPI_Status status;
+    if(modus) {MPI_File_read_at(fh, *offset, x, (int) n, MPI_BYTE, &status);}
+        else if(ThisTask == 0) {MPI_File_write_at(fh, *offset, x, (int) n, MPI_BYTE, &status);}
+    *offset += n;
+}
+
+
+/*! reads or writes the task-independent part of the header: All, the active-timebin flags, and the driving-field state.
+ *  this has to be identical on all tasks, so only task 0 writes it. */
+static MPI_Offset restart_portable_global_data(MPI_File fh, MPI_Offset offset, int modus)
+{
+    restart_portable_item(fh, &offset, &All, sizeof(struct global_data_all_processes), modus);
+    restart_portable_item(fh, &offset, TimeBinActive, TIMEBINS * sizeof(int), modus);
+    restart_portable_item(fh, &offset, &SelRnd, sizeof(SelRnd), modus);
+#ifdef TURB_DRIVING
+    restart_portable_item(fh, &offset, gsl_rng_state(StRng), gsl_rng_size(StRng), modus);
+    restart_portable_item(fh, &offset, &StNModes, sizeof(StNModes), modus);
+    restart_portable_item(fh, &offset, &StOUVar, sizeof(StOUVar), modus);
+    restart_portable_item(fh, &offset, StOUPhases, StNModes*6*sizeof(double), modus);
+    restart_portable_item(fh, &offset, StAmpl, StNModes*3*sizeof(double), modus);
+    restart_portable_item(fh, &offset, StAka, StNModes*3*sizeof(double), modus);
+    restart_portable_item(fh, &offset, StAkb, StNModes*3*sizeof(double), modus);
+    restart_portable_item(fh, &offset, StMode, StNModes*3*sizeof(double), modus);
+    restart_portable_item(fh, &offset, &StTPrev, sizeof(StTPrev), modus);
+    restart_portable_item(fh, &offset, &StSolWeightNorm, sizeof(StSolWeightNorm), modus);
+#endif
+    return offset;
+}
+
+
+/*! writes (modus=0) or reads (modus=1) the portable restart file. returns 0 if no portable file was found to read
+ *  (so the per-task restart files should be tried instead), 1 otherwise. */
+static int restart_portable(int modus)
+{
+    char buf[500], buf_bak[500]; int i, ret; double save_PartAllocFactor;
+    long long n_loc[2], n_tot[2], n_start[2], n_end[2];
+    size_t rng_size = gsl_rng_size(random_generator);
+    struct restart_portable_header header;
+    MPI_Offset offset, offset_particles;
+    MPI_Status status;
+    MPI_File fh;
+    
+    sprintf(buf, "%s/restartfiles/%s.portable", All.OutputDir, All.RestartFile);
+    sprintf(buf_bak, "%s/restartfiles/%s.portable.bak", All.OutputDir, All.RestartFile);
+
+    if(modus == 0) /* write */
+    {
+        if(ThisTask == 0)
+        {
+            sprintf(buf_bak, "%s/restartfiles", All.OutputDir); mkdir(buf_bak, 02755);
+            sprintf(buf_bak, "%s/restartfiles/%s.portable.bak", All.OutputDir, All.RestartFile);
+            rename(buf, buf_bak); // move the old restart file to a .bak file //
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+        
+        MPI_Allreduce(&Gas_split, &ret, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+        if(ret > 0 && ThisTask == 0) {PRINT_WARNING("%d newly-spawned gas particles are not yet in the gas block, and will not be written to the restart file", ret);}
+        
+        n_loc[0] = N_gas; n_loc[1] = NumPart - N_gas; /* gas and non-gas particles of this task */
+        MPI_Allreduce(n_loc, n_tot, 2, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+        MPI_Exscan(n_loc, n_start, 2, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+        if(ThisTask == 0) {n_start[0] = n_start[1] = 0;} /* the result of MPI_Exscan is undefined on the first task */
+        
+        if(MPI_File_open(MPI_COMM_WORLD, buf, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+        {
+            printf("Restart file '%s' cannot be opened.\n", buf);
+            endrun(7879);
+        }
+        MPI_File_set_size(fh, 0);
+        
+        header.Magic = RESTART_PORTABLE_MAGIC; header.Version = RESTART_PORTABLE_VERSION; header.NTask = NTask; header.Nmulti = MULTIPLEDOMAINS;
+        header.SizeAll = sizeof(struct global_data_all_processes); header.SizeP = sizeof(struct particle_data); header.SizeSphP = sizeof(struct sph_particle_data); header.SizeRng = rng_size;
+        header.TotNumPart = n_tot[0] + n_tot[1]; header.TotN_gas = n_tot[0];
+        offset = 0;
+        restart_portable_item(fh, &offset, &header, sizeof(header), modus);
+        offset = restart_portable_global_data(fh, offset, modus);
+    }
+    else /* read */
+    {
+        if(MPI_File_open(MPI_COMM_WORLD, buf, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+        {
+            if(MPI_File_open(MPI_COMM_WORLD, buf_bak, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+            {
+                if(ThisTask == 0) {PRINT_STATUS("Portable restart file ('%s' or '%s') not found: trying the per-task restart files", buf, buf_bak);}
+                return 0;
+            }
+            if(ThisTask == 0) {printf("Default portable restartfile ('%s') not found, using the backup ('%s').\n", buf, buf_bak);}
+        }
+        
+        offset = 0;
+        restart_portable_item(fh, &offset, &header, sizeof(header), modus);
+        if(header.Magic != RESTART_PORTABLE_MAGIC || header.Version != RESTART_PORTABLE_VERSION)
+        {
+            if(ThisTask == 0) {printf("Portable restart file '%s' is corrupted or of an unknown version.\n", buf);}
+            endrun(7872);
+        }
+        if(header.SizeAll != sizeof(struct global_data_all_processes) || header.SizeP != sizeof(struct particle_data) ||
+           header.SizeSphP != sizeof(struct sph_particle_data) || header.SizeRng != rng_size)
+        {
+            if(ThisTask == 0) {printf("Portable restart file was written by an executable with different compile-time options (structure sizes All=%d/%d P=%d/%d SphP=%d/%d): it cannot be read.\n",
+                header.SizeAll, (int) sizeof(struct global_data_all_processes), header.SizeP, (int) sizeof(struct particle_data), header.SizeSphP, (int) sizeof(struct sph_particle_data));}
+            endrun(7873);
+        }
+        
+        save_PartAllocFactor = All.PartAllocFactor;
+        offset = restart_portable_global_data(fh, offset, modus);
+        if(All.PartAllocFactor != save_PartAllocFactor && ThisTask == 0) {printf("PartAllocFactor changed: %f/%f , adapting bounds ...\n", All.PartAllocFactor, save_PartAllocFactor);}
+        All.PartAllocFactor = save_PartAllocFactor; /* the number of tasks may have changed, so the bounds are always re-computed */
+        All.TotNumPart = header.TotNumPart; All.TotN_gas = header.TotN_gas;
+        All.MaxPart = (int) (All.PartAllocFactor * (All.TotNumPart / NTask));
+        All.MaxPartSph = (int) (All.PartAllocFactor * (All.TotN_gas / NTask));
+#ifdef ALLOW_IMBALANCED_GASPARTICLELOAD
+        All.MaxPartSph = All.MaxPart;
+#endif
+        if(ThisTask == 0 && header.NTask != NTask) {printf("Restart file was written by %d tasks, now distributing it over %d tasks.\n", header.NTask, NTask);}
+        allocate_memory();
+        
+        n_tot[0] = header.TotN_gas; n_tot[1] = header.TotNumPart - header.TotN_gas;
+        for(i = 0; i < 2; i++) {n_start[i] = (n_tot[i] * ThisTask) / NTask; n_end[i] = (n_tot[i] * (ThisTask + 1)) / NTask; n_loc[i] = n_end[i] - n_start[i];}
+        N_gas = n_loc[0]; NumPart = n_loc[0] + n_loc[1];
+        if(NumPart > All.MaxPart || N_gas > All.MaxPartSph)
+        {
+            printf("Task=%d: NumPart=%d (MaxPart=%d) N_gas=%d (MaxPartSph=%d): 'PartAllocFactor' is too small to load the restart file.\n", ThisTask, NumPart, All.MaxPart, N_gas, All.MaxPartSph);
+            endrun(7874);
+        }
+    }
+
+    /* state of the random number generators: one per writing task. on reading with a different number of tasks, these are re-used cyclically */
+    if(modus) {MPI_File_read_at(fh, offset + (ThisTask % header.NTask) * (MPI_Offset) rng_size, gsl_rng_state(random_generator), (int) rng_size, MPI_BYTE, &status);}
+        else {MPI_File_write_at(fh, offset + ThisTask * (MPI_Offset) rng_size, gsl_rng_state(random_generator), (int) rng_size, MPI_BYTE, &status);}
+    offset_particles = offset + header.NTask * (MPI_Offset) rng_size;
+    
+    /* particle data: P of the gas, SphP of the gas, P of everything else */
+    offset = offset_particles;
+    restart_portable_collective(fh, offset + n_start[0] * (MPI_Offset) sizeof(struct particle_data), &P[0], n_loc[0] * sizeof(struct particle_data), modus);
+    offset += n_tot[0] * (MPI_Offset) sizeof(struct particle_data);
+    restart_portable_collective(fh, offset + n_start[0] * (MPI_Offset) sizeof(struct sph_particle_data), &SphP[0], n_loc[0] * sizeof(struct sph_particle_data), modus);
+    offset += n_tot[0] * (MPI_Offset) sizeof(struct sph_particle_data);
+    restart_portable_collective(fh, offset + n_start[1] * (MPI_Offset) sizeof(struct particle_data), &P[n_loc[0]], n_loc[1] * sizeof(struct particle_data), modus);
+    
+    MPI_File_close(&fh);
+    
+    if(modus) /* read */
+    {
+        Gas_split = 0;
+#ifdef GALSF
+        for(i = 0, Stars_converted = 0; i < N_gas; i++) {if(P[i].Type != 0) {Stars_converted++;}} /* stars formed inside the gas block, not yet moved out of it */
+#endif
+        if(ThisTask == 0) {printf("Doing domain decomposition of the particles read from the portable restart file\n");}
+        domain_Decomposition(0, 0, 0);
+    }
+    return 1;
+}
+#endif
+
+
+
+#ifdef IO_RESTART_ASYNC
+/*
+ * With IO_RESTART_ASYNC, restart(0) only serializes the restart data of each task into a staging buffer in memory,
+ * and hands it to a background thread which writes it to '<file>.tmp' (and syncs it to disk), while the main loop
+ * continues. Once the files of all tasks are complete, the old restart files are moved to '.bak' and the new ones
+ * moved into place (so a complete set of files is always on disk). The next restart(0) blocks only if the previous
+ * write is still in flight. The background thread makes no MPI calls.
+ */
+
+/*! the background thread: write the staging buffer to the temporary file */
+static void *restart_async_thread(void *arg)
+{
+    FILE *fd_async;
+    RestartAsync.error = 0;
+    if(!(fd_async = fopen(RestartAsync.file_tmp, "w"))) {RestartAsync.error = errno;}
+    else
+    {
+        if(fwrite(RestartAsync.buffer, 1, RestartAsync.size, fd_async) != RestartAsync.size) {RestartAsync.error = errno;}
+        if(fflush(fd_async) != 0 || fsync(fileno(fd_async)) != 0) {if(!RestartAsync.error) {RestartAsync.error = errno;}}
+        if(fclose(fd_async) != 0) {if(!RestartAsync.error) {RestartAsync.error = errno;}}
+    }
+    RestartAsync.done = 1;
+    return NULL;
+}
+
+
+/*! hand the serialized restart data of this task to the background thread */
+static void restart_async_start(char *file, char *file_bak)
+{
+    strcpy(RestartAsync.file, file);
+    strcpy(RestartAsync.file_bak, file_bak);
+    sprintf(RestartAsync.file_tmp, "%s.tmp", file);
+    RestartAsync.done = 0;
+    RestartAsync.in_flight = 1;
+    if(pthread_create(&RestartAsync.thread, NULL, restart_async_thread, NULL) != 0)
+    {
+        printf("Task=%d: could not start the thread writing the restart file '%s'\n", ThisTask, file);
+        endrun(7880);
+    }
+}
+
+
+/*! completes a background restart write: if wait=0, this only happens if the files of all tasks are already
+ *  written (so it can be called every step); if wait=1, it blocks until they are. then the files are rotated.
+ *  must be called by all tasks. */
+void restart_async_complete(int wait)
+{
+    int local_done, all_done;
+    if(!RestartAsync.in_flight) {return;} /* the same on all tasks, since the writes are started together */
+    local_done = (wait || RestartAsync.done);
+    MPI_Allreduce(&local_done, &all_done, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if(!all_done) {return;}
+    
+    pthread_join(RestartAsync.thread, NULL);
+    free(RestartAsync.buffer); RestartAsync.buffer = NULL; RestartAsync.size = 0;
+    RestartAsync.in_flight = 0;
+    if(RestartAsync.error)
+    {
+        printf("Task=%d: writing the restart file '%s' failed: %s\n", ThisTask, RestartAsync.file_tmp, strerror(RestartAsync.error));
+        endrun(7881);
+    }
+    MPI_Barrier(MPI_COMM_WORLD); /* all new files are complete: now rotate */
+    rename(RestartAsync.file, RestartAsync.file_bak); // move old restart file to .bak file //
+    rename(RestartAsync.file_tmp, RestartAsync.file);
+    MPI_Barrier(MPI_COMM_WORLD);
+    if(ThisTask == 0) {PRINT_STATUS("Restart files written in the background are complete");}
+}
+#endif
@@ -58,6 +58,9 @@ void run(void)
                 printf("\nFinal time=%g reached. Simulation ends.\n", All.TimeMax);
             
             restart(0);		/* write a restart file to allow continuation of the run for a larger value of TimeMax */
+#ifdef IO_RESTART_ASYNC
+            restart_async_complete(1);	/* make sure it is on disk before we end */
+#endif
             
             if(All.Ti_lastoutput != All.Ti_Current)	/* make a snapshot at the final time in case none has produced at this time */
                 savepositions(All.SnapshotFileCount++);	/* this will be overwritten if All.TimeMax is increased and the run is continued */
@@ -97,6 +100,9 @@ void run(void)
             force_update_tree();	/* update tree dynamically with kicks of last step so that it can be reused */
             make_list_of_active_particles();	/* now we can set the new chain list of active particles */
         }
+#ifdef DOMAIN_MULTICONSTRAINT
+        domain_reset_measured_costs();	/* the active particles measure the cost of their physics anew in this step */
+#endif
         
         compute_grav_accelerations();	/* compute gravitational accelerations for synchronous particles */
 	
@@ -128,6 +134,9 @@ void run(void)
 
         calculate_non_standard_physics();	/* source terms are here treated in a strang-split fashion */
 
+#ifdef INSITU_ANALYSIS
+        insitu_analysis();	/* analysis kernels on the live particle data, reusing the current domain decomposition and tree */
+#endif
 
 	
         /* Check whether we need to interrupt the run */
@@ -156,6 +165,9 @@ void run(void)
         if(stopflag)
         {
             restart(0);		/* write restart file */
+#ifdef IO_RESTART_ASYNC
+            restart_async_complete(1);
+#endif
             MPI_Barrier(MPI_COMM_WORLD);
             
             if(stopflag == 2 && ThisTask == 0)
@@ -192,6 +204,9 @@ void run(void)
             stopflag = 0;
             All.TimeLastRestartFile += report_time();
         }
+#ifdef IO_RESTART_ASYNC
+        restart_async_complete(0);	/* rotate the files of a restart written in the background, once it is done on all tasks */
+#endif
         
         set_random_numbers();	/* draw a new list of random numbers */
         
@@ -213,6 +228,11 @@ void set_non_standard_physics_for_current_time(void)
     /* load the metal-line cooling tables appropriate for the UV background */
     if(All.ComovingIntegrationOn) LoadMultiSpeciesTables();
 #endif
+
+#ifdef COOL_TABULATED_RATES
+    /* update the pre-computed net cooling rates (new planes are only computed when the redshift leaves the current interval) */
+    cooling_table_update();
+#endif
     
 }
 
@@ -291,7 +311,7 @@ void calculate_non_standard_physics(void)
     /* this will find new black hole seed halos and/or assign host halo masses for the variable wind model */
     if(All.Time >= All.TimeNextOnTheFlyFoF)
     {
-        fof_fof(-1);
+        fof_fof(-1, All.OutputDir);
         if(All.ComovingIntegrationOn)
             All.TimeNextOnTheFlyFoF *= All.TimeBetOnTheFlyFoF;
         else
@@ -526,6 +546,34 @@ void make_list_of_active_particles(void)
 }
 
 
+/* flatten the chain of active particles into an array, so the threaded neighbor loops can hand out work by atomically incrementing a
+    counter (NextParticle is then a position in ActiveParticleList) instead of walking the chain inside a critical section. This is re-built
+    at the start of every loop, since the chain itself can be modified between loops (star formation, merge/split, etc). */
+void build_active_particle_list(void)
+{
+    int i, n;
+    for(i = FirstActiveParticle, n = 0; i >= 0; i = NextActiveParticle[i]) {ActiveParticleList[n++] = i;}
+    ActiveParticleListLength = n;
+    ActiveParticleChunkSize = n / (ACTIVE_LIST_CHUNKS_PER_THREAD * maxThreads);
+    if(ActiveParticleChunkSize > ACTIVE_LIST_MAX_CHUNK) {ActiveParticleChunkSize = ACTIVE_LIST_MAX_CHUNK;}
+    if(ActiveParticleChunkSize < 1) {ActiveParticleChunkSize = 1;}
+    NextParticle = 0;
+}
+
+
+/* after the export buffer filled, set NextParticle to the first element of the list (starting from the position save_NextParticle
+    at the beginning of this pass) which was not fully processed: everything before it is flagged (=2) as done, everything after it will be re-done */
+void rewind_active_particle_list(int save_NextParticle)
+{
+    int last_nextparticle = NextParticle; if(last_nextparticle > ActiveParticleListLength) {last_nextparticle = ActiveParticleListLength;}
+    for(NextParticle = save_NextParticle; NextParticle < last_nextparticle; NextParticle++)
+    {
+        if(ProcessedFlag[ActiveParticleList[NextParticle]] != 1) {break;}
+        ProcessedFlag[ActiveParticleList[NextParticle]] = 2;
+    }
+}
+
+
 
 
 
@@ -807,6 +855,24 @@ void write_cpu_log(void)
   MPI_Reduce(CPU_Step, max_CPU_Step, CPU_PARTS, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
   MPI_Reduce(CPU_Step, avg_CPU_Step, CPU_PARTS, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
 
+#ifdef HOT_PATH_PROFILER
+  profile_write_step(max_CPU_Step[0]); /* per-region profile of this step (uses the per-thread counters, which are reset below) */
+#endif
+  double thread_imbal[2] = {0, 0}, thread_imbal_max[2] = {0, 0}; /* thread imbalance of the threaded loops on each task: max/mean over threads of the busy time and number of evaluated elements */
+  if(maxThreads > 1)
+    {
+      double tmax = 0, tsum = 0, nmax = 0, nsum = 0;
+      for(i = 0; i < maxThreads; i++)
+        {
+          tsum += ThreadDispatchTime[i]; if(ThreadDispatchTime[i] > tmax) {tmax = ThreadDispatchTime[i];}
+          nsum += ThreadDispatchCount[i]; if(ThreadDispatchCount[i] > nmax) {nmax = ThreadDispatchCount[i];}
+          ThreadDispatchTime[i] = 0; ThreadDispatchCount[i] = 0;
+        }
+      if(tsum > 0) {thread_imbal[0] = tmax * maxThreads / tsum;}
+      if(nsum > 0) {thread_imbal[1] = nmax * maxThreads / nsum;}
+      MPI_Reduce(thread_imbal, thread_imbal_max, 2, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    }
+
 
   if(ThisTask == 0)
     {
@@ -995,6 +1061,7 @@ void write_cpu_log(void)
     All.CPU_Sum[CPU_LOCALWIND], (All.CPU_Sum[CPU_LOCALWIND]) / All.CPU_Sum[CPU_ALL] * 100,
 
     All.CPU_Sum[CPU_MISC], (All.CPU_Sum[CPU_MISC]) / All.CPU_Sum[CPU_ALL] * 100);
+    if(maxThreads > 1) {fprintf(FdCPU, "thread imbalance (max/mean over %d threads, worst task, this step): busy time %6.3f  elements %6.3f\n", maxThreads, thread_imbal_max[0], thread_imbal_max[1]);}
         
     fprintf(FdCPU, "\n");
     fflush(FdCPU);
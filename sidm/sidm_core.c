@@ -71,7 +71,13 @@ void init_geofactor_table(void)
 {
     int i; double result, abserr,r;
     gsl_function F; gsl_integration_workspace *workspace; workspace = gsl_integration_workspace_alloc(GSLWORKSIZE);
+#ifdef NODE_SHARED_TABLES
+    /* the integrations are divided over the tasks, and the table is assembled on all of them (it is too small to be worth sharing) */
+    for(i = 0; i < GEOFACTOR_TABLE_LENGTH; i++) {GeoFactorTable[i] = 0;}
+    for(i = ThisTask; i < GEOFACTOR_TABLE_LENGTH; i += NTask)
+#else
     for(i = 0; i < GEOFACTOR_TABLE_LENGTH; i++)
+#endif
     {
         r =  2.0/GEOFACTOR_TABLE_LENGTH * (i + 1);
         F.function = &geofactor_integ;
@@ -80,6 +86,9 @@ void init_geofactor_table(void)
         GeoFactorTable[i] = 2*M_PI*result;
     }
     gsl_integration_workspace_free(workspace);
+#ifdef NODE_SHARED_TABLES
+    MPI_Allreduce(MPI_IN_PLACE, GeoFactorTable, GEOFACTOR_TABLE_LENGTH, (sizeof(MyDouble) == sizeof(double)) ? MPI_DOUBLE : MPI_FLOAT, MPI_SUM, MPI_COMM_WORLD);
+#endif
 }
 
 /*! This function returns the integrand of the numerical integration done on init_geofactor_table(). */
@@ -84,7 +84,7 @@ static float *fof_nearest_distance;
 static float *fof_nearest_hsml;
 
 
-void fof_fof(int num)
+void fof_fof(int num, const char *outdir)
 {
   int i, ndm, start, lenloc, largestgroup, n;
   double mass, masstot, rhodm, t0, t1;
@@ -309,10 +309,10 @@ void fof_fof(int num)
 
   if(num >= 0)
     {
-      fof_save_groups(num);
+      fof_save_groups(num, outdir);
 #ifdef SUBFIND
       if(DumpFlag != 2)
-	subfind(num);
+	subfind(num, outdir);
 #endif
     }
 
@@ -1128,7 +1128,7 @@ void fof_finish_group_properties(void)
 
 
 
-void fof_save_groups(int num)
+void fof_save_groups(int num, const char *outdir)
 {
   int i, j, start, lenloc, nprocgroup, masterTask, groupTask, ngr, totlen;
   long long totNids;
@@ -1193,7 +1193,7 @@ void fof_save_groups(int num)
     }
 
   /* sort the groups according to group-number */
-  parallel_sort(Group, Ngroups, sizeof(group_properties), fof_compare_Group_GrNr);
+  parallel_sort_radix(Group, Ngroups, sizeof(group_properties), fof_compare_Group_GrNr, fof_key_Group_GrNr);
 
   /* fill in the offset-values */
   for(i = 0, totlen = 0; i < Ngroups; i++)
@@ -1268,7 +1268,11 @@ void fof_save_groups(int num)
     }
 
   /* sort the particle IDs according to group-number */
+#ifdef LONGIDS
   parallel_sort(ID_list, Nids, sizeof(fof_id_list), fof_compare_ID_list_GrNrID);
+#else
+  parallel_sort_radix(ID_list, Nids, sizeof(fof_id_list), fof_compare_ID_list_GrNrID, fof_key_ID_list_GrNrID);
+#endif
 
   t1 = my_second();
   PRINT_STATUS("Group catalogues globally sorted. took = %g sec. Started saving of group catalogue", timediff(t0, t1));
@@ -1276,7 +1280,7 @@ void fof_save_groups(int num)
 
   if(ThisTask == 0)
     {
-      sprintf(buf, "%s/groups_%03d", All.OutputDir, num);
+      sprintf(buf, "%s/groups_%03d", outdir, num);
       mkdir(buf, 02755);
     }
   MPI_Barrier(MPI_COMM_WORLD);
@@ -1291,7 +1295,7 @@ void fof_save_groups(int num)
   for(groupTask = 0; groupTask < nprocgroup; groupTask++)
     {
       if(ThisTask == (masterTask + groupTask))	/* ok, it's this processor's turn */
-	fof_save_local_catalogue(num);
+	fof_save_local_catalogue(num, outdir);
       MPI_Barrier(MPI_COMM_WORLD);	/* wait inside the group */
     }
 
@@ -1303,7 +1307,7 @@ void fof_save_groups(int num)
 
 
 
-void fof_save_local_catalogue(int num)
+void fof_save_local_catalogue(int num, const char *outdir)
 {
   FILE *fd;
   float *mass, *cm, *vel;
@@ -1311,7 +1315,7 @@ void fof_save_local_catalogue(int num)
   int i, j, *len;
   MyIDType *ids;
 
-  sprintf(fname, "%s/groups_%03d/%s_%03d.%d", All.OutputDir, num, "group_tab", num, ThisTask);
+  sprintf(fname, "%s/groups_%03d/%s_%03d.%d", outdir, num, "group_tab", num, ThisTask);
   if(!(fd = fopen(fname, "w")))
     {
       printf("can't open file `%s`\n", fname);
@@ -1409,7 +1413,7 @@ void fof_save_local_catalogue(int num)
   for(i = 0; i < Nids; i++)
     ids[i] = ID_list[i].ID;
 
-  sprintf(fname, "%s/groups_%03d/%s_%03d.%d", All.OutputDir, num, "group_ids", num, ThisTask);
+  sprintf(fname, "%s/groups_%03d/%s_%03d.%d", outdir, num, "group_ids", num, ThisTask);
   if(!(fd = fopen(fname, "w")))
     {
       printf("can't open file `%s`\n", fname);
@@ -2129,6 +2133,18 @@ int fof_compare_Group_MinID(const void *a, const void *b)
   return 0;
 }
 
+unsigned long long fof_key_Group_GrNr(const void *a)
+{
+  return (unsigned long long) ((long long) ((group_properties *) a)->GrNr + 2147483648LL); /* shifted so the order of negative values is kept */
+}
+
+#ifndef LONGIDS
+unsigned long long fof_key_ID_list_GrNrID(const void *a)
+{
+  return (((unsigned long long) ((fof_id_list *) a)->GrNr) << 32) | ((unsigned long long) ((fof_id_list *) a)->ID);
+}
+#endif
+
 int fof_compare_Group_GrNr(const void *a, const void *b)
 {
   if(((group_properties *) a)->GrNr < ((group_properties *) b)->GrNr)
@@ -2729,7 +2745,7 @@ void read_fof(int num)
 
   /* restore peano-hilbert order */
   qsort(P, NumPart, sizeof(struct particle_data), fof_compare_P_SubNr);
-  subfind(num);
+  subfind(num, All.OutputDir);
   endrun(0);
 
 }
@@ -18,6 +18,10 @@ int fof_compare_FOF_GList_MinIDTask_MinID(const void *a, const void *b);
 int fof_compare_FOF_GList_LocCountTaskDiffMinID(const void *a, const void *b);
 int fof_compare_FOF_GList_ExtCountMinID(const void *a, const void *b);
 int fof_compare_Group_GrNr(const void *a, const void *b);
+unsigned long long fof_key_Group_GrNr(const void *a);
+#ifndef LONGIDS
+unsigned long long fof_key_ID_list_GrNrID(const void *a);
+#endif
 int fof_compare_Group_MinIDTask(const void *a, const void *b);
 int fof_compare_Group_MinID(const void *a, const void *b);
 int fof_compare_ID_list_GrNrID(const void *a, const void *b);
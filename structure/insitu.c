@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <mpi.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "../allvars.h"
+#include "../proto.h"
+
+/*! \file insitu.c
+ *  \brief in-situ analysis stage, run on the live particle distribution between timesteps
+ *
+ *  Analysis kernels are registered by name in insitu_init() (called once from begrun). Every TimeBetInSitu
+ *  (multiplicative in comoving runs, additive otherwise), insitu_analysis() is called from the main loop at the
+ *  end of a step, drifts all particles to the current time, and calls each registered kernel in turn with a
+ *  running output number. The kernels work on the particle data, domain decomposition, and tree as they are at
+ *  that point -- nothing is written to disk and read back, and no extra domain decomposition or tree build is
+ *  done by this stage itself (kernels which need their own, like the FoF finder, still do so internally). Each
+ *  kernel is responsible for reducing its results over the tasks and writing a compact summary: the gas PDF
+ *  kernel writes small text files into '<OutputDir>/insitu/', and the FoF, power spectrum and two-point kernels
+ *  hand the same directory to the standard writers, which write their usual files there (numbered by the in-situ
+ *  count), so they never overwrite the catalogues made with the snapshots in '<OutputDir>'. To add a kernel, write a function of type
+ *  insitu_kernel_function and register it in insitu_init(); kernels must be called collectively on all tasks.
+ */
+/*
+ * This file was written for GIZMO.
+ */
+
+#ifdef INSITU_ANALYSIS
+
+#define INSITU_MAX_KERNELS 32   /* maximum number of registered analysis kernels */
+#define INSITU_PDF_BINS    64   /* number of bins of the gas density and internal energy distributions */
+
+static struct insitu_kernel_data
+{
+    char Name[40];
+    char ProfileName[48];       /* region name handed to the profiler: this must stay valid for the whole run */
+    insitu_kernel_function Func;
+}
+InSituKernel[INSITU_MAX_KERNELS];
+
+static int NInSituKernels = 0;
+static char InSituOutputDir[sizeof(All.OutputDir)]; /* '<OutputDir>/insitu': all in-situ products are written here (set in insitu_init) */
+
+
+/*! adds the kernel 'func' to the list of kernels called by insitu_analysis() (in order of registration) */
+void insitu_register_kernel(const char *name, insitu_kernel_function func)
+{
+    if(NInSituKernels >= INSITU_MAX_KERNELS) {if(ThisTask == 0) {printf("too many in-situ analysis kernels (INSITU_MAX_KERNELS=%d)\n", INSITU_MAX_KERNELS);} endrun(8720);}
+    strncpy(InSituKernel[NInSituKernels].Name, name, sizeof(InSituKernel[NInSituKernels].Name) - 1);
+    snprintf(InSituKernel[NInSituKernels].ProfileName, sizeof(InSituKernel[NInSituKernels].ProfileName), "insitu_%s", name);
+    InSituKernel[NInSituKernels].Func = func;
+    NInSituKernels++;
+}
+
+
+/*! mass-weighted distributions of the (physical) gas density and specific internal energy, in logarithmic bins
+ *  spanning the global range of each quantity. Written by task 0 to 'insitu/gas_pdf_<num>.txt' */
+static void insitu_gas_pdf(int num)
+{
+    int i, k, bin; char buf[500]; FILE *fd;
+    double val[2], lmin[2] = {MAX_REAL_NUMBER, MAX_REAL_NUMBER}, lmax[2] = {-MAX_REAL_NUMBER, -MAX_REAL_NUMBER}, gmin[2], gmax[2], mtot_loc = 0, mtot;
+    double hist_loc[2 * INSITU_PDF_BINS], hist[2 * INSITU_PDF_BINS], dbin[2];
+    long long ngas;
+
+    for(i = 0; i < N_gas; i++)
+    {
+        if(P[i].Type != 0 || P[i].Mass <= 0 || SphP[i].Density <= 0 || SphP[i].InternalEnergy <= 0) {continue;}
+        val[0] = log10(SphP[i].Density * All.cf_a3inv); val[1] = log10(SphP[i].InternalEnergy);
+        for(k = 0; k < 2; k++) {if(val[k] < lmin[k]) {lmin[k] = val[k];} if(val[k] > lmax[k]) {lmax[k] = val[k];}}
+    }
+    MPI_Allreduce(lmin, gmin, 2, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+    MPI_Allreduce(lmax, gmax, 2, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    if(gmax[0] < gmin[0]) {return;} /* no gas with valid density and energy anywhere */
+    for(k = 0; k < 2; k++) {if(gmax[k] <= gmin[k]) {gmin[k] -= 0.5; gmax[k] += 0.5;} dbin[k] = (gmax[k] - gmin[k]) / INSITU_PDF_BINS;}
+
+    memset(hist_loc, 0, 2 * INSITU_PDF_BINS * sizeof(double));
+    for(i = 0; i < N_gas; i++)
+    {
+        if(P[i].Type != 0 || P[i].Mass <= 0 || SphP[i].Density <= 0 || SphP[i].InternalEnergy <= 0) {continue;}
+        val[0] = log10(SphP[i].Density * All.cf_a3inv); val[1] = log10(SphP[i].InternalEnergy);
+        for(k = 0; k < 2; k++)
+        {
+            bin = (int) ((val[k] - gmin[k]) / dbin[k]);
+            if(bin < 0) {bin = 0;}
+            if(bin >= INSITU_PDF_BINS) {bin = INSITU_PDF_BINS - 1;}
+            hist_loc[k * INSITU_PDF_BINS + bin] += P[i].Mass;
+        }
+        mtot_loc += P[i].Mass;
+    }
+    MPI_Reduce(hist_loc, hist, 2 * INSITU_PDF_BINS, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&mtot_loc, &mtot, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    sumup_large_ints(1, &N_gas, &ngas);
+
+    if(ThisTask == 0)
+    {
+        sprintf(buf, "%s/gas_pdf_%03d.txt", InSituOutputDir, num);
+        if(!(fd = fopen(buf, "w"))) {printf("can't open file `%s`\n", buf); endrun(8721);}
+        fprintf(fd, "# time=%g  N_gas=%lld  M_gas=%g\n", All.Time, ngas, mtot);
+        fprintf(fd, "# log10(rho_phys)  dM/M  log10(u)  dM/M  (bin centers, code units)\n");
+        for(i = 0; i < INSITU_PDF_BINS; i++)
+        {
+            fprintf(fd, "%g %g %g %g\n", gmin[0] + (i + 0.5) * dbin[0], (mtot > 0) ? hist[i] / mtot : 0,
+                    gmin[1] + (i + 0.5) * dbin[1], (mtot > 0) ? hist[INSITU_PDF_BINS + i] / mtot : 0);
+        }
+        fclose(fd);
+    }
+}
+
+
+#ifdef FOF
+/*! friends-of-friends group catalogue of the live particle distribution, written to 'insitu/groups_<num>' */
+static void insitu_fof(int num)
+{
+    fof_fof(num, InSituOutputDir);
+    CPU_Step[CPU_FOF] += measure_time();
+}
+#endif
+
+
+#if defined(OUTPUT_POWERSPEC) && defined(PMGRID) && defined(BOX_PERIODIC)
+/*! matter power spectrum of the live particle distribution, computed on the PM mesh (written to 'insitu/powerspec_<num>.txt') */
+static void insitu_powerspec(int num)
+{
+    int i, n_type[6]; long long ntot_type_all[6];
+    for(i = 0; i < 6; i++) {n_type[i] = 0;}
+    for(i = 0; i < NumPart; i++) {n_type[P[i].Type]++;}
+    sumup_large_ints(6, n_type, ntot_type_all);
+    calculate_power_spectra(num, ntot_type_all, InSituOutputDir);
+}
+#endif
+
+
+#ifdef OUTPUT_TWOPOINT_ENABLED
+/*! two-point mass correlation function, using the current neighbor tree (written to 'insitu/correl_<num>.txt') */
+static void insitu_twopoint(int num)
+{
+    twopoint(num, InSituOutputDir);
+}
+#endif
+
+
+/*! registers the built-in kernels (plus any user kernels added here) and creates the output directory;
+ *  called once from begrun() before the particle data are set up */
+void insitu_init(void)
+{
+    if((All.ComovingIntegrationOn && All.TimeBetInSitu <= 1.0) || (!All.ComovingIntegrationOn && All.TimeBetInSitu <= 0))
+    {
+        if(ThisTask == 0) {printf("TimeBetInSitu=%g is not a valid interval between in-situ analyses (it must be >1 for comoving runs, >0 otherwise)\n", All.TimeBetInSitu);}
+        endrun(8722);
+    }
+    int len = snprintf(InSituOutputDir, sizeof(InSituOutputDir), "%s/insitu", All.OutputDir);
+    if(len < 0 || len >= (int) sizeof(InSituOutputDir))
+    {
+        if(ThisTask == 0) {printf("OutputDir `%s' is too long to hold the in-situ output directory '<OutputDir>/insitu'\n", All.OutputDir);}
+        endrun(8723);
+    }
+    NInSituKernels = 0;
+    insitu_register_kernel("gas_pdf", insitu_gas_pdf);
+#ifdef FOF
+    insitu_register_kernel("fof", insitu_fof);
+#endif
+#if defined(OUTPUT_POWERSPEC) && defined(PMGRID) && defined(BOX_PERIODIC)
+    insitu_register_kernel("powerspec", insitu_powerspec);
+#endif
+#ifdef OUTPUT_TWOPOINT_ENABLED
+    insitu_register_kernel("twopoint", insitu_twopoint);
+#endif
+    if(ThisTask == 0) {mkdir(InSituOutputDir, 02755);}
+    MPI_Barrier(MPI_COMM_WORLD);
+}
+
+
+/*! runs all registered kernels if the next in-situ analysis time has been reached (called by all tasks at the end of a step) */
+void insitu_analysis(void)
+{
+    int i, k, num;
+    if(All.Time < All.TimeNextInSitu || NInSituKernels <= 0) {return;}
+
+    CPU_Step[CPU_MISC] += measure_time();
+    num = All.InSituCount++;
+    PRINT_STATUS("In-situ analysis %d at time %g (%d kernels)", num, All.Time, NInSituKernels);
+    for(i = 0; i < NumPart; i++) {if(P[i].Ti_current != All.Ti_Current) {drift_particle(i, All.Ti_Current);}}
+    for(k = 0; k < NInSituKernels; k++)
+    {
+#ifdef HOT_PATH_PROFILER
+        profile_begin(profile_region_id(InSituKernel[k].ProfileName));
+#endif
+        InSituKernel[k].Func(num);
+#ifdef HOT_PATH_PROFILER
+        profile_end(0, 0, 0, 0, 0);
+#endif
+        CPU_Step[CPU_MISC] += measure_time();
+    }
+
+    if(All.ComovingIntegrationOn) {All.TimeNextInSitu *= All.TimeBetInSitu;} else {All.TimeNextInSitu += All.TimeBetInSitu;}
+    if(All.TimeNextInSitu <= All.Time) /* do not repeat the analysis on the following steps if one interval was shorter than the step */
+    {
+        if(All.ComovingIntegrationOn) {while(All.TimeNextInSitu <= All.Time) {All.TimeNextInSitu *= All.TimeBetInSitu;}}
+        else {All.TimeNextInSitu = All.Time + All.TimeBetInSitu;}
+    }
+}
+
+#endif
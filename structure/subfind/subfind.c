@@ -58,7 +58,7 @@ static struct subfind_id_list
 static int Nids;
 
 
-void subfind(int num)
+void subfind(int num, const char *outdir)
 {
   double t0, t1, tstart, tend;
   int i, gr, nlocid, offset, limit, ncount, ntotingrouplocal, nminingrouplocal, nmaxingrouplocal;
@@ -244,7 +244,7 @@ void subfind(int num)
     {
       /* let's save the densities to a file (for making images) */
       t0 = my_second();
-      subfind_save_densities(num);
+      subfind_save_densities(num, outdir);
       t1 = my_second();
       if(ThisTask == 0)
 	printf("saving densities took %g sec\n", timediff(t0, t1));
@@ -458,7 +458,7 @@ void subfind(int num)
   domain_allocate_trick();
 
   /* now assemble final output */
-  subfind_save_final(num);
+  subfind_save_final(num, outdir);
 
   tend = my_second();
 
@@ -473,7 +473,7 @@ void subfind(int num)
 
 
 
-void subfind_save_final(int num)
+void subfind_save_final(int num, const char *outdir)
 {
   int i, j, totsubs, masterTask, groupTask, nprocgroup;
   char buf[1000];
@@ -484,7 +484,7 @@ void subfind_save_final(int num)
   t0 = my_second();
 
   t0 = my_second();
-  parallel_sort(Group, Ngroups, sizeof(group_properties), fof_compare_Group_GrNr);
+  parallel_sort_radix(Group, Ngroups, sizeof(group_properties), fof_compare_Group_GrNr, fof_key_Group_GrNr);
   t1 = my_second();
   if(ThisTask == 0)
     {
@@ -561,7 +561,7 @@ void subfind_save_final(int num)
 
   if(ThisTask == 0)
     {
-      sprintf(buf, "%s/groups_%03d", All.OutputDir, num);
+      sprintf(buf, "%s/groups_%03d", outdir, num);
       mkdir(buf, 02755);
     }
   MPI_Barrier(MPI_COMM_WORLD);
@@ -583,7 +583,7 @@ void subfind_save_final(int num)
   for(groupTask = 0; groupTask < nprocgroup; groupTask++)
     {
       if(ThisTask == (masterTask + groupTask))	/* ok, it's this processor's turn */
-	subfind_save_local_catalogue(num);
+	subfind_save_local_catalogue(num, outdir);
       MPI_Barrier(MPI_COMM_WORLD);	/* wait inside the group */
     }
 
@@ -1083,7 +1083,7 @@ int block_in_sub(enum siofields blocknr)
 }
 
 
-void subfind_save_local_catalogue(int num)
+void subfind_save_local_catalogue(int num, const char *outdir)
 {
   FILE *fd;
   char buf[500], fname[500], label[] = "--------";
@@ -1113,11 +1113,11 @@ void subfind_save_local_catalogue(int num)
 
 #ifdef SUBFIND_WRITE_OUTPUTS_IN_SNAPSHOT_FORMAT
   if(NTask == 1)
-    sprintf(fname, "%s/groups_%03d/%s_%03d", All.OutputDir, num, "sub", num);
+    sprintf(fname, "%s/groups_%03d/%s_%03d", outdir, num, "sub", num);
   else
-    sprintf(fname, "%s/groups_%03d/%s_%03d.%d", All.OutputDir, num, "sub", num, ThisTask);
+    sprintf(fname, "%s/groups_%03d/%s_%03d.%d", outdir, num, "sub", num, ThisTask);
 #else
-  sprintf(fname, "%s/groups_%03d/%s_%03d.%d", All.OutputDir, num, "subhalo_tab", num, ThisTask);
+  sprintf(fname, "%s/groups_%03d/%s_%03d.%d", outdir, num, "subhalo_tab", num, ThisTask);
 #endif
   strcpy(buf, fname);
 
@@ -1554,7 +1554,7 @@ void subfind_save_local_catalogue(int num)
 	    case SIO_PPOS:
 #ifndef SUBFIND_WRITE_OUTPUTS_IN_SNAPSHOT_FORMAT	/* open new file in case of old format */
 	      fclose(fd);
-	      sprintf(buf, "%s/groups_%03d/%s_%03d.%d", All.OutputDir, num, "subhalo_posvel", num, ThisTask);
+	      sprintf(buf, "%s/groups_%03d/%s_%03d.%d", outdir, num, "subhalo_posvel", num, ThisTask);
 	      if(!(fd = fopen(buf, "w")))
 		{
 		  printf("can't open file `%s`\n", buf);
@@ -1589,7 +1589,7 @@ void subfind_save_local_catalogue(int num)
 	    case SIO_PID:
 #ifndef SUBFIND_WRITE_OUTPUTS_IN_SNAPSHOT_FORMAT	/* open new file in case of old format */
 	      fclose(fd);
-	      sprintf(buf, "%s/groups_%03d/%s_%03d.%d", All.OutputDir, num, "subhalo_ids", num, ThisTask);
+	      sprintf(buf, "%s/groups_%03d/%s_%03d.%d", outdir, num, "subhalo_ids", num, ThisTask);
 	      if(!(fd = fopen(buf, "w")))
 		{
 		  printf("can't open file `%s`\n", buf);
@@ -38,7 +38,7 @@ void subfind_exchange(void);
 void subfind_col_save_candidates_task(int totgrouplen, int num);
 void subfind_col_load_candidates(int num);
 
-void subfind(int num);
+void subfind(int num, const char *outdir);
 int Subfind_DensityOtherProps_evaluate(int target, int mode, int *nexport, int *nsend_local);
 int subfind_contamination_treefind(MyDouble *searchcenter, MyFloat hsml, int target, int *startnode,
                                       int mode, int *nexport, int *nsend_local, double *Mass);
@@ -50,14 +50,14 @@ void Subfind_DensityOtherProps_Loop(void);
 int Subfind_RvirMvir_evaluate(int target, int mode, int *nexport, int *nsend_local);
 double subfind_ovderdens_treefind(MyDouble *searchcenter, MyFloat hsml, int target, int *startnode,
 				  int mode, int *nexport, int *nsend_local);
-void subfind_save_densities(int num);
-void subfind_save_local_densities(int num);
+void subfind_save_densities(int num, const char *outdir);
+void subfind_save_local_densities(int num, const char *outdir);
 void subfind_setup_smoothinglengths(int j);
 int subfind_density_evaluate(int target, int mode, int *nexport, int *nsend_local, int tp);
 int subfind_ngb_treefind_linkpairs(MyDouble *searchcenter, double hsml, int target, int *startnode, int mode,
                                  double *hmax, int *nexport, int *nsend_local);
-void subfind_save_local_catalogue(int num);
-void subfind_save_final(int num);
+void subfind_save_local_catalogue(int num, const char *outdir);
+void subfind_save_final(int num, const char *outdir);
 int subfind_linkngb_evaluate(int target, int mode, int *nexport, int *nsend_local);
 int subfind_ngb_treefind_linkngb(MyDouble *searchcenter, double hsml, int target, int *startnode, int mode,
                                  double *hmax, int *nexport, int *nsend_local);
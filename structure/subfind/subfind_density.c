@@ -567,7 +567,7 @@ int subfind_compare_hsml_data(const void *a, const void *b)
 }
 
 
-void subfind_save_densities(int num)
+void subfind_save_densities(int num, const char *outdir)
 {
   int i, nprocgroup, masterTask, groupTask;
   char buf[1000];
@@ -621,7 +621,7 @@ void subfind_save_densities(int num)
 
   if(ThisTask == 0)
     {
-      sprintf(buf, "%s/hsmldir_%03d", All.OutputDir, num);
+      sprintf(buf, "%s/hsmldir_%03d", outdir, num);
       mkdir(buf, 02755);
     }
   MPI_Barrier(MPI_COMM_WORLD);
@@ -640,7 +640,7 @@ void subfind_save_densities(int num)
   for(groupTask = 0; groupTask < nprocgroup; groupTask++)
     {
       if(ThisTask == (masterTask + groupTask))	/* ok, it's this processor's turn */
-	subfind_save_local_densities(num);
+	subfind_save_local_densities(num, outdir);
       MPI_Barrier(MPI_COMM_WORLD);	/* wait inside the group */
     }
 
@@ -648,7 +648,7 @@ void subfind_save_densities(int num)
 
 }
 
-void subfind_save_local_densities(int num)
+void subfind_save_local_densities(int num, const char *outdir)
 {
   char fname[1000];
   int i;
@@ -656,7 +656,7 @@ void subfind_save_local_densities(int num)
   FILE *fd;
 
 
-  sprintf(fname, "%s/hsmldir_%03d/%s_%03d.%d", All.OutputDir, num, "hsml", num, ThisTask);
+  sprintf(fname, "%s/hsmldir_%03d/%s_%03d.%d", outdir, num, "hsml", num, ThisTask);
   if(!(fd = fopen(fname, "w")))
     {
       printf("can't open file `%s`\n", fname);
@@ -58,7 +58,7 @@ static MyFloat *RsList;
 
 /*  This function computes the two-point function.
  */
-void twopoint(void)
+void twopoint(int num, const char *outdir)
 {
     int i, j, k, bin, n, ndone, ndone_flag, dummy, nexport, nimport, place, recvTask, ngrp;
     double p, rs, vol, scaled_frac, tstart, tend, mass, masstot; long long *countbuf; void *state_buffer;
@@ -142,19 +142,19 @@ void twopoint(void)
         if(CountSpheres[i] > 0) {Xi[i] = -1 + Count[i] / ((double) CountSpheres[i]) / (All.TotNumPart / pow(All.BoxSize, 3)) / vol;} else {Xi[i] = 0;}
         Rbin[i] = exp((i + 0.5) / binfac + logR0);
       }
-    twopoint_save();
+    twopoint_save(num, outdir);
     tend = my_second(); PRINT_STATUS(" ..end two-point: Took=%g seconds", timediff(tstart, tend));
 }
 
 
 
 
-void twopoint_save(void)
+void twopoint_save(int num, const char *outdir)
 {
   FILE *fd; char buf[500]; int i;
   if(ThisTask == 0)
     {
-      sprintf(buf, "%s/correl_%03d.txt", All.OutputDir, RestartSnapNum);
+      sprintf(buf, "%s/correl_%03d.txt", outdir, num);
       if(!(fd = fopen(buf, "w"))) {printf("can't open file `%s`\n", buf); endrun(1323);}
       fprintf(fd, "%g\n", All.Time); i = BINS_TP; fprintf(fd, "%d\n", i);
       for(i = 0; i < BINS_TP; i++) {fprintf(fd, "%g %g %g %g\n", Rbin[i], Xi[i], (double) Count[i], (double) CountSpheres[i]);}
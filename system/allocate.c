@@ -45,6 +45,13 @@ void allocate_memory(void)
   NextActiveParticle = (int *) mymalloc("NextActiveParticle", bytes = All.MaxPart * sizeof(int));
   bytes_tot += bytes;
 
+  ActiveParticleList = (int *) mymalloc("ActiveParticleList", bytes = All.MaxPart * sizeof(int));
+  bytes_tot += bytes;
+
+  ThreadDispatchTime = (double *) mymalloc("ThreadDispatchTime", maxThreads * sizeof(double));
+  ThreadDispatchCount = (long long *) mymalloc("ThreadDispatchCount", maxThreads * sizeof(long long));
+  memset(ThreadDispatchTime, 0, maxThreads * sizeof(double)); memset(ThreadDispatchCount, 0, maxThreads * sizeof(long long));
+
   NextInTimeBin = (int *) mymalloc("NextInTimeBin", bytes = All.MaxPart * sizeof(int));
   bytes_tot += bytes;
 
@@ -52,7 +52,7 @@ void MASTER_FUNCTION_NAME(void)
         DataIndexTable = (struct data_index *) mymalloc("DataIndexTable", All.BunchSize * sizeof(struct data_index));
         DataNodeList = (struct data_nodelist *) mymalloc("DataNodeList", All.BunchSize * sizeof(struct data_nodelist));
         
-        NextParticle = FirstActiveParticle;    /* begin the main loop; start with this index */
+        build_active_particle_list();    /* begin the main loop; start with this index */
         do /* do local particles and prepare export list */
         {
             BufferFullFlag = 0; Nexport = 0; save_NextParticle = NextParticle;
@@ -72,13 +72,7 @@ void MASTER_FUNCTION_NAME(void)
             tend = my_second(); timecomp1 += timediff(tstart, tend);
             if(BufferFullFlag)
             {
-                int last_nextparticle = NextParticle; NextParticle = save_NextParticle;
-                while(NextParticle >= 0)
-                {
-                    if(NextParticle == last_nextparticle) {break;}
-                    if(ProcessedFlag[NextParticle] != 1) {break;}
-                    ProcessedFlag[NextParticle] = 2; NextParticle = NextActiveParticle[NextParticle];
-                }
+                rewind_active_particle_list(save_NextParticle); /* figure out where we are */
                 if(NextParticle == save_NextParticle) {endrun(123708);} /* in this case, the buffer is too small to process even a single particle */
                 int new_export = 0;
                 for(j = 0, k = 0; j < Nexport; j++)
@@ -155,7 +149,7 @@ void MASTER_FUNCTION_NAME(void)
                 SECONDARY_SUBFUN_NAME(&mainthreadid, loop_iteration);
             }
             tend = my_second(); timecomp2 += timediff(tstart, tend);
-            if(NextParticle < 0) {ndone_flag = 1;} else {ndone_flag = 0;}
+            if(NextParticle >= ActiveParticleListLength) {ndone_flag = 1;} else {ndone_flag = 0;}
             tstart = my_second();
             MPI_Allreduce(&ndone_flag, &ndone, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
             tend = my_second(); timewait2 += timediff(tstart, tend);
@@ -6,12 +6,14 @@
    CONDITION_FOR_EVALUATION inserts the clause that actually determines
         whether or not to pass a particle to the main evaluation routine
    EVALUATION_CALL is the actual call, and needs to be written appropriately
+   If DOMAIN_COST_LOOP is defined (one of the DOMAIN_COST_* loop indices), the time spent
+        on each particle is added to its measured cost for the load-balancing (DOMAIN_MULTICONSTRAINT)
  */
 #if !defined(CONDITION_FOR_EVALUATION) || !defined(EVALUATION_CALL)
 printf("Cannot compile the primary sub-loop without both CONDITION_FOR_EVALUATION and EVALUATION_CALL defined. Exiting. \n"); fflush(stdout); exit(995533);
 #endif
 /* variable assignment */
-int i, j, *exportflag, *exportnodecount, *exportindex, *ngblist, thread_id = *(int *) p;
+int i, j, k, *exportflag, *exportnodecount, *exportindex, *ngblist, thread_id = *(int *) p, n_evaluated = 0; double t_thread_start = my_second();
 /* define the pointers needed for each thread to speak back regarding what needs processing */
 ngblist = Ngblist + thread_id * NumPart;
 exportflag = Exportflag + thread_id * NTask;
@@ -19,33 +21,39 @@ exportnodecount = Exportnodecount + thread_id * NTask;
 exportindex = Exportindex + thread_id * NTask;
 /* Note: exportflag is local to each thread */
 for(j = 0; j < NTask; j++) {exportflag[j] = -1;}
-/* now begin the actual loop */
+/* now begin the actual loop: each thread claims a chunk of the flattened active list by atomically advancing NextParticle (no critical section needed) */
 while(1)
 {
-    int exitFlag = 0;
+    int exitFlag = 0, chunk_start, chunk_end;
+    if(BufferFullFlag != 0) {break;}
     LOCK_NEXPORT;
 #ifdef _OPENMP
-#pragma omp critical(_nexport_)
+#pragma omp atomic capture
 #endif
+    {chunk_start = NextParticle; NextParticle += ActiveParticleChunkSize;}
+    UNLOCK_NEXPORT;
+    if(chunk_start >= ActiveParticleListLength) {break;}
+    chunk_end = chunk_start + ActiveParticleChunkSize; if(chunk_end > ActiveParticleListLength) {chunk_end = ActiveParticleListLength;}
+    for(k = chunk_start; k < chunk_end; k++) {ProcessedFlag[ActiveParticleList[k]] = 0;} /* claimed, but not yet finished */
+    for(k = chunk_start; k < chunk_end; k++)
     {
-        if(BufferFullFlag != 0 || NextParticle < 0)
-        {
-            exitFlag = 1;
-        }
-        else
+        if(BufferFullFlag != 0) {exitFlag = 1; break;} /* another thread filled the buffer: anything after this would be re-done anyways */
+        i = ActiveParticleList[k];
+        CONDITION_FOR_EVALUATION
         {
-            i = NextParticle;
-            ProcessedFlag[i] = 0;
-            NextParticle = NextActiveParticle[NextParticle];
+#if defined(DOMAIN_MULTICONSTRAINT) && defined(DOMAIN_COST_LOOP)
+            double t_evaluation_start = my_second();
+#endif
+            if(EVALUATION_CALL < 0) {exitFlag = 1; break;} // export buffer has filled up //
+#if defined(DOMAIN_MULTICONSTRAINT) && defined(DOMAIN_COST_LOOP)
+            P[i].MeasuredCost[DOMAIN_COST_LOOP] += timediff(t_evaluation_start, my_second());
+#endif
+            n_evaluated++;
         }
+        ProcessedFlag[i] = 1; /* particle successfully finished */
     }
-    UNLOCK_NEXPORT;
     if(exitFlag) {break;}
-    CONDITION_FOR_EVALUATION
-    {
-        if(EVALUATION_CALL < 0) {break;} // export buffer has filled up //
-    }
-    ProcessedFlag[i] = 1; /* particle successfully finished */
 }
+ThreadDispatchCount[thread_id] += n_evaluated; ThreadDispatchTime[thread_id] += timediff(t_thread_start, my_second()); /* record the per-thread work for the imbalance monitor */
 /* loop completed successfully */
 return NULL;
@@ -7,21 +7,27 @@
 #if !defined(EVALUATION_CALL)
 printf("Cannot compile the secondary sub-loop without EVALUATION_CALL defined. Exiting. \n"); fflush(stdout); exit(995534);
 #endif
-int j, dummy, *ngblist, thread_id = *(int *) p;
+int j, dummy, *ngblist, thread_id = *(int *) p, n_evaluated = 0, chunk_size = Nimport / (ACTIVE_LIST_CHUNKS_PER_THREAD * maxThreads); double t_thread_start = my_second();
 ngblist = Ngblist + thread_id * NumPart;
+if(chunk_size > ACTIVE_LIST_MAX_CHUNK) {chunk_size = ACTIVE_LIST_MAX_CHUNK;}
+if(chunk_size < 1) {chunk_size = 1;}
 while(1)
 {
+    int chunk_start, chunk_end;
     LOCK_NEXPORT;
 #ifdef _OPENMP
-#pragma omp critical(_nexport_)
+#pragma omp atomic capture
 #endif
+    {chunk_start = NextJ; NextJ += chunk_size;} /* claim a chunk of the imported elements */
+    UNLOCK_NEXPORT;
+    if(chunk_start >= Nimport) {break;}
+    chunk_end = chunk_start + chunk_size; if(chunk_end > Nimport) {chunk_end = Nimport;}
+    for(j = chunk_start; j < chunk_end; j++)
     {
-        j = NextJ;
-        NextJ++;
+        EVALUATION_CALL
+        n_evaluated++;
     }
-    UNLOCK_NEXPORT;
-    if(j >= Nimport) {break;}
-    EVALUATION_CALL
 }
+ThreadDispatchCount[thread_id] += n_evaluated; ThreadDispatchTime[thread_id] += timediff(t_thread_start, my_second()); /* record the per-thread work for the imbalance monitor */
 /* loop completed successfully */
 return NULL;
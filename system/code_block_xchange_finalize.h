@@ -20,6 +20,7 @@ static inline void *SECONDARY_SUBFUN_NAME(void *p, int loop_iteration)
 }
 
 #undef CONDITIONFUNCTION_FOR_EVALUATION
+#undef DOMAIN_COST_LOOP
 #undef SECONDARY_SUBFUN_NAME
 #undef PRIMARY_SUBFUN_NAME
 #undef OUTPUTFUNCTION_NAME
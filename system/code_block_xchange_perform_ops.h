@@ -2,10 +2,17 @@
 be copy-pasted and can be generically optimized in a single place */
 {
     int j, k, ndone, ndone_flag, recvTask, place, save_NextParticle; long long n_exported = 0; double tstart, tend; /* define some variables used only below */
-    NextParticle = FirstActiveParticle;    /* begin the main loop; start with this index */
+#ifdef HOT_PATH_PROFILER
+    long long n_rounds = 0; double timecomm_start = timecomm, timewait_start = timewait; /* for the per-loop profile */
+    PROFILE_BEGIN(MACRO_NAME_STRINGIFY(MASTER_FUNCTION_NAME));
+#endif
+    build_active_particle_list();    /* begin the main loop; start with this index */
     do /* primary point-element loop */
     {
         BufferFullFlag = 0; Nexport = 0; save_NextParticle = NextParticle; tstart = my_second();
+#ifdef HOT_PATH_PROFILER
+        n_rounds++;
+#endif
         for(j = 0; j < NTask; j++) {Send_count[j] = 0; Exportflag[j] = -1;} /* do local particles and prepare export list */
 #ifdef _OPENMP
 #pragma omp parallel
@@ -21,13 +28,7 @@ be copy-pasted and can be generically optimized in a single place */
         tend = my_second(); timecomp += timediff(tstart, tend);
         if(BufferFullFlag) /* we've filled the buffer or reached the end of the list, prepare for communications */
         {
-            int last_nextparticle = NextParticle; NextParticle = save_NextParticle; /* figure out where we are */
-            while(NextParticle >= 0)
-            {
-                if(NextParticle == last_nextparticle) {break;}
-                if(ProcessedFlag[NextParticle] != 1) {break;}
-                ProcessedFlag[NextParticle] = 2; NextParticle = NextActiveParticle[NextParticle];
-            }
+            rewind_active_particle_list(save_NextParticle); /* figure out where we are */
             if(NextParticle == save_NextParticle) {endrun(113312);} /* in this case, the buffer is too small to process even a single particle */
             
             int new_export = 0; /* actually calculate exports [so we can tell other tasks] */
@@ -54,7 +55,11 @@ be copy-pasted and can be generically optimized in a single place */
         for(j = 0; j < Nexport; j++) {Send_count[DataIndexTable[j].Task]++;}
         MYSORT_DATAINDEX(DataIndexTable, Nexport, sizeof(struct data_index), data_index_compare); /* construct export count tables */
         tstart = my_second();
+#ifdef SPARSE_NEIGHBOR_EXCHANGE
+        mpi_sparse_exchange_counts(Send_count, Recv_count); /* tell only the tasks we export to about our counts */
+#else
         MPI_Alltoall(Send_count, 1, MPI_INT, Recv_count, 1, MPI_INT, MPI_COMM_WORLD); /* broadcast import/export counts */
+#endif
         tend = my_second(); timewait += timediff(tstart, tend);
 
         for(j = 0, Send_offset[0] = 0; j < NTask; j++) {if(j > 0) {Send_offset[j] = Send_offset[j - 1] + Send_count[j - 1];}} /* calculate export table offsets */
@@ -92,6 +97,71 @@ be copy-pasted and can be generically optimized in a single place */
             DATAGET_NAME = (struct INPUT_STRUCT_NAME *) mymalloc("DATAGET_NAME", Nimport * sizeof(struct INPUT_STRUCT_NAME));
             DATARESULT_NAME = (struct OUTPUT_STRUCT_NAME *) mymalloc("DATARESULT_NAME", Nimport * sizeof(struct OUTPUT_STRUCT_NAME));
 
+#ifdef NONBLOCKING_NEIGHBOR_EXCHANGE
+            /* post all receives and sends at once, then evaluate the elements of each task as soon as they arrive, and send their results back
+                right away, while the remaining messages are still in flight (instead of the pairwise-blocking exchange below) */
+            MPI_Request *requests_get = (MPI_Request *) mymalloc("requests_get", 4 * NTask * sizeof(MPI_Request)), *requests_in = requests_get + NTask, *requests_result = requests_get + 2*NTask, *requests_out = requests_get + 3*NTask;
+            int *request_task = (int *) mymalloc("request_task", NTask * sizeof(int)), n_get = 0, n_in = 0, n_result = 0, n_out = 0, n_arrived;
+            tstart = my_second(); Nimport = 0;
+            for(ngrp = ngrp_initial; ngrp < ngrp_initial + N_chunks_for_import; ngrp++)
+            {
+                recvTask = ThisTask ^ ngrp;
+                if(recvTask < NTask)
+                {
+                    Recv_offset[recvTask] = Nimport;
+                    if(Recv_count[recvTask] > 0)
+                    {
+                        request_task[n_get] = recvTask;
+                        MPI_Irecv(&DATAGET_NAME[Nimport], Recv_count[recvTask] * sizeof(struct INPUT_STRUCT_NAME), MPI_BYTE, recvTask, TAG_MPI_GENERIC_COM_BUFFER_A, MPI_COMM_WORLD, &requests_get[n_get++]);
+                        Nimport += Recv_count[recvTask];
+                    }
+                    if(Send_count[recvTask] > 0)
+                    {
+                        MPI_Irecv(&DATAOUT_NAME[Send_offset[recvTask]], Send_count[recvTask] * sizeof(struct OUTPUT_STRUCT_NAME), MPI_BYTE, recvTask, TAG_MPI_GENERIC_COM_BUFFER_B, MPI_COMM_WORLD, &requests_out[n_out++]);
+                        MPI_Isend(&DATAIN_NAME[Send_offset[recvTask]], Send_count[recvTask] * sizeof(struct INPUT_STRUCT_NAME), MPI_BYTE, recvTask, TAG_MPI_GENERIC_COM_BUFFER_A, MPI_COMM_WORLD, &requests_in[n_in++]);
+                    }
+                }
+            }
+            long Nimport_chunk = Nimport;
+            tend = my_second(); timecomm += timediff(tstart, tend);
+            
+            for(n_arrived = 0; n_arrived < n_get; n_arrived++)
+            {
+                int index;
+                tstart = my_second();
+                MPI_Waitany(n_get, requests_get, &index, MPI_STATUS_IGNORE);
+                recvTask = request_task[index];
+                tend = my_second(); timewait += timediff(tstart, tend);
+                
+                /* do the elements which were sent to us by this task: the secondary loop runs from NextJ up to Nimport */
+                tstart = my_second(); NextJ = Recv_offset[recvTask]; Nimport = Recv_offset[recvTask] + Recv_count[recvTask];
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+                {
+#ifdef _OPENMP
+                    int mainthreadid = omp_get_thread_num();
+#else
+                    int mainthreadid = 0;
+#endif
+                    SECONDARY_SUBFUN_NAME(&mainthreadid, loop_iteration);
+                }
+                tend = my_second(); timecomp += timediff(tstart, tend);
+                
+                tstart = my_second();
+                MPI_Isend(&DATARESULT_NAME[Recv_offset[recvTask]], Recv_count[recvTask] * sizeof(struct OUTPUT_STRUCT_NAME), MPI_BYTE, recvTask, TAG_MPI_GENERIC_COM_BUFFER_B, MPI_COMM_WORLD, &requests_result[n_result++]);
+                tend = my_second(); timecomm += timediff(tstart, tend);
+            }
+            Nimport = Nimport_chunk;
+            
+            tstart = my_second(); /* wait for our own results to come back, and for all the sends to complete before the buffers are released */
+            MPI_Waitall(n_out, requests_out, MPI_STATUSES_IGNORE);
+            MPI_Waitall(n_in, requests_in, MPI_STATUSES_IGNORE);
+            MPI_Waitall(n_result, requests_result, MPI_STATUSES_IGNORE);
+            tend = my_second(); timewait += timediff(tstart, tend);
+            myfree(request_task); myfree(requests_get);
+            myfree(DATARESULT_NAME); myfree(DATAGET_NAME); /* free the structures used to send data back to tasks, its sent */
+#else
             tstart = my_second(); Nimport = 0; /* reset because this will be cycled below to calculate the recieve offsets (Recv_offset) */
             for(ngrp = ngrp_initial; ngrp < ngrp_initial + N_chunks_for_import; ngrp++) /* exchange particle data */
             {
@@ -141,6 +211,7 @@ be copy-pasted and can be generically optimized in a single place */
             }
             tend = my_second(); timecomm += timediff(tstart, tend);
             myfree(DATARESULT_NAME); myfree(DATAGET_NAME); /* free the structures used to send data back to tasks, its sent */
+#endif
             
         } /* close the sub-chunking loop: for(ngrp_initial = 1; ngrp_initial < (1 << PTask); ngrp_initial += N_chunks_for_import) */
 
@@ -154,13 +225,14 @@ be copy-pasted and can be generically optimized in a single place */
         tend = my_second(); timecomp += timediff(tstart, tend);
         myfree(DATAOUT_NAME); myfree(DATAIN_NAME); /* free the structures used to prepare our initial export data, we're done here! */
         
-        if(NextParticle < 0) {ndone_flag = 1;} else {ndone_flag = 0;} /* figure out if we are done with the particular active set here */
+        if(NextParticle >= ActiveParticleListLength) {ndone_flag = 1;} else {ndone_flag = 0;} /* figure out if we are done with the particular active set here */
         tstart = my_second();
         MPI_Allreduce(&ndone_flag, &ndone, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD); /* call an allreduce to figure out if all tasks are also done here, otherwise we need to iterate */
         tend = my_second(); timewait += timediff(tstart, tend);
     }
     while(ndone < NTask);
     timeall = timediff(t0, tend);
+    PROFILE_END(n_exported, n_rounds, 0, timecomm - timecomm_start, timewait - timewait_start);
     
 } /* closes clause, so variables don't 'leak' */
 
@@ -44,6 +44,51 @@ int mpi_calculate_offsets(int *send_count, int *send_offset, int *recv_count, in
 }
 
 
+#ifdef SPARSE_NEIGHBOR_EXCHANGE
+/** Sparse replacement for MPI_Alltoall(send_count, 1, MPI_INT, recv_count, 1, MPI_INT, MPI_COMM_WORLD),
+    using the 'non-blocking consensus' (NBX) algorithm: every task only sends its (non-zero) counts to the
+    tasks it actually exports to, with synchronous sends, and keeps receiving counts from any task until a
+    non-blocking barrier (entered once all of its own sends were matched) has completed. The cost then
+    scales with the number of true communication partners, not with NTask. Tasks we receive nothing from
+    get recv_count=0.
+
+    Since messages are matched by tag, two successive calls must be separated by some collective operation
+    (in the neighbor loops, the MPI_Allreduce calls of the import sub-chunking take care of this). */
+void mpi_sparse_exchange_counts(int *send_count, int *recv_count)
+{
+  int j, n_requests = 0, flag, done = 0, barrier_active = 0;
+  MPI_Request *requests = (MPI_Request *) mymalloc("requests", NTask * sizeof(MPI_Request)), barrier_request;
+  MPI_Status status;
+
+  for(j = 0; j < NTask; j++) {recv_count[j] = 0;}
+  recv_count[ThisTask] = send_count[ThisTask];
+  for(j = 0; j < NTask; j++)
+    if(j != ThisTask && send_count[j] > 0)
+      MPI_Issend(&send_count[j], 1, MPI_INT, j, TAG_SPARSE_COUNTS, MPI_COMM_WORLD, &requests[n_requests++]);
+
+  while(!done)
+    {
+      MPI_Iprobe(MPI_ANY_SOURCE, TAG_SPARSE_COUNTS, MPI_COMM_WORLD, &flag, &status);
+      if(flag)
+        MPI_Recv(&recv_count[status.MPI_SOURCE], 1, MPI_INT, status.MPI_SOURCE, TAG_SPARSE_COUNTS, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+      if(barrier_active)
+        MPI_Test(&barrier_request, &done, MPI_STATUS_IGNORE);
+      else
+        {
+          MPI_Testall(n_requests, requests, &flag, MPI_STATUSES_IGNORE);
+          if(flag) /* all of our counts were received: signal this, and keep listening until everyone did the same */
+            {
+              MPI_Ibarrier(MPI_COMM_WORLD, &barrier_request);
+              barrier_active = 1;
+            }
+        }
+    }
+  myfree(requests);
+}
+#endif
+
+
 /** Compare function used to sort an array of int pointers into order
     of the pointer targets. */
 int intpointer_compare(const void *a, const void *b)
@@ -41,6 +41,10 @@ else
 #endif
         if(mode == 1) {endrun(123128);}
         
+#ifdef NGB_LIST_CACHE
+        if(NgbListCache.Length && target >= 0 && target < N_gas) {NgbListCache.Length[target] = -2;} /* this search reaches other tasks, so its local list cannot replace the walk */
+#endif
+        
         if(target >= 0)	/* if no target is given, export will not occur */
         {
             if(exportflag[task = DomainTask[no - (maxPart + maxNodes)]] != target)
@@ -89,12 +93,16 @@ else
         continue;
     }
     
+#ifdef NGB_COMPACT_TREE_NODES
+    current = &NgbNodes[no];
+#else
     current = &Nodes[no];
+#endif
     
 #ifndef DONOTUSENODELIST
     if(mode == 1)
     {
-        if(current->u.d.bitflags & (1 << BITFLAG_TOPLEVEL))	/* we reached a top-level node again, which means that we are done with the branch */
+        if(Nodes[no].u.d.bitflags & (1 << BITFLAG_TOPLEVEL))	/* we reached a top-level node again, which means that we are done with the branch */
         {
             *startnode = -1;
 #ifndef REDUCE_TREEWALK_BRANCHING
@@ -116,6 +124,13 @@ else
         UNLOCK_PARTNODEDRIFT;
     }
     
+#ifdef NGB_COMPACT_TREE_NODES
+    if(current->len < 0) /* single-particle node with mass: open cell */
+    {
+        no = current->u.d.nextnode;
+        continue;
+    }
+#else
     if(!(current->u.d.bitflags & (1 << BITFLAG_MULTIPLEPARTICLES)))
     {
         if(current->u.d.mass)	/* open cell */
@@ -124,9 +139,14 @@ else
             continue;
         }
     }
+#endif
     
 #if (SEARCHBOTHWAYS==1)
+#ifdef NGB_COMPACT_TREE_NODES
+    dist = DMAX(current->hmax, hsml) + 0.5 * current->len;
+#else
     dist = DMAX(Extnodes[no].hmax, hsml) + 0.5 * current->len;
+#endif
 #else
     dist = hsml + 0.5 * current->len;
 #endif
@@ -60,11 +60,15 @@ else
         continue;
     }
     
+#ifdef NGB_COMPACT_TREE_NODES
+    current = &NgbNodes[no];
+#else
     current = &Nodes[no];
+#endif
     
     if(mode == 1)
     {
-        if(current->u.d.bitflags & (1 << BITFLAG_TOPLEVEL))	/* we reached a top-level node again, which means that we are done with the branch */
+        if(Nodes[no].u.d.bitflags & (1 << BITFLAG_TOPLEVEL))	/* we reached a top-level node again, which means that we are done with the branch */
         {
             *startnode = -1;
 #ifndef REDUCE_TREEWALK_BRANCHING
@@ -77,6 +81,13 @@ else
     
     if(current->Ti_current != ti_Current) {force_drift_node(no, ti_Current);}
     
+#ifdef NGB_COMPACT_TREE_NODES
+    if(current->len < 0) /* single-particle node with mass: open cell */
+    {
+        no = current->u.d.nextnode;
+        continue;
+    }
+#else
     if(!(current->u.d.bitflags & (1 << BITFLAG_MULTIPLEPARTICLES)))
     {
         if(current->u.d.mass)	/* open cell */
@@ -85,9 +96,14 @@ else
             continue;
         }
     }
+#endif
     
 #if (SEARCHBOTHWAYS==1)
+#ifdef NGB_COMPACT_TREE_NODES
+    dist = DMAX(current->hmax, hsml) + 0.5 * current->len;
+#else
     dist = DMAX(Extnodes[no].hmax, hsml) + 0.5 * current->len;
+#endif
 #else
     dist = hsml + 0.5 * current->len;
 #endif
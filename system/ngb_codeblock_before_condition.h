@@ -3,7 +3,11 @@
  (valid particle types checked)
  */
   int numngb, no, p, task;
+#ifdef NGB_COMPACT_TREE_NODES
+  struct NGBNODE *current;
+#else
   struct NODE *current;
+#endif
   // cache some global vars locally for improved compiler alias analysis
   int maxPart = All.MaxPart;
   int maxNodes = MaxNodes;
@@ -21,6 +21,9 @@
 #define TAG_TRANSFER  100
 
 static void serial_sort(char *base, size_t nmemb, size_t size, int (*compar) (const void *, const void *));
+static void local_sort(char *base, size_t nmemb, size_t size, int (*compar) (const void *, const void *), radix_key_function getkey);
+static void parallel_sort_comm_keyed(void *base, size_t nmemb, size_t size, int (*compar) (const void *, const void *),
+                                     radix_key_function getkey, MPI_Comm comm);
 static void msort_serial_with_tmp(char *base, size_t n, size_t s, int (*compar) (const void *, const void *),
 				  char *t);
 static void get_local_rank(char *element,
@@ -38,6 +41,20 @@ void parallel_sort(void *base, size_t nmemb, size_t size, int (*compar) (const v
 }
 
 void parallel_sort_comm(void *base, size_t nmemb, size_t size, int (*compar) (const void *, const void *), MPI_Comm comm)
+{
+  parallel_sort_comm_keyed(base, nmemb, size, compar, NULL, comm);
+}
+
+/*! as parallel_sort(), for elements whose order (as given by compar) is the order of the unsigned integer key returned
+ *  by getkey(): the local sorts before and after the exchange are then radix sorts (with RADIX_SORT), and compar is
+ *  only used to find the splitting elements between the tasks */
+void parallel_sort_radix(void *base, size_t nmemb, size_t size, int (*compar) (const void *, const void *), radix_key_function getkey)
+{
+  parallel_sort_comm_keyed(base, nmemb, size, compar, getkey, MPI_COMM_WORLD);
+}
+
+static void parallel_sort_comm_keyed(void *base, size_t nmemb, size_t size, int (*compar) (const void *, const void *),
+                                     radix_key_function getkey, MPI_Comm comm)
 {
   int i, j, max_task, ranks_not_found, Local_ThisTask, Local_NTask, Local_PTask, Color;
   MPI_Comm MPI_CommLocal;
@@ -49,7 +66,7 @@ void parallel_sort_comm(void *base, size_t nmemb, size_t size, int (*compar) (co
   if(nmemb)
     {
       Color = 1;
-      serial_sort((char*)base, nmemb, size, compar);
+      local_sort((char*)base, nmemb, size, compar, getkey);
     }
   else
     Color = 0;
@@ -286,7 +303,7 @@ void parallel_sort_comm(void *base, size_t nmemb, size_t size, int (*compar) (co
 
       memcpy(base, basetmp, nmemb * size);
       myfree(basetmp);
-      serial_sort((char*)base, nmemb, size, compar);
+      local_sort((char*)base, nmemb, size, compar, getkey);
 
 
       myfree(Recv_offset);
@@ -402,6 +419,14 @@ static void get_local_rank(char *element,	/* element of which we want the rank *
     }
 }
 
+static void local_sort(char *base, size_t nmemb, size_t size, int (*compar) (const void *, const void *), radix_key_function getkey)
+{
+#ifdef RADIX_SORT
+  if(getkey) {radix_sort_records(base, nmemb, size, getkey); return;}
+#endif
+  serial_sort(base, nmemb, size, compar);
+}
+
 static void serial_sort(char *base, size_t nmemb, size_t size, int (*compar) (const void *, const void *))
 {
   const size_t storage = nmemb * size;
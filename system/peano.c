@@ -8,6 +8,9 @@
 #include "../proto.h"
 
 #include <gsl/gsl_heapsort.h>
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
 
 
 
@@ -40,7 +43,7 @@ void peano_hilbert_order(void)
 	  mp[i].key = Key[i];
 	}
 
-#ifdef MYSORT
+#if defined(MYSORT) || defined(RADIX_SORT)
       mysort_peano(mp, N_gas, sizeof(struct peano_hilbert_data), peano_compare_key);
 #else
       qsort(mp, N_gas, sizeof(struct peano_hilbert_data), peano_compare_key);
@@ -71,7 +74,7 @@ void peano_hilbert_order(void)
 	  mp[i].key = Key[i];
 	}
 
-#ifdef MYSORT
+#if defined(MYSORT) || defined(RADIX_SORT)
       mysort_peano(mp + N_gas, NumPart - N_gas, sizeof(struct peano_hilbert_data), peano_compare_key);
 #else
       qsort(mp + N_gas, NumPart - N_gas, sizeof(struct peano_hilbert_data), peano_compare_key);
@@ -351,6 +354,95 @@ peanokey peano_and_morton_key(int x, int y, int z, int bits, peanokey * morton_k
 
 
 
+/*  Batched key generation, used for the keys of all particles in the domain decomposition and the tree
+ *  construction. The quantized coordinates of each particle are interleaved into a single 3*bits Morton
+ *  code (with PDEP where the compiler targets BMI2, otherwise with a table of the 8-bit spreads), and the
+ *  Peano-Hilbert key is then walked down from that code two levels at a time, with a table that combines
+ *  two steps of subpix3/rottable3 (48 rotations x 64 two-level pixels). The keys are identical to those
+ *  of peano_hilbert_key() and peano_and_morton_key() for bits=BITS_PER_DIMENSION.
+ */
+#define PEANO_BATCH_SIZE 64   /* number of particles quantized together */
+
+static unsigned int PeanoSpreadTable[256];        /* bit b of the index moved to bit 3*b */
+static unsigned short PeanoTwoLevelTable[48][64]; /* 6 key bits of two levels, plus the rotation after them (<<6) */
+static int PeanoBatchTablesReady = 0;
+
+static void peano_init_batch_tables(void)
+{
+  int i, b, rot, pix;
+  for(i = 0; i < 256; i++)
+    for(b = 0, PeanoSpreadTable[i] = 0; b < 8; b++)
+      if(i & (1 << b))
+        PeanoSpreadTable[i] |= 1u << (3 * b);
+  for(rot = 0; rot < 48; rot++)
+    for(pix = 0; pix < 64; pix++)
+      {
+        int rot1 = rottable3[rot][pix >> 3], rot2 = rottable3[rot1][pix & 7];
+        PeanoTwoLevelTable[rot][pix] = (unsigned short) ((subpix3[rot][pix >> 3] << 3) | subpix3[rot1][pix & 7] | (rot2 << 6));
+      }
+  PeanoBatchTablesReady = 1;
+}
+
+/*! spreads the lowest 21 bits of v onto every third bit */
+static inline peanokey peano_spread_bits(unsigned int v)
+{
+#if defined(__BMI2__)
+  return (peanokey) _pdep_u64(v, 0x1249249249249249ULL);
+#else
+  return ((peanokey) PeanoSpreadTable[v & 255]) | (((peanokey) PeanoSpreadTable[(v >> 8) & 255]) << 24) | (((peanokey) PeanoSpreadTable[(v >> 16) & 31]) << 48);
+#endif
+}
+
+/*! Peano-Hilbert key from the interleaved code (x bit, y bit, z bit from the top of each 3-bit group, as 'pix' in peano_hilbert_key()) */
+static inline peanokey peano_hilbert_key_from_interleaved(peanokey code)
+{
+  int shift = 3 * BITS_PER_DIMENSION, rotation = 0;
+  peanokey key = 0;
+#if (BITS_PER_DIMENSION & 1)
+  shift -= 3; /* odd number of levels: the top one by itself */
+  key = subpix3[0][(code >> shift) & 7];
+  rotation = rottable3[0][(code >> shift) & 7];
+#endif
+  while(shift > 0)
+    {
+      shift -= 6;
+      unsigned short entry = PeanoTwoLevelTable[rotation][(code >> shift) & 63];
+      key = (key << 6) | (entry & 63);
+      rotation = entry >> 6;
+    }
+  return key;
+}
+
+/*! computes the Peano-Hilbert key (and, if morton!=NULL, the Morton key) at BITS_PER_DIMENSION for n particles on
+ *  the current domain grid (DomainCorner, DomainFac): the particles are index[0..n-1], or 0..n-1 if index is NULL.
+ *  The keys are stored at the particle index, key[i] and morton[i]. Must be called from outside threaded regions */
+void peano_hilbert_key_batch(int n, const int *index, peanokey *key, peanokey *morton)
+{
+  int k0;
+  if(!PeanoBatchTablesReady) {peano_init_batch_tables();}
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if(n > 64 * PEANO_BATCH_SIZE)
+#endif
+  for(k0 = 0; k0 < n; k0 += PEANO_BATCH_SIZE)
+    {
+      int j, k, m = (n - k0 < PEANO_BATCH_SIZE) ? n - k0 : PEANO_BATCH_SIZE, idx[PEANO_BATCH_SIZE], q[3][PEANO_BATCH_SIZE];
+      for(k = 0; k < m; k++) {idx[k] = index ? index[k0 + k] : k0 + k;}
+      for(j = 0; j < 3; j++) /* quantization, one coordinate at a time so the loop vectorizes */
+        {
+          double corner = DomainCorner[j], fac = DomainFac;
+          for(k = 0; k < m; k++) {q[j][k] = (int) ((P[idx[k]].Pos[j] - corner) * fac);}
+        }
+      for(k = 0; k < m; k++)
+        {
+          peanokey sx = peano_spread_bits((unsigned int) q[0][k]), sy = peano_spread_bits((unsigned int) q[1][k]), sz = peano_spread_bits((unsigned int) q[2][k]);
+          key[idx[k]] = peano_hilbert_key_from_interleaved((sx << 2) | (sy << 1) | sz);
+          if(morton) {morton[idx[k]] = sx | (sy << 1) | (sz << 2);}
+        }
+    }
+}
+
+
+
 
 static int quadrants[24][2][2][2] = {
   /* rotx=0, roty=0-3 */
@@ -559,6 +651,9 @@ static void msort_peano_with_tmp(struct peano_hilbert_data *b, size_t n, struct
 
 void mysort_peano(void *b, size_t n, size_t s, int (*cmp) (const void *, const void *))
 {
+#ifdef RADIX_SORT
+  radix_sort_peano(b, n, s, cmp); return;
+#endif
   const size_t size = n * s;
 
   struct peano_hilbert_data *tmp =
@@ -0,0 +1,213 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../allvars.h"
+#include "../proto.h"
+
+/*
+ * This file contains a light-weight instrumentation layer for the hot paths of the code (the neighbor loops, gravity,
+ * domain decomposition, tree construction and I/O). Each instrumented region is bracketed by PROFILE_BEGIN/PROFILE_END
+ * (see allvars.h), which accumulate wallclock time, communication and wait time, element/export/interaction counts,
+ * the number of buffer rounds, and the thread imbalance of the threaded loops inside the region. Once per step
+ * (from write_cpu_log) the regions are reduced over all tasks, and written as a single JSON object per line to
+ * 'profile.jsonl' in the output directory, together with the step number, time, and highest active time bin.
+ *
+ * The cost of each region is also attributed to the time bins active in the step, in proportion to their number of
+ * active particles (the work of a step is done for the active particles), and written per bin in the step record.
+ * Task 0 accumulates these shares per time bin over the run, and re-writes the totals after every step to
+ * 'profile_timebins.json', so the cost of the deep time bins can be read off directly.
+ *
+ * Regions are registered by name the first time they are entered. All instrumented regions are collective
+ * (every task passes through them in the same order), so the region tables should agree between tasks: this is
+ * checked every step with a hash of the ordered region names, and the output of the step is skipped if they differ.
+ */
+
+#ifdef HOT_PATH_PROFILER
+
+#define PROFILE_MAX_REGIONS 128  /* maximum number of distinct regions */
+#define PROFILE_MAX_DEPTH   16   /* maximum nesting depth of regions */
+
+enum profile_fields /* quantities accumulated for each region over one step */
+{
+    PROFILE_FIELD_TIME, PROFILE_FIELD_COMM, PROFILE_FIELD_WAIT, PROFILE_FIELD_CALLS, PROFILE_FIELD_ELEMENTS, PROFILE_FIELD_EXPORTS,
+    PROFILE_FIELD_ROUNDS, PROFILE_FIELD_INTERACTIONS, PROFILE_FIELD_THREADMAX, PROFILE_FIELD_THREADSUM, PROFILE_FIELDS
+};
+
+static int NProfileRegions = 0, ProfileDepth = 0;
+static const char *ProfileName[PROFILE_MAX_REGIONS];
+static double ProfileData[PROFILE_MAX_REGIONS][PROFILE_FIELDS];
+static unsigned long long ProfileNameHash = 14695981039346656037ULL; /* FNV-1a hash of the region names, in the order of registration */
+
+static struct profile_timebin_totals /* run totals per time bin (only kept on task 0) */
+{
+    long long Steps;            /* number of steps in which the bin was active */
+    double NActive;             /* summed number of active particles of the bin */
+    double Time[PROFILE_MAX_REGIONS]; /* summed share of the (task-averaged) time of each region */
+}
+ProfileBinTotals[TIMEBINS];
+
+static struct profile_frame /* information kept for each currently open region */
+{
+    int id;
+    int have_threads;           /* 0 if the per-thread counters did not exist yet when the region was opened (reading the initial conditions) */
+    double t_start;
+    long long elements_start;
+    double *thread_time_start;
+}
+ProfileStack[PROFILE_MAX_DEPTH];
+
+static FILE *FdProfile;
+
+
+/*! returns the index of the region 'name', registering it if it was not seen before */
+int profile_region_id(const char *name)
+{
+    int i;
+    for(i = 0; i < NProfileRegions; i++) {if(strcmp(ProfileName[i], name) == 0) {return i;}}
+    if(NProfileRegions >= PROFILE_MAX_REGIONS) {printf("Task=%d: too many profiler regions (PROFILE_MAX_REGIONS=%d)\n", ThisTask, PROFILE_MAX_REGIONS); endrun(8712);}
+    ProfileName[NProfileRegions] = name;
+    for(i = 0; i <= (int) strlen(name); i++) {ProfileNameHash = (ProfileNameHash ^ (unsigned char) name[i]) * 1099511628211ULL;} /* (including the terminating zero) */
+    memset(ProfileData[NProfileRegions], 0, PROFILE_FIELDS * sizeof(double));
+    return NProfileRegions++;
+}
+
+
+/*! opens a region: this must be called from outside of any threaded section */
+void profile_begin(int id)
+{
+    int i; struct profile_frame *f;
+    if(ProfileDepth >= PROFILE_MAX_DEPTH) {printf("Task=%d: profiler regions nested too deeply (entering '%s')\n", ThisTask, ProfileName[id]); endrun(8713);}
+    f = &ProfileStack[ProfileDepth++];
+    if(!f->thread_time_start) {f->thread_time_start = (double *) malloc(maxThreads * sizeof(double));}
+    f->id = id;
+    f->elements_start = 0;
+    f->have_threads = (ThreadDispatchTime != NULL);
+    if(f->have_threads) {for(i = 0; i < maxThreads; i++) {f->thread_time_start[i] = ThreadDispatchTime[i]; f->elements_start += ThreadDispatchCount[i];}}
+    f->t_start = my_second();
+}
+
+
+/*! closes the innermost open region, adding the counts collected by the caller (exported elements, buffer rounds,
+ *  interactions, and the time spent in communication and waiting on other tasks) */
+void profile_end(long long n_exports, long long n_rounds, double n_interactions, double t_comm, double t_wait)
+{
+    int i; long long elements = 0; double tmax = 0, tsum = 0, dt, *d; struct profile_frame *f;
+    if(ProfileDepth <= 0) {printf("Task=%d: profiler region closed which was never opened\n", ThisTask); endrun(8714);}
+    f = &ProfileStack[--ProfileDepth];
+    d = ProfileData[f->id];
+    d[PROFILE_FIELD_TIME] += timediff(f->t_start, my_second());
+    if(f->have_threads)
+    {
+        for(i = 0; i < maxThreads; i++)
+        {
+            elements += ThreadDispatchCount[i];
+            dt = ThreadDispatchTime[i] - f->thread_time_start[i];
+            tsum += dt; if(dt > tmax) {tmax = dt;}
+        }
+        elements -= f->elements_start;
+    }
+    d[PROFILE_FIELD_ELEMENTS] += elements;
+    d[PROFILE_FIELD_THREADMAX] += tmax;
+    d[PROFILE_FIELD_THREADSUM] += tsum;
+    d[PROFILE_FIELD_CALLS] += 1;
+    d[PROFILE_FIELD_EXPORTS] += n_exports;
+    d[PROFILE_FIELD_ROUNDS] += n_rounds;
+    d[PROFILE_FIELD_INTERACTIONS] += n_interactions;
+    d[PROFILE_FIELD_COMM] += t_comm;
+    d[PROFILE_FIELD_WAIT] += t_wait;
+}
+
+
+/*! writes the run totals per time bin to 'profile_timebins.json' (task 0 only; the file is replaced every step) */
+static void profile_write_timebin_totals(void)
+{
+    int b, i, k, first = 1; char buf[500]; FILE *fd;
+    sprintf(buf, "%s%s", All.OutputDir, "profile_timebins.json");
+    if(!(fd = fopen(buf, "w"))) {printf("error in opening file '%s'\n", buf); endrun(1);}
+    fprintf(fd, "{\"step\":%lld,\"time\":%g,\"timebins\":{", (long long) All.NumCurrentTiStep, All.Time);
+    for(b = 0; b < TIMEBINS; b++)
+    {
+        if(ProfileBinTotals[b].Steps <= 0) {continue;}
+        fprintf(fd, "%s\"%d\":{\"steps\":%lld,\"n_active\":%.0f,\"regions\":{", first ? "" : ",", b, ProfileBinTotals[b].Steps, ProfileBinTotals[b].NActive); first = 0;
+        for(i = 0, k = 0; i < NProfileRegions; i++) {if(ProfileBinTotals[b].Time[i] > 0) {fprintf(fd, "%s\"%s\":%g", (k++ > 0) ? "," : "", ProfileName[i], ProfileBinTotals[b].Time[i]);}}
+        fprintf(fd, "}}");
+    }
+    fprintf(fd, "}}\n");
+    fclose(fd);
+}
+
+
+/*! reduces the data of all regions over the tasks and writes one line of JSON for the step (called by all tasks
+ *  from write_cpu_log(), so it has to happen before the per-thread counters used for the imbalance are reset; the
+ *  time bins are still those of the step just completed, since the new time-steps are assigned after this) */
+void profile_write_step(double step_time)
+{
+    int i, k, b, nbin; char mode[2], buf[500];
+    long long check[2] = {NProfileRegions, (long long) ProfileNameHash}, check_min[2], check_max[2];
+    MPI_Allreduce(check, check_min, 2, MPI_LONG_LONG, MPI_MIN, MPI_COMM_WORLD);
+    MPI_Allreduce(check, check_max, 2, MPI_LONG_LONG, MPI_MAX, MPI_COMM_WORLD);
+    if(check_min[0] != check_max[0] || check_min[1] != check_max[1])
+    {
+        if(ThisTask == 0) {PRINT_WARNING("profiler regions differ between tasks (%lld to %lld regions, or registered in a different order): skipping the profile output of this step", check_min[0], check_max[0]);}
+    }
+    else if(NProfileRegions > 0)
+    {
+        int nloc = NProfileRegions * PROFILE_FIELDS + TIMEBINS; /* region data, followed by the number of active particles in each time bin */
+        double *local = (double *) mymalloc("local", 3 * nloc * sizeof(double)), *sum = local + nloc, *max = sum + nloc, *nact = sum + NProfileRegions * PROFILE_FIELDS, nact_tot = 0;
+        for(i = 0; i < NProfileRegions; i++)
+        {
+            for(k = 0; k < PROFILE_FIELDS; k++) {local[i * PROFILE_FIELDS + k] = ProfileData[i][k];}
+            /* per-task thread imbalance (max/mean busy time over the threads), reduced with MPI_MAX below */
+            local[i * PROFILE_FIELDS + PROFILE_FIELD_THREADMAX] = (ProfileData[i][PROFILE_FIELD_THREADSUM] > 0) ? ProfileData[i][PROFILE_FIELD_THREADMAX] * maxThreads / ProfileData[i][PROFILE_FIELD_THREADSUM] : 0;
+        }
+        for(b = 0; b < TIMEBINS; b++) {local[NProfileRegions * PROFILE_FIELDS + b] = TimeBinActive[b] ? TimeBinCount[b] : 0;}
+        MPI_Reduce(local, sum, nloc, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+        MPI_Reduce(local, max, nloc, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        if(ThisTask == 0)
+        {
+            if(!FdProfile)
+            {
+                sprintf(buf, "%s%s", All.OutputDir, "profile.jsonl"); strcpy(mode, (RestartFlag == 1) ? "a" : "w");
+                if(!(FdProfile = fopen(buf, mode))) {printf("error in opening file '%s'\n", buf); endrun(1);}
+            }
+            fprintf(FdProfile, "{\"step\":%lld,\"time\":%g,\"timebin\":%d,\"n_active\":%lld,\"t_step\":%g,\"tasks\":%d,\"threads\":%d,\"regions\":{",
+                    (long long) All.NumCurrentTiStep, All.Time, All.HighestActiveTimeBin, (long long) GlobNumForceUpdate, step_time, NTask, maxThreads);
+            for(i = 0, k = 0; i < NProfileRegions; i++)
+            {
+                double *s = &sum[i * PROFILE_FIELDS], *m = &max[i * PROFILE_FIELDS];
+                if(m[PROFILE_FIELD_CALLS] <= 0) {continue;} /* region not entered during this step */
+                fprintf(FdProfile, "%s\"%s\":{\"calls\":%.0f,\"t_max\":%g,\"t_avg\":%g,\"t_comm_avg\":%g,\"t_wait_avg\":%g,\"elements\":%.0f,\"exports\":%.0f,\"rounds\":%.0f,\"interactions\":%.0f,\"thread_imbalance\":%g}",
+                        (k++ > 0) ? "," : "", ProfileName[i], m[PROFILE_FIELD_CALLS], m[PROFILE_FIELD_TIME], s[PROFILE_FIELD_TIME] / NTask, s[PROFILE_FIELD_COMM] / NTask, s[PROFILE_FIELD_WAIT] / NTask,
+                        s[PROFILE_FIELD_ELEMENTS], s[PROFILE_FIELD_EXPORTS], m[PROFILE_FIELD_ROUNDS], s[PROFILE_FIELD_INTERACTIONS], m[PROFILE_FIELD_THREADMAX]);
+            }
+            /* attribute the task-averaged time of each region to the active time bins, in proportion to their active particles */
+            fprintf(FdProfile, "},\"timebins\":{");
+            for(b = 0; b < TIMEBINS; b++) {nact_tot += nact[b];}
+            for(b = 0, nbin = 0; b < TIMEBINS && nact_tot > 0; b++)
+            {
+                if(nact[b] <= 0) {continue;}
+                double w = nact[b] / nact_tot;
+                ProfileBinTotals[b].Steps++; ProfileBinTotals[b].NActive += nact[b];
+                fprintf(FdProfile, "%s\"%d\":{\"n_active\":%.0f,\"regions\":{", (nbin++ > 0) ? "," : "", b, nact[b]);
+                for(i = 0, k = 0; i < NProfileRegions; i++)
+                {
+                    if(max[i * PROFILE_FIELDS + PROFILE_FIELD_CALLS] <= 0) {continue;}
+                    double t = w * sum[i * PROFILE_FIELDS + PROFILE_FIELD_TIME] / NTask;
+                    ProfileBinTotals[b].Time[i] += t;
+                    fprintf(FdProfile, "%s\"%s\":%g", (k++ > 0) ? "," : "", ProfileName[i], t);
+                }
+                fprintf(FdProfile, "}}");
+            }
+            fprintf(FdProfile, "}}\n");
+            fflush(FdProfile);
+            profile_write_timebin_totals();
+        }
+        myfree(local);
+    }
+    for(i = 0; i < NProfileRegions; i++) {memset(ProfileData[i], 0, PROFILE_FIELDS * sizeof(double));}
+}
+
+#endif
@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <mpi.h>
+
+#include "../allvars.h"
+#include "../proto.h"
+
+/*! \file radix_sort.c
+ *  \brief threaded least-significant-digit radix sorts for the Peano-Hilbert key and export (data-index) tables
+ *
+ *  These replace the comparator-based merge sorts for the tables sorted every step and every buffer round: the
+ *  (key, index) tables of the domain decomposition and the Peano-Hilbert reordering, the DataIndexTable of the
+ *  neighbor and gravity exchanges, and (through parallel_sort_radix) the local sorts of the distributed sample sort
+ *  when the order is given by an unsigned integer key. All sorts are stable. Keys are sorted with 8-bit digits,
+ *  skipping every digit on which all keys agree, so only the significant bits of the keys cost a pass. With OpenMP,
+ *  each pass is split over the threads: every thread histograms its contiguous chunk, the offsets are laid out
+ *  bucket-major over the threads, and every thread scatters its own chunk (which keeps the sort stable).
+ */
+/*
+ * This file was written for GIZMO.
+ */
+
+#ifdef RADIX_SORT
+
+#define RADIX_SORT_BITS       8                         /* bits per digit */
+#define RADIX_SORT_BUCKETS    (1 << RADIX_SORT_BITS)
+#define RADIX_SORT_DIGITS     (64 / RADIX_SORT_BITS)    /* digits of a 64-bit key */
+#ifndef RADIX_SORT_MIN_PER_THREAD
+#define RADIX_SORT_MIN_PER_THREAD 16384                 /* minimum number of elements per thread, below which fewer threads are used */
+#endif
+
+struct radix_sort_data /* same layout as the peano_hilbert_data tables sorted in domain.c and peano.c */
+{
+  peanokey key;
+  int index;
+};
+
+
+/*! sorts the n elements of a by key (stably), using tmp (of the same size) as scratch space */
+static void radix_sort_keys(struct radix_sort_data *a, size_t n, struct radix_sort_data *tmp)
+{
+  int d, k, nthreads = 1, npass = 0, shift[RADIX_SORT_DIGITS];
+  size_t i, *count;
+  peanokey differ = 0;
+  struct radix_sort_data *src = a, *dst = tmp, *swap;
+
+  if(n <= 1) {return;}
+#ifdef _OPENMP
+  nthreads = (int) (n / RADIX_SORT_MIN_PER_THREAD);
+  if(nthreads > maxThreads) {nthreads = maxThreads;}
+  if(nthreads < 1) {nthreads = 1;}
+#endif
+
+  /* the bits in which any key differs from the first: digits without such bits are the same for all keys, and are skipped */
+  for(i = 1; i < n; i++) {differ |= a[i].key ^ a[0].key;}
+  for(d = 0; d < RADIX_SORT_DIGITS; d++) {if((differ >> (d * RADIX_SORT_BITS)) & (RADIX_SORT_BUCKETS - 1)) {shift[npass++] = d * RADIX_SORT_BITS;}}
+  if(npass == 0) {return;}
+
+  count = (size_t *) mymalloc("count", nthreads * RADIX_SORT_BUCKETS * sizeof(size_t));
+
+  for(d = 0; d < npass; d++)
+    {
+      const int s = shift[d];
+      if(nthreads == 1)
+        {
+          size_t *c = count, sum = 0, tmpsum;
+          memset(c, 0, RADIX_SORT_BUCKETS * sizeof(size_t));
+          for(i = 0; i < n; i++) {c[(src[i].key >> s) & (RADIX_SORT_BUCKETS - 1)]++;}
+          for(k = 0; k < RADIX_SORT_BUCKETS; k++) {tmpsum = c[k]; c[k] = sum; sum += tmpsum;}
+          for(i = 0; i < n; i++) {dst[c[(src[i].key >> s) & (RADIX_SORT_BUCKETS - 1)]++] = src[i];}
+        }
+      else
+        {
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nthreads)
+#endif
+          {
+            int tid = 0, nt = 1, b, t; size_t j;
+#ifdef _OPENMP
+            tid = omp_get_thread_num(); nt = omp_get_num_threads(); /* can be fewer than requested, e.g. if called from inside a parallel region */
+#endif
+            size_t *c = count + tid * RADIX_SORT_BUCKETS, first = (n * tid) / nt, last = (n * (tid + 1)) / nt;
+            memset(c, 0, RADIX_SORT_BUCKETS * sizeof(size_t));
+            for(j = first; j < last; j++) {c[(src[j].key >> s) & (RADIX_SORT_BUCKETS - 1)]++;}
+#ifdef _OPENMP
+#pragma omp barrier
+#pragma omp single
+#endif
+            { /* offsets: bucket-major, and within each bucket in the order of the threads' chunks */
+              size_t sum = 0, tmpsum;
+              for(b = 0; b < RADIX_SORT_BUCKETS; b++)
+                for(t = 0; t < nt; t++) {tmpsum = count[t * RADIX_SORT_BUCKETS + b]; count[t * RADIX_SORT_BUCKETS + b] = sum; sum += tmpsum;}
+            } /* (implicit barrier at the end of the single block) */
+            for(j = first; j < last; j++) {dst[c[(src[j].key >> s) & (RADIX_SORT_BUCKETS - 1)]++] = src[j];}
+          }
+        }
+      swap = src; src = dst; dst = swap;
+    }
+
+  if(src != a) {memcpy(a, src, n * sizeof(struct radix_sort_data));}
+  myfree(count);
+}
+
+
+/*! sorts a table of peano_hilbert_data (a peanokey followed by an int index) by key: a drop-in replacement
+ *  for mysort_peano() and mysort_domain() (the comparison function is not used) */
+void radix_sort_peano(void *b, size_t n, size_t s, int (*cmp) (const void *, const void *))
+{
+  if(s != sizeof(struct radix_sort_data)) {printf("radix_sort_peano: element size %d does not match the (key,index) table layout\n", (int) s); endrun(8730);}
+  struct radix_sort_data *tmp = (struct radix_sort_data *) mymalloc("tmp", n * sizeof(struct radix_sort_data));
+  radix_sort_keys((struct radix_sort_data *) b, n, tmp);
+  myfree(tmp);
+}
+
+
+/*! returns the number of bits needed to represent all values 0...x */
+static int radix_sort_bits_for(int x)
+{
+  int bits = 0;
+  while(bits < 31 && (x >> bits) > 0) {bits++;}
+  return bits;
+}
+
+
+/*! sorts the export table (struct data_index) by Task, then Index, then IndexGet, in the same order as
+ *  data_index_compare(): a drop-in replacement for mysort_dataindex()/qsort in MYSORT_DATAINDEX. The three
+ *  (non-negative) fields are packed into a single 64-bit key; if they need more than 64 bits in total,
+ *  the table is sorted with the comparison function instead */
+void radix_sort_dataindex(void *b, size_t n, size_t s, int (*cmp) (const void *, const void *))
+{
+  struct data_index *d = (struct data_index *) b;
+  int maxtask = 0, maxindex = 0, maxget = 0, bits_index, bits_get;
+  size_t i;
+
+  if(n <= 1) {return;}
+  for(i = 0; i < n; i++)
+    {
+      if(d[i].Task > maxtask) {maxtask = d[i].Task;}
+      if(d[i].Index > maxindex) {maxindex = d[i].Index;}
+      if(d[i].IndexGet > maxget) {maxget = d[i].IndexGet;}
+    }
+  bits_index = radix_sort_bits_for(maxindex); bits_get = radix_sort_bits_for(maxget);
+  if(radix_sort_bits_for(maxtask) + bits_index + bits_get > 64) {qsort(b, n, s, cmp); return;}
+
+  struct radix_sort_data *keys = (struct radix_sort_data *) mymalloc("keys", 2 * n * sizeof(struct radix_sort_data));
+  for(i = 0; i < n; i++)
+    {
+      keys[i].key = (((peanokey) d[i].Task) << (bits_index + bits_get)) | (((peanokey) d[i].Index) << bits_get) | ((peanokey) d[i].IndexGet);
+      keys[i].index = 0; /* the key holds the whole element */
+    }
+  radix_sort_keys(keys, n, keys + n);
+  for(i = 0; i < n; i++)
+    {
+      d[i].Task = (int) (keys[i].key >> (bits_index + bits_get));
+      d[i].Index = (int) ((keys[i].key >> bits_get) & ((((peanokey) 1) << bits_index) - 1));
+      d[i].IndexGet = (int) (keys[i].key & ((((peanokey) 1) << bits_get) - 1));
+    }
+  myfree(keys);
+}
+
+
+/*! stably sorts n elements of size s by the unsigned integer key returned by getkey() for each element */
+void radix_sort_records(void *b, size_t n, size_t s, radix_key_function getkey)
+{
+  size_t i;
+  if(n <= 1) {return;}
+  if(n > INT_MAX) {printf("radix_sort_records: too many elements (%lld)\n", (long long) n); endrun(8731);}
+  struct radix_sort_data *keys = (struct radix_sort_data *) mymalloc("keys", 2 * n * sizeof(struct radix_sort_data));
+  for(i = 0; i < n; i++) {keys[i].key = getkey((char *) b + i * s); keys[i].index = (int) i;}
+  radix_sort_keys(keys, n, keys + n);
+  char *sorted = (char *) mymalloc("sorted", n * s);
+  for(i = 0; i < n; i++) {memcpy(sorted + i * s, (char *) b + keys[i].index * s, s);}
+  memcpy(b, sorted, n * s);
+  myfree(sorted);
+  myfree(keys);
+}
+
+#endif
@@ -0,0 +1,108 @@
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../allvars.h"
+#include "../proto.h"
+
+/*! \file shared_tables.c
+ *  \brief read-only lookup tables held once per node, in MPI-3 shared-memory windows
+ *
+ *  Tables which are identical on every task (rate tables computed at start-up, or read from files) are otherwise
+ *  built or read privately by each task, which multiplies their memory and the start-up I/O by the number of tasks
+ *  per node. A table allocated with shared_table_allocate() has a single copy on each node, held by the first task
+ *  of the node (the 'writer'): that task fills it (computing it, or reading it with shared_table_read_file(), so only
+ *  one task per node touches the file system), and after shared_table_sync() all tasks of the node read it directly.
+ *  Tables filled in parts by different tasks can be combined over the nodes with shared_table_leader_comm(). All
+ *  calls here are collective over all tasks.
+ */
+/*
+ * This file was written for GIZMO.
+ */
+
+#if defined(NODE_SHARED_TABLES) || defined(COOL_TABULATED_RATES)
+
+static MPI_Comm SharedTableNodeComm = MPI_COMM_NULL;    /* tasks on the same node */
+static MPI_Comm SharedTableLeaderComm = MPI_COMM_NULL;  /* the writer task of every node (MPI_COMM_NULL on the others) */
+static int SharedTableNodeRank = 0, SharedTableNodeSize = 1;
+
+
+/*! sets up the node communicators (once) */
+static void shared_table_init(void)
+{
+    if(SharedTableNodeComm != MPI_COMM_NULL) {return;}
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, ThisTask, MPI_INFO_NULL, &SharedTableNodeComm);
+    MPI_Comm_rank(SharedTableNodeComm, &SharedTableNodeRank);
+    MPI_Comm_size(SharedTableNodeComm, &SharedTableNodeSize);
+    MPI_Comm_split(MPI_COMM_WORLD, (SharedTableNodeRank == 0) ? 0 : MPI_UNDEFINED, ThisTask, &SharedTableLeaderComm);
+    if(ThisTask == 0) {printf("Shared lookup tables: one copy for the %d tasks of each node (node of task 0).\n", SharedTableNodeSize);}
+}
+
+
+/*! allocates a table of 'bytes' bytes with one copy per node, and returns its address in our address space (the window is
+    returned in *win). the contents are undefined until the writer fills them and shared_table_sync() is called */
+void *shared_table_allocate(const char *name, size_t bytes, MPI_Win *win)
+{
+    void *ptr; MPI_Aint size; int disp_unit;
+    shared_table_init();
+    size = (SharedTableNodeRank == 0) ? (MPI_Aint) bytes : 0; /* only the writer holds the memory */
+    if(MPI_Win_allocate_shared(size, 1, MPI_INFO_NULL, SharedTableNodeComm, &ptr, win) != MPI_SUCCESS)
+        {printf("Task=%d: failed to allocate the shared table '%s' (%g MB)\n", ThisTask, name, bytes / (1024. * 1024.)); endrun(8750);}
+    MPI_Win_shared_query(*win, 0, &size, &disp_unit, &ptr);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, *win); /* passive-target epoch for the lifetime of the table: synchronization is done with barriers + MPI_Win_sync */
+    return ptr;
+}
+
+
+/*! frees a table allocated with shared_table_allocate() */
+void shared_table_free(MPI_Win *win)
+{
+    MPI_Win_unlock_all(*win);
+    MPI_Win_free(win);
+}
+
+
+/*! returns 1 on the task which fills the tables of its node */
+int shared_table_is_writer(void)
+{
+    shared_table_init();
+    return (SharedTableNodeRank == 0);
+}
+
+
+/*! the writers of all nodes (for combining tables which were filled in parts on different nodes), MPI_COMM_NULL on the other tasks */
+MPI_Comm shared_table_leader_comm(void)
+{
+    shared_table_init();
+    return SharedTableLeaderComm;
+}
+
+
+/*! memory barrier over the node: call it after the table is written (by any task of the node), before it is read */
+void shared_table_sync(MPI_Win win)
+{
+    MPI_Win_sync(win); MPI_Barrier(SharedTableNodeComm); MPI_Win_sync(win);
+}
+
+
+/*! the writer of each node reads 'bytes' bytes from the start of the binary file 'fname' into the table, which is then
+    ready to read on all tasks. returns the number of bytes read on the writer of the node of task 0 (so the caller can
+    report short files consistently); if the file cannot be opened at all, the run ends */
+size_t shared_table_read_file(const char *fname, void *table, size_t bytes, MPI_Win win)
+{
+    size_t nread = 0; long long n_ll; int fail = 0, fail_all; FILE *fd;
+    if(shared_table_is_writer())
+    {
+        if(!(fd = fopen(fname, "r"))) {printf("Task=%d: cannot read the table file `%s'\n", ThisTask, fname); fail = 1;}
+        else {nread = fread(table, 1, bytes, fd); fclose(fd);}
+    }
+    MPI_Allreduce(&fail, &fail_all, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    if(fail_all) {endrun(456);}
+    shared_table_sync(win);
+    n_ll = (long long) nread; MPI_Bcast(&n_ll, 1, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+    return (size_t) n_ll;
+}
+
+#endif
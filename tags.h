@@ -107,4 +107,5 @@
 
 #define TAG_MPI_GENERIC_COM_BUFFER_A 103
 #define TAG_MPI_GENERIC_COM_BUFFER_B 104
+#define TAG_SPARSE_COUNTS 105
 
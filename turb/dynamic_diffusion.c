@@ -316,7 +316,7 @@ void dynamic_diff_calc(void) {
     /* prepare to do the requisite number of sweeps over the particle distribution */
     for (dynamic_iteration = 0; dynamic_iteration < (All.TurbDynamicDiffIterations + 1); dynamic_iteration++) {      
         // now we actually begin the main gradient loop //
-        NextParticle = FirstActiveParticle;	/* begin with this index */
+        build_active_particle_list();	/* flatten the active list, and begin with its first element */
         PRINT_STATUS(" ..first loop over active particles (iter = %d)", dynamic_iteration);
 
         do {    
@@ -369,17 +369,7 @@ void dynamic_diff_calc(void) {
             timecomp1 += timediff(tstart, tend);
             
             if (BufferFullFlag) {
-                int last_nextparticle = NextParticle;
-                
-                NextParticle = save_NextParticle;
-                
-                while (NextParticle >= 0) {
-                    if (NextParticle == last_nextparticle) break;
-                    if (ProcessedFlag[NextParticle] != 1) break;
-                    
-                    ProcessedFlag[NextParticle] = 2;
-                    NextParticle = NextActiveParticle[NextParticle];
-                }
+                rewind_active_particle_list(save_NextParticle); /* figure out where we are */
                 
                 if (NextParticle == save_NextParticle) {
                     /* in this case, the buffer is too small to process even a single particle */
@@ -511,7 +501,7 @@ void dynamic_diff_calc(void) {
             tend = my_second();
             timecomp2 += timediff(tstart, tend);
             
-            if (NextParticle < 0) {
+            if (NextParticle >= ActiveParticleListLength) {
                 ndone_flag = 1;
             }
             else {
@@ -1094,72 +1084,19 @@ int DynamicDiff_evaluate(int target, int mode, int *exportflag, int *exportnodec
 
 
 void *DynamicDiff_evaluate_primary(void *p, int dynamic_iteration) {
-    int thread_id = *(int *) p;
-    int i, j;
-    int *exportflag, *exportnodecount, *exportindex, *ngblist;
-    ngblist = Ngblist + thread_id * NumPart;
-    exportflag = Exportflag + thread_id * NTask;
-    exportnodecount = Exportnodecount + thread_id * NTask;
-    exportindex = Exportindex + thread_id * NTask;
-    
-    /* Note: exportflag is local to each thread */
-    for (j = 0; j < NTask; j++) exportflag[j] = -1;
-    
-    while (1) {
-        int exitFlag = 0;
-        LOCK_NEXPORT;
-#ifdef _OPENMP
-#pragma omp critical(_nexport_)
-#endif
-        {
-            if (BufferFullFlag != 0 || NextParticle < 0) {
-                exitFlag = 1;
-            }
-            else {
-                i = NextParticle;
-                ProcessedFlag[i] = 0;
-                NextParticle = NextActiveParticle[NextParticle];
-            }
-        }
-
-        UNLOCK_NEXPORT;
-        if (exitFlag) break;
-        
-        if (P[i].Type == 0) {
-	    if (DynamicDiff_evaluate(i, 0, exportflag, exportnodecount, exportindex, ngblist, dynamic_iteration) < 0) break;		/* export buffer has filled up */
-        }
-
-        ProcessedFlag[i] = 1; /* particle successfully finished */
-    }
-
-    return NULL;
+#define CONDITION_FOR_EVALUATION if(P[i].Type==0)
+#define EVALUATION_CALL DynamicDiff_evaluate(i, 0, exportflag, exportnodecount, exportindex, ngblist, dynamic_iteration)
+#include "../system/code_block_primary_loop_evaluation.h"
+#undef CONDITION_FOR_EVALUATION
+#undef EVALUATION_CALL
 }
 
 
 
 void *DynamicDiff_evaluate_secondary(void *p, int dynamic_iteration) {
-    int thread_id = *(int *) p;
-    int j, dummy, *ngblist;
-    ngblist = Ngblist + thread_id * NumPart;
-
-    while (1) {
-        LOCK_NEXPORT;
-#ifdef _OPENMP
-#pragma omp critical(_nexport_)
-#endif
-        {
-            j = NextJ;
-            NextJ++;
-        }
-
-        UNLOCK_NEXPORT;
-        
-        if (j >= Nimport) break;
-
-        DynamicDiff_evaluate(j, 1, &dummy, &dummy, &dummy, ngblist, dynamic_iteration);
-    }
-
-    return NULL;
+#define EVALUATION_CALL DynamicDiff_evaluate(j, 1, &dummy, &dummy, &dummy, ngblist, dynamic_iteration);
+#include "../system/code_block_secondary_loop_evaluation.h"
+#undef EVALUATION_CALL
 }
 
 #endif /* ends TURB_DIFF_DYNAMIC */